@@ -0,0 +1,52 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "daemon/Protocol.h"
+
+// itmoscript_client <socket> (-e <source> | <script path>) [input file]
+//
+// Runs a script on a running daemon and relays its output. Paths are sent
+// absolute because the daemon resolves them from its own directory.
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <socket> (-e <source> | <script>) [input]\n";
+        return 2;
+    }
+    protocol::Request req;
+    int next = 2;
+    if (std::string(argv[2]) == "-e") {
+        if (argc < 4) {
+            std::cerr << "-e expects a source argument\n";
+            return 2;
+        }
+        req.Kind = protocol::RequestKind::Source;
+        req.Script = argv[3];
+        next = 4;
+    } else {
+        req.Kind = protocol::RequestKind::Path;
+        req.Script = std::filesystem::absolute(argv[2]).string();
+        next = 3;
+    }
+    if (next < argc) {
+        std::ifstream in(argv[next]);
+        if (!in) {
+            std::cerr << "cannot open " << argv[next] << "\n";
+            return 2;
+        }
+        std::ostringstream text;
+        text << in.rdbuf();
+        req.Input = text.str();
+    }
+
+    try {
+        protocol::Response resp = protocol::Call(argv[1], req);
+        std::cout << resp.Output;
+        std::cerr << resp.Errors;
+        return static_cast<int>(resp.Code);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 2;
+    }
+}
@@ -1,12 +1,78 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <string>
+#include <thread>
 #include "interpreter.h"
+#include "daemon/ScriptServer.h"
+
+namespace {
+
+// itmoscript --daemon <socket> [--workers N] [--deadline ms]
+int RunDaemon(int argc, char** argv) {
+    std::string socketPath = argv[2];
+    std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    ExecutionLimits limits;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--workers") {
+            workers = std::stoul(argv[i + 1]);
+        } else if (flag == "--deadline") {
+            limits.Deadline = std::chrono::milliseconds(std::stoul(argv[i + 1]));
+        } else {
+            std::cerr << "unknown option " << flag << "\n";
+            return 2;
+        }
+    }
+    try {
+        ScriptServer server(socketPath, workers, limits);
+        server.Start();
+        std::cerr << "listening on " << socketPath << " with " << workers << " workers\n";
+        server.Wait();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Prints what the loop optimiser did to stderr, then runs the script.
+int RunWithReport(std::istream& in, const ExecutionLimits& limits) {
+    std::shared_ptr<const CompiledScript> script;
+    try {
+        script = Interpreter::Compile(in);
+    } catch (const std::exception& e) {
+        std::cerr << "Interpreter error: " << e.what() << "\n";
+        return 1;
+    }
+    for (const std::string& line : script->OptimiserReport) std::cerr << line << "\n";
+    return Interpreter::Run(*script, std::cout, std::cin, std::cerr, limits) ? 0 : 1;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && std::string(argv[1]) == "--daemon") return RunDaemon(argc, argv);
+    // itmoscript [--heap-profile | --optimiser-report] <script>
+    bool profile = argc == 3 && std::string(argv[1]) == "--heap-profile";
+    bool report = argc == 3 && std::string(argv[1]) == "--optimiser-report";
+    if (argc == 2 || profile || report) {
+        const char* path = argv[argc - 1];
+        std::ifstream f(path);
+        if (!f) {
+            std::cerr << "cannot open " << path << "\n";
+            return 2;
+        }
+        ExecutionLimits limits;
+        limits.ProfileHeap = profile;
+        if (report) return RunWithReport(f, limits);
+        return Interpreter::Interpret(f, std::cout, limits) ? 0 : 1;
+    }
 
-int main() {
     std::ifstream f("/Users/kostakazackov/Downloads/labwork10-kostyaas/examples/maximum.is");
     std::ostringstream out;
     bool ok = Interpreter(f, out);
     std::cout << "OK=" << ok << "\nOUT=" << out.str() << "\n";
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,142 @@
+#include "Protocol.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace protocol {
+
+namespace {
+
+[[noreturn]] void Fail(const char* what) {
+    throw std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+}
+
+// Returns the number of bytes read, which is short only at end of stream.
+std::size_t ReadSome(int fd, char* data, std::size_t size) {
+    std::size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::recv(fd, data + done, size - done, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            Fail("recv");
+        }
+        if (n == 0) break;
+        done += static_cast<std::size_t>(n);
+    }
+    return done;
+}
+
+void ReadExact(int fd, char* data, std::size_t size) {
+    if (ReadSome(fd, data, size) != size) throw std::runtime_error("connection closed mid-message");
+}
+
+void WriteAll(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            Fail("send");
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+}
+
+void PutField(std::string& buf, const std::string& field) {
+    if (field.size() > MaxField) throw std::runtime_error("message field too large");
+    auto len = static_cast<std::uint32_t>(field.size());
+    for (int i = 0; i < 4; ++i) buf.push_back(static_cast<char>((len >> (8 * i)) & 0xFF));
+    buf += field;
+}
+
+std::string GetField(int fd) {
+    unsigned char raw[4];
+    ReadExact(fd, reinterpret_cast<char*>(raw), 4);
+    std::uint32_t len = raw[0] | raw[1] << 8 | raw[2] << 16 | static_cast<std::uint32_t>(raw[3]) << 24;
+    if (len > MaxField) throw std::runtime_error("message field too large");
+    std::string field(len, '\0');
+    ReadExact(fd, field.data(), len);
+    return field;
+}
+
+bool GetTag(int fd, std::uint8_t& tag) {
+    char c;
+    if (ReadSome(fd, &c, 1) == 0) return false;
+    tag = static_cast<std::uint8_t>(c);
+    return true;
+}
+
+void Send(int fd, std::uint8_t tag, const std::string& a, const std::string& b) {
+    std::string buf(1, static_cast<char>(tag));
+    PutField(buf, a);
+    PutField(buf, b);
+    WriteAll(fd, buf.data(), buf.size());
+}
+
+class Socket {
+public:
+    explicit Socket(int fd) : fd_(fd) {}
+    ~Socket() { ::close(fd_); }
+    int get() const { return fd_; }
+private:
+    int fd_;
+};
+
+}
+
+bool ReadRequest(int fd, Request& req) {
+    std::uint8_t tag;
+    if (!GetTag(fd, tag)) return false;
+    if (tag != static_cast<std::uint8_t>(RequestKind::Source) && tag != static_cast<std::uint8_t>(RequestKind::Path))
+        throw std::runtime_error("unknown request kind");
+    req.Kind = static_cast<RequestKind>(tag);
+    req.Script = GetField(fd);
+    req.Input = GetField(fd);
+    return true;
+}
+
+void WriteRequest(int fd, const Request& req) {
+    Send(fd, static_cast<std::uint8_t>(req.Kind), req.Script, req.Input);
+}
+
+bool ReadResponse(int fd, Response& resp) {
+    std::uint8_t tag;
+    if (!GetTag(fd, tag)) return false;
+    resp.Code = static_cast<Status>(tag);
+    resp.Output = GetField(fd);
+    resp.Errors = GetField(fd);
+    return true;
+}
+
+void WriteResponse(int fd, const Response& resp) {
+    Send(fd, static_cast<std::uint8_t>(resp.Code), resp.Output, resp.Errors);
+}
+
+int Connect(const std::string& socketPath) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) throw std::runtime_error("socket path too long: " + socketPath);
+    std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) Fail("socket");
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        Fail(("connect " + socketPath).c_str());
+    }
+    return fd;
+}
+
+Response Call(const std::string& socketPath, const Request& req) {
+    Socket sock(Connect(socketPath));
+    WriteRequest(sock.get(), req);
+    Response resp;
+    if (!ReadResponse(sock.get(), resp)) throw std::runtime_error("daemon closed the connection");
+    return resp;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Wire format between the interpreter daemon and its clients. Every message
+// is a one-byte tag followed by two length-prefixed byte strings; lengths
+// are 32-bit little-endian. A connection may carry any number of
+// request/response pairs.
+//
+//   request:  kind ('S' source, 'P' path)  script-or-path  input
+//   response: status                       output          errors
+namespace protocol {
+
+enum class RequestKind : uint8_t {
+    Source = 'S',
+    Path = 'P'
+};
+
+// Exit status of a run as reported to the client.
+enum class Status : uint8_t {
+    Ok = 0,
+    Failed = 1,      // syntax, semantic or runtime error, or an exceeded limit
+    BadRequest = 2   // malformed request or unreadable script path
+};
+
+struct Request {
+    RequestKind Kind = RequestKind::Source;
+    std::string Script;
+    std::string Input;
+};
+
+struct Response {
+    Status Code = Status::Ok;
+    std::string Output;
+    std::string Errors;
+};
+
+constexpr std::uint32_t MaxField = std::uint32_t{64} << 20;
+
+// The readers return false when the peer closed the connection before the
+// first byte of a message and throw std::runtime_error on anything else
+// that is not a whole message. The writers throw on I/O errors.
+bool ReadRequest(int fd, Request& req);
+void WriteRequest(int fd, const Request& req);
+bool ReadResponse(int fd, Response& resp);
+void WriteResponse(int fd, const Response& resp);
+
+// Connects to the daemon listening on `socketPath`; throws on failure.
+int Connect(const std::string& socketPath);
+// Sends one request on a fresh connection and waits for the response.
+Response Call(const std::string& socketPath, const Request& req);
+
+}
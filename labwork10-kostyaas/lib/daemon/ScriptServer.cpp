@@ -0,0 +1,281 @@
+#include "ScriptServer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+ScriptServer::ScriptServer(std::string socketPath, std::size_t workers, const ExecutionLimits& limits)
+    : socketPath_(std::move(socketPath)), workerCount_(workers == 0 ? 1 : workers), limits_(limits) {}
+
+ScriptServer::~ScriptServer() {
+    Stop();
+}
+
+void ScriptServer::Start() {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath_.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("socket path too long: " + socketPath_);
+    std::memcpy(addr.sun_path, socketPath_.c_str(), socketPath_.size() + 1);
+
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listenFd_ < 0) throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    ::unlink(socketPath_.c_str());
+    if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listenFd_, 64) != 0) {
+        std::string err = std::strerror(errno);
+        ::close(listenFd_);
+        listenFd_ = -1;
+        throw std::runtime_error("cannot listen on " + socketPath_ + ": " + err);
+    }
+    if (::pipe2(wakeFds_, O_CLOEXEC | O_NONBLOCK) != 0) {
+        std::string err = std::strerror(errno);
+        ::close(listenFd_);
+        listenFd_ = -1;
+        throw std::runtime_error("pipe: " + err);
+    }
+
+    for (std::size_t i = 0; i < workerCount_; ++i) workers_.emplace_back([this] { WorkerLoop(); });
+    poller_ = std::thread([this] { PollLoop(); });
+}
+
+void ScriptServer::Wait() {
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    queueReady_.wait(lock, [this] { return stopping_; });
+}
+
+void ScriptServer::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        if (stopping_ || listenFd_ < 0) {
+            stopping_ = true;
+            queueReady_.notify_all();
+            return;
+        }
+        stopping_ = true;
+        // Ends the requests in progress; the poller and idle workers are
+        // woken below.
+        for (int fd : open_) ::shutdown(fd, SHUT_RDWR);
+    }
+    Wake();
+    queueReady_.notify_all();
+    if (poller_.joinable()) poller_.join();
+    for (auto& t : workers_) t.join();
+    workers_.clear();
+    for (int fd : open_) ::close(fd);
+    open_.clear();
+    pending_.clear();
+    idle_.clear();
+    ::close(listenFd_);
+    listenFd_ = -1;
+    for (int& fd : wakeFds_) {
+        ::close(fd);
+        fd = -1;
+    }
+    ::unlink(socketPath_.c_str());
+}
+
+void ScriptServer::Wake() {
+    char c = 0;
+    [[maybe_unused]] ssize_t n = ::write(wakeFds_[1], &c, 1);
+}
+
+// Waits for new connections, for requests on idle ones and for the wake
+// pipe, which workers write to when they hand a connection back. Idle
+// connections with data waiting move to the work queue.
+void ScriptServer::PollLoop() {
+    bool acceptPaused = false;
+    std::vector<pollfd> fds;
+    for (;;) {
+        fds.clear();
+        fds.push_back({wakeFds_[0], POLLIN, 0});
+        fds.push_back({acceptPaused ? -1 : listenFd_, POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (stopping_) return;
+            for (int fd : idle_) fds.push_back({fd, POLLIN, 0});
+        }
+        int timeout = acceptPaused ? static_cast<int>(AcceptBackoff.count()) : -1;
+        if (::poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) return;
+
+        if (fds[0].revents) {
+            char buf[64];
+            while (::read(wakeFds_[0], buf, sizeof(buf)) > 0) {
+            }
+        }
+        acceptPaused = fds[1].revents ? !Accept() : false;
+
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        for (std::size_t i = 2; i < fds.size(); ++i) {
+            if (!fds[i].revents) continue;
+            idle_.erase(std::find(idle_.begin(), idle_.end(), fds[i].fd));
+            pending_.push_back(fds[i].fd);
+        }
+        queueReady_.notify_all();
+    }
+}
+
+// Takes every waiting connection. Returns false when accept failed for a
+// reason other than an empty backlog, such as running out of descriptors;
+// the caller then stops accepting for a while instead of spinning.
+bool ScriptServer::Accept() {
+    for (;;) {
+        int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        timeval tv{static_cast<time_t>(IoTimeout.count()), 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        open_.insert(fd);
+        idle_.push_back(fd);
+    }
+}
+
+void ScriptServer::WorkerLoop() {
+    for (;;) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            queueReady_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (stopping_) return;
+            fd = pending_.front();
+            pending_.pop_front();
+        }
+        bool keep = Serve(fd);
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            if (keep && !stopping_) {
+                idle_.push_back(fd);
+                Wake();
+                continue;
+            }
+            open_.erase(fd);
+        }
+        ::close(fd);
+    }
+}
+
+// Serves one request and returns whether the connection stays open for the
+// next. A broken, malformed or timed-out request only ends that connection.
+bool ScriptServer::Serve(int fd) {
+    try {
+        protocol::Request req;
+        if (!protocol::ReadRequest(fd, req)) return false;
+        protocol::WriteResponse(fd, Handle(req));
+        return true;
+    } catch (const std::exception& e) {
+        protocol::Response resp;
+        resp.Code = protocol::Status::BadRequest;
+        resp.Errors = std::string("Bad request: ") + e.what() + "\n";
+        try {
+            protocol::WriteResponse(fd, resp);
+        } catch (const std::exception&) {
+        }
+        return false;
+    }
+}
+
+protocol::Response ScriptServer::Handle(const protocol::Request& req) {
+    protocol::Response resp;
+    std::shared_ptr<const CompiledScript> script;
+    try {
+        script = req.Kind == protocol::RequestKind::Path ? FromPath(req.Script) : FromSource(req.Script);
+    } catch (const std::invalid_argument& e) {
+        resp.Code = protocol::Status::BadRequest;
+        resp.Errors = std::string("Bad request: ") + e.what() + "\n";
+        return resp;
+    } catch (const std::exception& e) {
+        resp.Code = protocol::Status::Failed;
+        resp.Errors = std::string("Interpreter error: ") + e.what() + "\n";
+        return resp;
+    }
+
+    std::istringstream input(req.Input);
+    std::ostringstream out;
+    std::ostringstream errors;
+    bool ok = Interpreter::Run(*script, out, input, errors, limits_);
+    resp.Code = ok ? protocol::Status::Ok : protocol::Status::Failed;
+    resp.Output = out.str();
+    resp.Errors = errors.str();
+    return resp;
+}
+
+std::shared_ptr<const CompiledScript> ScriptServer::CompileText(const std::string& source) {
+    std::istringstream in(source);
+    auto script = Interpreter::Compile(in);
+    ++compilations_;
+    return script;
+}
+
+// Sources, like paths below, are evicted oldest first. Two clients sending
+// the same new source at once may both compile it; the second result simply
+// replaces the first.
+std::shared_ptr<const CompiledScript> ScriptServer::FromSource(const std::string& source) {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        auto it = sources_.find(source);
+        if (it != sources_.end()) {
+            ++hits_;
+            return it->second;
+        }
+    }
+    auto script = CompileText(source);
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    if (sources_.emplace(source, script).second) {
+        sourceOrder_.push_back(source);
+        if (sourceOrder_.size() > MaxCachedSources) {
+            sources_.erase(sourceOrder_.front());
+            sourceOrder_.pop_front();
+        }
+    }
+    return script;
+}
+
+std::shared_ptr<const CompiledScript> ScriptServer::FromPath(const std::string& path) {
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(path, ec);
+    std::string key = ec ? path : canonical.string();
+    auto mtime = std::filesystem::last_write_time(key, ec);
+    if (ec) throw std::invalid_argument("cannot open " + path);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        auto it = paths_.find(key);
+        if (it != paths_.end() && it->second.MTime == mtime) {
+            ++hits_;
+            return it->second.Script;
+        }
+    }
+    std::ifstream in(key);
+    if (!in) throw std::invalid_argument("cannot open " + path);
+    std::ostringstream text;
+    text << in.rdbuf();
+    auto script = CompileText(text.str());
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    auto [it, inserted] = paths_.insert_or_assign(key, PathEntry{mtime, script});
+    if (inserted) {
+        pathOrder_.push_back(key);
+        if (pathOrder_.size() > MaxCachedPaths) {
+            paths_.erase(pathOrder_.front());
+            pathOrder_.pop_front();
+        }
+    }
+    return script;
+}
+
+std::size_t ScriptServer::Compilations() const {
+    return compilations_;
+}
+
+std::size_t ScriptServer::CacheHits() const {
+    return hits_;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Protocol.h"
+#include "interpreter.h"
+
+// Runs scripts on behalf of clients connected to a Unix socket, so that the
+// start-up cost of the process and the compilation of scripts that are run
+// repeatedly are paid once. One thread polls the listening socket and the
+// idle connections; a connection with a request waiting is queued to a fixed
+// pool of worker threads, which serve that one request and hand it back, so
+// idle clients never hold a worker. Each run gets a fresh Interpreter, while
+// compiled programs are shared through a cache keyed by source text, or by
+// path and modification time.
+class ScriptServer {
+public:
+    static constexpr std::size_t MaxCachedSources = 256;
+    static constexpr std::size_t MaxCachedPaths = 256;
+    // A request must arrive, and its response be taken, within this long.
+    static constexpr std::chrono::seconds IoTimeout{5};
+    // Accepting pauses this long after accept fails, e.g. out of descriptors.
+    static constexpr std::chrono::milliseconds AcceptBackoff{100};
+
+    ScriptServer(std::string socketPath, std::size_t workers, const ExecutionLimits& limits = {});
+    ~ScriptServer();
+
+    ScriptServer(const ScriptServer&) = delete;
+    ScriptServer& operator=(const ScriptServer&) = delete;
+
+    // Binds the socket, replacing a stale socket file, and starts serving.
+    // Throws std::runtime_error when the socket cannot be set up.
+    void Start();
+    // Blocks until Stop is called from another thread.
+    void Wait();
+    // Stops accepting, closes open connections and joins every thread.
+    void Stop();
+
+    // Runs one request on the calling thread.
+    protocol::Response Handle(const protocol::Request& req);
+
+    std::size_t Compilations() const;
+    std::size_t CacheHits() const;
+
+private:
+    struct PathEntry {
+        std::filesystem::file_time_type MTime;
+        std::shared_ptr<const CompiledScript> Script;
+    };
+
+    std::string socketPath_;
+    std::size_t workerCount_;
+    ExecutionLimits limits_;
+    int listenFd_ = -1;
+    int wakeFds_[2] = {-1, -1};
+
+    std::mutex queueMutex_;
+    std::condition_variable queueReady_;
+    std::deque<int> pending_;
+    std::vector<int> idle_;
+    std::unordered_set<int> open_;
+    bool stopping_ = false;
+
+    std::thread poller_;
+    std::vector<std::thread> workers_;
+
+    std::mutex cacheMutex_;
+    std::unordered_map<std::string, std::shared_ptr<const CompiledScript>> sources_;
+    std::deque<std::string> sourceOrder_;
+    std::unordered_map<std::string, PathEntry> paths_;
+    std::deque<std::string> pathOrder_;
+    std::atomic<std::size_t> compilations_{0};
+    std::atomic<std::size_t> hits_{0};
+
+    void PollLoop();
+    bool Accept();
+    void WorkerLoop();
+    bool Serve(int fd);
+    void Wake();
+    std::shared_ptr<const CompiledScript> FromSource(const std::string& source);
+    std::shared_ptr<const CompiledScript> FromPath(const std::string& path);
+    std::shared_ptr<const CompiledScript> CompileText(const std::string& source);
+};
@@ -0,0 +1,216 @@
+#include "IncrementalFrontEnd.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+// A trailing newline ends the last line rather than starting an empty one.
+std::vector<std::string> SplitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    std::size_t from = 0;
+    while (from < text.size()) {
+        std::size_t nl = text.find('\n', from);
+        if (nl == std::string::npos) nl = text.size();
+        lines.push_back(text.substr(from, nl - from));
+        from = nl + 1;
+    }
+    return lines;
+}
+
+}
+
+IncrementalFrontEnd::IncrementalFrontEnd(const std::string& source)
+    : lines_(SplitLines(source)), analyser_(errs_) {
+    Rebuild();
+}
+
+bool IncrementalFrontEnd::Valid() const {
+    if (!syntaxError_.empty()) return false;
+    for (auto& s : segments_) {
+        if (!s.Ok) return false;
+    }
+    return true;
+}
+
+std::string IncrementalFrontEnd::Errors() const {
+    if (!syntaxError_.empty()) return syntaxError_ + "\n";
+    std::string res;
+    for (auto& s : segments_) res += s.Errors;
+    return res;
+}
+
+std::string IncrementalFrontEnd::Source() const {
+    std::string res;
+    for (auto& line : lines_) {
+        res += line;
+        res += '\n';
+    }
+    return res;
+}
+
+const std::vector<Statement>& IncrementalFrontEnd::Program() const {
+    return program_;
+}
+
+const std::vector<LineSpan>& IncrementalFrontEnd::Spans() const {
+    return spans_;
+}
+
+const IncrementalFrontEnd::Stats& IncrementalFrontEnd::LastStats() const {
+    return stats_;
+}
+
+IncrementalFrontEnd::Fragment IncrementalFrontEnd::ParseLines(std::size_t first, std::size_t last) const {
+    std::string text;
+    for (std::size_t i = first; i <= last; ++i) {
+        text += lines_[i - 1];
+        text += '\n';
+    }
+    std::istringstream in(text);
+    SyntacticAnalyser parser(in);
+    Fragment res{parser.Parse(), parser.Spans()};
+    for (auto& span : res.Spans) {
+        span.First += first - 1;
+        span.Last += first - 1;
+    }
+    return res;
+}
+
+bool IncrementalFrontEnd::Rebuild() {
+    program_.clear();
+    spans_.clear();
+    segments_.clear();
+    syntaxError_.clear();
+    try {
+        Fragment all = ParseLines(1, lines_.size());
+        program_ = std::move(all.Program);
+        spans_ = std::move(all.Spans);
+    } catch (const std::exception& ex) {
+        program_.clear();
+        spans_.clear();
+        syntaxError_ = ex.what();
+        return false;
+    }
+    stats_.Reparsed = program_.size();
+    Reanalyse(0, 0, program_.size());
+    return Valid();
+}
+
+bool IncrementalFrontEnd::Apply(const TextEdit& edit) {
+    if (edit.First == 0 || edit.Last + 1 < edit.First || edit.Last > lines_.size()) {
+        throw std::runtime_error("Edit is out of range");
+    }
+    stats_ = Stats{};
+    auto added = SplitLines(edit.Text);
+    std::size_t removed = edit.Last + 1 - edit.First;
+    lines_.erase(lines_.begin() + (edit.First - 1), lines_.begin() + edit.Last);
+    lines_.insert(lines_.begin() + (edit.First - 1), added.begin(), added.end());
+    if (!syntaxError_.empty() || program_.empty()) return Rebuild();
+
+    // Only lines after the edit move; `added - removed` may wrap, but the
+    // sum stays in range for every such line.
+    auto moved = [&](std::size_t line) { return line + added.size() - removed; };
+
+    // The closest statement before the edit is re-parsed as well, since the
+    // edit may continue it. The region ends with the first statement past
+    // the edit; parsing it back unchanged shows nothing after the region
+    // has been absorbed. Statements sharing a line stay together.
+    std::size_t n = program_.size();
+    std::size_t lo = std::partition_point(spans_.begin(), spans_.end(),
+        [&](const LineSpan& s) { return s.Last < edit.First; }) - spans_.begin();
+    std::size_t hi = std::partition_point(spans_.begin(), spans_.end(),
+        [&](const LineSpan& s) { return s.First <= edit.Last; }) - spans_.begin();
+    if (lo > 0) --lo;
+
+    for (std::size_t grow = 1;; grow *= 2) {
+        while (lo > 0 && spans_[lo - 1].Last >= spans_[lo].First) --lo;
+        while (hi + 1 < n && spans_[hi + 1].First <= spans_[hi].Last) ++hi;
+        bool bounded = hi < n;
+        std::size_t first = lo == 0 ? 1 : spans_[lo].First;
+        std::size_t last = bounded ? moved(spans_[hi].Last) : lines_.size();
+        std::size_t count = (bounded ? hi + 1 : n) - lo;
+        try {
+            Fragment part = ParseLines(first, last);
+            if (!bounded || (!part.Spans.empty() && part.Spans.back().First == moved(spans_[hi].First)
+                                                 && part.Spans.back().Last == last)) {
+                std::size_t fresh = part.Program.size();
+                program_.erase(program_.begin() + lo, program_.begin() + lo + count);
+                program_.insert(program_.begin() + lo, std::make_move_iterator(part.Program.begin()),
+                                std::make_move_iterator(part.Program.end()));
+                spans_.erase(spans_.begin() + lo, spans_.begin() + lo + count);
+                spans_.insert(spans_.begin() + lo, part.Spans.begin(), part.Spans.end());
+                for (std::size_t i = lo + fresh; i < spans_.size(); ++i) {
+                    spans_[i].First = moved(spans_[i].First);
+                    spans_[i].Last = moved(spans_[i].Last);
+                }
+                stats_.Reparsed = fresh;
+                Reanalyse(lo, count, fresh);
+                return Valid();
+            }
+        } catch (const std::exception& ex) {
+            if (lo == 0 && !bounded) {
+                program_.clear();
+                spans_.clear();
+                segments_.clear();
+                syntaxError_ = ex.what();
+                return false;
+            }
+        }
+        lo = lo > grow ? lo - grow : 0;
+        hi = std::min(n, hi + grow);
+    }
+}
+
+// Statements [from, from + removed) were replaced by `added` new ones.
+// Analysis resumes from the segment holding `from`; the segments after the
+// replaced statements are handed on so Analyse can stop as soon as the
+// globals agree with one of them again.
+void IncrementalFrontEnd::Reanalyse(std::size_t from, std::size_t removed, std::size_t added) {
+    analyser_.Begin(program_);
+    if (segments_.empty() || analyser_.Rebounds() != rebound_) {
+        rebound_ = analyser_.Rebounds();
+        segments_.clear();
+        Analyse(0, {});
+        return;
+    }
+    auto it = std::partition_point(segments_.begin(), segments_.end(),
+        [&](const Segment& s) { return s.First <= from; }) - 1;
+    std::vector<Segment> tail;
+    for (auto next = it + 1; next != segments_.end(); ++next) {
+        if (next->First < from + removed) continue;
+        next->First = next->First - removed + added;
+        tail.push_back(std::move(*next));
+    }
+    std::size_t start = it->First;
+    analyser_.Resume(std::move(it->Globals));
+    segments_.erase(it, segments_.end());
+    Analyse(start, std::move(tail));
+}
+
+void IncrementalFrontEnd::Analyse(std::size_t from, std::vector<Segment> tail) {
+    std::size_t t = 0;
+    std::size_t i = from;
+    while (i < program_.size()) {
+        while (t < tail.size() && tail[t].First < i) ++t;
+        auto globals = analyser_.Checkpoint();
+        if (t < tail.size() && tail[t].First == i) {
+            if (tail[t].Globals == globals) {
+                segments_.insert(segments_.end(), std::make_move_iterator(tail.begin() + t),
+                                 std::make_move_iterator(tail.end()));
+                return;
+            }
+            ++t;
+        }
+        std::size_t end = std::min(program_.size(), i + SegmentLength);
+        if (t < tail.size()) end = std::min(end, tail[t].First);
+        errs_.str("");
+        Segment segment{i, std::move(globals), "", true};
+        for (; i < end; ++i) {
+            segment.Ok &= analyser_.AnalyseStatement(program_[i]);
+            ++stats_.Reanalysed;
+        }
+        segment.Errors = errs_.str();
+        segments_.push_back(std::move(segment));
+    }
+}
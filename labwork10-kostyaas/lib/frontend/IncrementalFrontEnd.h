@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <unordered_set>
+#include "syntactic_analyser/SyntacticAnalyser.h"
+#include "semantic_analyser/SemanticAnalyser.h"
+
+// Replaces source lines First..Last (1-based, inclusive) with Text.
+// Last == First - 1 inserts Text before line First.
+struct TextEdit {
+    std::size_t First;
+    std::size_t Last;
+    std::string Text;
+};
+
+// Keeps a parsed and analysed program in step with a source buffer that is
+// edited line by line. An edit re-lexes and re-parses only the top-level
+// statements around it and re-checks statements until the global types
+// match what they were before the edit; everything else is reused.
+class IncrementalFrontEnd {
+public:
+    struct Stats {
+        std::size_t Reparsed = 0;
+        std::size_t Reanalysed = 0;
+    };
+
+    explicit IncrementalFrontEnd(const std::string& source);
+
+    // Returns Valid() after the edit.
+    bool Apply(const TextEdit& edit);
+
+    bool Valid() const;
+    std::string Errors() const;
+    std::string Source() const;
+    const std::vector<Statement>& Program() const;
+    const std::vector<LineSpan>& Spans() const;
+    const Stats& LastStats() const;
+
+private:
+    static constexpr std::size_t SegmentLength = 256;
+
+    // Globals before statement First and the reports of the statements
+    // from First up to the next segment.
+    struct Segment {
+        std::size_t First;
+        SymbolTable::State Globals;
+        std::string Errors;
+        bool Ok;
+    };
+
+    struct Fragment {
+        std::vector<Statement> Program;
+        std::vector<LineSpan> Spans;
+    };
+
+    std::vector<std::string> lines_;
+    std::vector<Statement> program_;
+    std::vector<LineSpan> spans_;
+    std::string syntaxError_;
+
+    std::ostringstream errs_;
+    SemanticAnalyser analyser_;
+    std::unordered_set<std::string> rebound_;
+    std::vector<Segment> segments_;
+    Stats stats_;
+
+    Fragment ParseLines(std::size_t first, std::size_t last) const;
+    bool Rebuild();
+    void Reanalyse(std::size_t from, std::size_t removed, std::size_t added);
+    void Analyse(std::size_t from, std::vector<Segment> tail);
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "HeapProfile.h"
+
+// Limits for a single Interpret run. A zero value disables the limit.
+struct ExecutionLimits {
+    uint64_t MaxSteps = 0;                  // loop iterations plus function calls
+    std::chrono::milliseconds Deadline{0};  // wall clock, measured from the start of execution
+    // Largest string or list storage one operation (concatenation,
+    // repetition, join, range, a file read) may build. Not a cap on the
+    // total: many values under it can still pile up, and map inserts and
+    // boxed list elements are not charged.
+    std::size_t MaxAllocationBytes = 0;
+    bool PooledValues = true;               // allocate runtime values from a per-run RunArena
+    bool ProfileHeap = false;               // account the heap by kind and line, see HeapProfile
+};
+
+struct ExecutionStats {
+    uint64_t Steps = 0;
+    std::chrono::microseconds Elapsed{0};
+    std::size_t LargestAllocation = 0;
+    uint64_t Allocations = 0;               // value allocations made through the run's arena
+    std::size_t PeakBytes = 0;              // most arena bytes live at once
+    bool Aborted = false;
+    std::string AbortReason;
+    std::shared_ptr<const HeapReport> Heap; // set when ExecutionLimits::ProfileHeap is
+};
+
+class LimitExceeded : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
@@ -0,0 +1,80 @@
+#include "interpreter.h"
+#include "Iterators.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+[[noreturn]] void Fail(const char* fn, const std::string& path) {
+    throw std::runtime_error(std::string(fn) + "(): " + path + ": " + std::strerror(errno));
+}
+
+class FileHandle {
+public:
+    FileHandle(const char* fn, const std::string& path, int flags) : fd_(::open(path.c_str(), flags, 0644)) {
+        if (fd_ < 0) Fail(fn, path);
+    }
+    ~FileHandle() { ::close(fd_); }
+    int get() const { return fd_; }
+
+private:
+    int fd_;
+};
+
+void WriteAll(const char* fn, const std::string& path, int flags, const std::string& data) {
+    FileHandle file(fn, path, flags);
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(file.get(), data.data() + done, data.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            Fail(fn, path);
+        }
+        done += static_cast<size_t>(n);
+    }
+}
+
+}
+
+void Interpreter::FileFunctions() {
+    DefineNative("read_file", [this](const std::vector<Value>& args) -> Value {
+        const std::string& path = StringArg(args, 0, "read_file");
+        FileHandle file("read_file", path, O_RDONLY);
+        struct stat st;
+        if (::fstat(file.get(), &st) != 0) Fail("read_file", path);
+        ChargeHeap(static_cast<size_t>(st.st_size), HeapKind::String);
+        std::string res(static_cast<size_t>(st.st_size), '\0');
+        size_t done = 0;
+        while (true) {
+            if (done == res.size()) res.resize(res.size() + LineIterator::BufferSize);
+            ssize_t n = ::read(file.get(), res.data() + done, res.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                Fail("read_file", path);
+            }
+            if (n == 0) break;
+            done += static_cast<size_t>(n);
+        }
+        res.resize(done);
+        return Value(std::move(res));
+    });
+
+    DefineNative("read_lines", [](const std::vector<Value>& args) -> Value {
+        return Value(Value::IterPtr(MakeShared<LineIterator>(StringArg(args, 0, "read_lines"))));
+    });
+
+    DefineNative("write_file", [](const std::vector<Value>& args) -> Value {
+        WriteAll("write_file", StringArg(args, 0, "write_file"), O_WRONLY | O_CREAT | O_TRUNC,
+                 StringArg(args, 1, "write_file"));
+        return Value(NilType{});
+    });
+
+    DefineNative("append_file", [](const std::vector<Value>& args) -> Value {
+        WriteAll("append_file", StringArg(args, 0, "append_file"), O_WRONLY | O_CREAT | O_APPEND,
+                 StringArg(args, 1, "append_file"));
+        return Value(NilType{});
+    });
+}
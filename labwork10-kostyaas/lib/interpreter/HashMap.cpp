@@ -0,0 +1,115 @@
+#include "HashMap.h"
+#include <string_view>
+
+namespace {
+
+// Slots are taken from the low bits of the hash, so the bits of the key
+// are folded into them first: otherwise integer keys that are multiples
+// of a power of two all land in one probe cluster.
+std::size_t Mix(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+std::size_t HashMap::size() const {
+    return entries_.size();
+}
+
+bool HashMap::empty() const {
+    return entries_.empty();
+}
+
+const Value* HashMap::Find(const Value& key) const {
+    std::int32_t idx = Lookup(key, Hash(key));
+    return idx == EmptySlot ? nullptr : &entries_[idx].value;
+}
+
+bool HashMap::Has(const Value& key) const {
+    return Find(key) != nullptr;
+}
+
+void HashMap::Set(const Value& key, Value value) {
+    std::size_t h = Hash(key);
+    std::int32_t idx = Lookup(key, h);
+    if (idx != EmptySlot) {
+        entries_[idx].value = std::move(value);
+        return;
+    }
+    if ((entries_.size() + 1) * 4 > slots_.size() * 3) {
+        Rebuild(slots_.empty() ? 8 : slots_.size() * 2);
+    }
+    entries_.push_back(Entry{h, key, std::move(value)});
+    std::size_t mask = slots_.size() - 1;
+    std::size_t pos = h & mask;
+    while (slots_[pos] != EmptySlot) pos = (pos + 1) & mask;
+    slots_[pos] = static_cast<std::int32_t>(entries_.size() - 1);
+}
+
+const Value& HashMap::KeyAt(std::size_t i) const {
+    return entries_[i].key;
+}
+
+const Value& HashMap::ValueAt(std::size_t i) const {
+    return entries_[i].value;
+}
+
+bool HashMap::IsHashable(const Value& key) {
+    return key.IsNumber() ||
+           std::holds_alternative<std::string>(key.data) ||
+           std::holds_alternative<bool>(key.data);
+}
+
+std::size_t HashMap::Hash(const Value& key) {
+    if (auto pi = std::get_if<int64_t>(&key.data)) {
+        return Mix(static_cast<std::uint64_t>(*pi));
+    }
+    if (auto pd = std::get_if<double>(&key.data)) {
+        double d = *pd == 0.0 ? 0.0 : *pd;
+        if (d == static_cast<double>(static_cast<int64_t>(d)) && std::abs(d) <= Value::MaxExactInt)
+            return Mix(static_cast<std::uint64_t>(static_cast<int64_t>(d)));
+        return Mix(std::hash<double>{}(d));
+    }
+    if (auto ps = std::get_if<std::string>(&key.data)) {
+        return std::hash<std::string_view>{}(*ps);
+    }
+    if (auto pb = std::get_if<bool>(&key.data)) {
+        return *pb ? 0x51ED270B27u : 0x2545F491u;
+    }
+    throw std::runtime_error("Unhashable map key");
+}
+
+bool HashMap::SameKey(const Value& a, const Value& b) {
+    if (a.IsNumber() && b.IsNumber()) {
+        auto ai = std::get_if<int64_t>(&a.data);
+        auto bi = std::get_if<int64_t>(&b.data);
+        if (ai && bi) return *ai == *bi;
+        return a.AsDouble() == b.AsDouble();
+    }
+    if (a.data.index() != b.data.index()) return false;
+    if (auto as = std::get_if<std::string>(&a.data)) return *as == std::get<std::string>(b.data);
+    return std::get<bool>(a.data) == std::get<bool>(b.data);
+}
+
+std::int32_t HashMap::Lookup(const Value& key, std::size_t hash) const {
+    if (slots_.empty()) return EmptySlot;
+    std::size_t mask = slots_.size() - 1;
+    for (std::size_t pos = hash & mask; slots_[pos] != EmptySlot; pos = (pos + 1) & mask) {
+        const Entry& e = entries_[slots_[pos]];
+        if (e.hash == hash && SameKey(e.key, key)) return slots_[pos];
+    }
+    return EmptySlot;
+}
+
+void HashMap::Rebuild(std::size_t capacity) {
+    slots_.assign(capacity, EmptySlot);
+    std::size_t mask = capacity - 1;
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        std::size_t pos = entries_[i].hash & mask;
+        while (slots_[pos] != EmptySlot) pos = (pos + 1) & mask;
+        slots_[pos] = static_cast<std::int32_t>(i);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "interpreter.h"
+
+class HashMap {
+public:
+    static constexpr HeapKind HeapTag = HeapKind::Map;
+
+    HashMap() = default;
+
+    std::size_t size() const;
+    bool empty() const;
+
+    const Value* Find(const Value& key) const;
+    bool Has(const Value& key) const;
+    void Set(const Value& key, Value value);
+
+    const Value& KeyAt(std::size_t i) const;
+    const Value& ValueAt(std::size_t i) const;
+
+    static bool IsHashable(const Value& key);
+
+private:
+    struct Entry {
+        std::size_t hash;
+        Value key;
+        Value value;
+    };
+
+    static constexpr std::int32_t EmptySlot = -1;
+
+    std::vector<Entry> entries_;
+    std::vector<std::int32_t> slots_;
+
+    static std::size_t Hash(const Value& key);
+    static bool SameKey(const Value& a, const Value& b);
+    std::int32_t Lookup(const Value& key, std::size_t hash) const;
+    void Rebuild(std::size_t capacity);
+};
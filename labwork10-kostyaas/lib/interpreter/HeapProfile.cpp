@@ -0,0 +1,143 @@
+#include "HeapProfile.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+thread_local std::size_t CurrentLine = 0;
+thread_local HeapKind CurrentKind = HeapKind::Environment;
+
+void Add(HeapCounters& c, std::size_t bytes) {
+    ++c.Allocations;
+    c.Bytes += bytes;
+    c.Live += bytes;
+    c.Peak = std::max(c.Peak, c.Live);
+}
+
+}
+
+const char* HeapKindName(HeapKind kind) {
+    switch (kind) {
+        case HeapKind::String: return "string";
+        case HeapKind::List: return "list";
+        case HeapKind::Map: return "map";
+        case HeapKind::Function: return "function";
+        case HeapKind::Environment: return "environment";
+        case HeapKind::Iterator: return "iterator";
+    }
+    return "unknown";
+}
+
+void HeapProfile::Enter(std::size_t line) {
+    if (line) CurrentLine = line;
+}
+
+HeapProfile::KindScope::KindScope(HeapKind kind) : saved_(CurrentKind) {
+    CurrentKind = kind;
+}
+
+HeapProfile::KindScope::~KindScope() {
+    CurrentKind = saved_;
+}
+
+HeapSite& HeapProfile::Site(HeapKind kind, uint32_t& index) {
+    uint64_t key = static_cast<uint64_t>(CurrentLine) << 8 | static_cast<uint8_t>(kind);
+    auto [it, added] = siteIndex_.try_emplace(key, static_cast<uint32_t>(sites_.size()));
+    if (added) sites_.push_back({CurrentLine, kind, {}});
+    index = it->second;
+    return sites_[index];
+}
+
+void HeapProfile::Allocated(void* p, std::size_t bytes) {
+    uint32_t index;
+    HeapSite& site = Site(CurrentKind, index);
+    Add(site.Counters, bytes);
+    Add(kinds_[static_cast<std::size_t>(CurrentKind)], bytes);
+    blocks_[p] = Block{index, bytes};
+    live_ += bytes;
+    peak_ = std::max(peak_, live_);
+}
+
+void HeapProfile::Released(void* p) {
+    auto it = blocks_.find(p);
+    if (it == blocks_.end()) return;
+    HeapSite& site = sites_[it->second.Site];
+    std::size_t bytes = it->second.Bytes;
+    site.Counters.Live -= bytes;
+    kinds_[static_cast<std::size_t>(site.Kind)].Live -= bytes;
+    live_ -= bytes;
+    blocks_.erase(it);
+}
+
+void HeapProfile::Built(HeapKind kind, std::size_t bytes) {
+    uint32_t index;
+    HeapSite& site = Site(kind, index);
+    ++site.Counters.Allocations;
+    site.Counters.Bytes += bytes;
+    auto& total = kinds_[static_cast<std::size_t>(kind)];
+    ++total.Allocations;
+    total.Bytes += bytes;
+}
+
+void HeapProfile::Sample(uint64_t step) {
+    if (step < nextSample_) return;
+    if (samples_.size() == MaxSamples) {
+        for (std::size_t i = 0; i < MaxSamples / 2; ++i) samples_[i] = samples_[2 * i];
+        samples_.resize(MaxSamples / 2);
+        interval_ *= 2;
+    }
+    samples_.push_back({step, live_});
+    nextSample_ = step + interval_;
+}
+
+HeapReport HeapProfile::Report() const {
+    HeapReport report;
+    report.Kinds = kinds_;
+    report.Sites = sites_;
+    std::stable_sort(report.Sites.begin(), report.Sites.end(), [](const HeapSite& a, const HeapSite& b) {
+        return a.Counters.Bytes > b.Counters.Bytes;
+    });
+    report.Samples = samples_;
+    report.PeakBytes = peak_;
+    return report;
+}
+
+void HeapReport::Merge(const HeapReport& other) {
+    auto merge = [](HeapCounters& a, const HeapCounters& b) {
+        a.Allocations += b.Allocations;
+        a.Bytes += b.Bytes;
+        a.Live += b.Live;
+        a.Peak += b.Peak;
+    };
+    for (std::size_t k = 0; k < HeapKinds; ++k) merge(Kinds[k], other.Kinds[k]);
+    for (const auto& site : other.Sites) {
+        auto it = std::find_if(Sites.begin(), Sites.end(), [&](const HeapSite& s) {
+            return s.Line == site.Line && s.Kind == site.Kind;
+        });
+        if (it == Sites.end()) Sites.push_back(site);
+        else merge(it->Counters, site.Counters);
+    }
+    std::stable_sort(Sites.begin(), Sites.end(), [](const HeapSite& a, const HeapSite& b) {
+        return a.Counters.Bytes > b.Counters.Bytes;
+    });
+    PeakBytes += other.PeakBytes;
+}
+
+void HeapReport::Print(std::ostream& out, std::size_t top) const {
+    out << "Heap profile: peak " << PeakBytes << " bytes, " << Samples.size() << " samples\n";
+    out << std::left << std::setw(12) << "kind" << std::right << std::setw(12) << "allocs"
+        << std::setw(14) << "bytes" << std::setw(12) << "live" << std::setw(12) << "peak" << "\n";
+    for (std::size_t k = 0; k < HeapKinds; ++k) {
+        const auto& c = Kinds[k];
+        out << std::left << std::setw(12) << HeapKindName(static_cast<HeapKind>(k)) << std::right
+            << std::setw(12) << c.Allocations << std::setw(14) << c.Bytes
+            << std::setw(12) << c.Live << std::setw(12) << c.Peak << "\n";
+    }
+    out << "Top allocation sites:\n";
+    for (std::size_t i = 0; i < Sites.size() && i < top; ++i) {
+        const auto& s = Sites[i];
+        out << "  line " << std::left << std::setw(6) << s.Line << std::setw(12) << HeapKindName(s.Kind)
+            << std::right << std::setw(12) << s.Counters.Allocations << std::setw(14) << s.Counters.Bytes
+            << std::setw(12) << s.Counters.Live << std::setw(12) << s.Counters.Peak << "\n";
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+enum class HeapKind : uint8_t {
+    String,
+    List,
+    Map,
+    Function,
+    Environment,
+    Iterator
+};
+
+constexpr std::size_t HeapKinds = 6;
+
+const char* HeapKindName(HeapKind kind);
+
+struct HeapCounters {
+    uint64_t Allocations = 0;
+    std::size_t Bytes = 0;      // total allocated or built over the run
+    std::size_t Live = 0;       // still allocated at the end of the run
+    std::size_t Peak = 0;       // most allocated at once
+};
+
+// Allocations of one kind made while executing one source line.
+struct HeapSite {
+    std::size_t Line;
+    HeapKind Kind;
+    HeapCounters Counters;
+};
+
+struct HeapSample {
+    uint64_t Step;
+    std::size_t Live;
+};
+
+struct HeapReport {
+    std::array<HeapCounters, HeapKinds> Kinds{};
+    std::vector<HeapSite> Sites;        // most bytes first
+    std::vector<HeapSample> Samples;    // in step order
+    std::size_t PeakBytes = 0;
+
+    // Adds the counters of another thread's report. Peaks are summed, so
+    // they are an upper bound for runs that used pmap, pfilter or preduce.
+    void Merge(const HeapReport& other);
+    void Print(std::ostream& out, std::size_t top = 10) const;
+};
+
+// Heap accounting for one run, fed by its RunArena. Every block is tagged
+// with the kind of value it was allocated for and with the line of the
+// statement most recently started on the allocating thread. String
+// contents and packed list elements come from the global allocator
+// instead; the operations that build large ones (concatenation,
+// repetition, join, range, file reads) report their size through Built,
+// which adds to the allocation counts and bytes but not to the live or
+// peak figures.
+//
+// Nothing here is touched unless ExecutionLimits::ProfileHeap is set.
+class HeapProfile {
+public:
+    static constexpr std::size_t MaxSamples = 4096;
+
+    void Allocated(void* p, std::size_t bytes);
+    void Released(void* p);
+    void Built(HeapKind kind, std::size_t bytes);
+
+    // Records the live size when `step` reached the next sampling point.
+    // Called at loop back-edges and calls; when the series is full every
+    // other sample is dropped and the interval doubles.
+    void Sample(uint64_t step);
+    uint64_t NextSample() const { return nextSample_; }
+
+    HeapReport Report() const;
+
+    // Attributes later allocations on this thread to `line`, the start of
+    // the statement about to run. The line is not restored when a call
+    // returns, so what a statement allocates after a call goes to the
+    // callee's last line. A line of 0 keeps the current one.
+    static void Enter(std::size_t line);
+
+    // Tags allocations on this thread with `kind` until the scope ends.
+    // Blocks allocated outside any scope are environment storage.
+    class KindScope {
+    public:
+        explicit KindScope(HeapKind kind);
+        ~KindScope();
+        KindScope(const KindScope&) = delete;
+        KindScope& operator=(const KindScope&) = delete;
+    private:
+        HeapKind saved_;
+    };
+
+private:
+    struct Block {
+        uint32_t Site;
+        std::size_t Bytes;
+    };
+
+    std::unordered_map<void*, Block> blocks_;
+    std::vector<HeapSite> sites_;
+    std::unordered_map<uint64_t, uint32_t> siteIndex_;
+    std::array<HeapCounters, HeapKinds> kinds_{};
+    std::size_t live_ = 0;
+    std::size_t peak_ = 0;
+    std::vector<HeapSample> samples_;
+    uint64_t interval_ = 64;
+    uint64_t nextSample_ = 0;
+
+    HeapSite& Site(HeapKind kind, uint32_t& index);
+};
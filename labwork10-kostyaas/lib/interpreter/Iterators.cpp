@@ -0,0 +1,197 @@
+#include "Iterators.h"
+#include <algorithm>
+#include <utility>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+thread_local Generator* Current = nullptr;
+
+}
+
+RangeIterator::RangeIterator(const std::vector<Value>& args) {
+    start_ = 0;
+    end_ = 0;
+    step_ = 1;
+    if (args.size() == 1) {
+        end_ = args[0].AsDouble();
+    } else if (args.size() == 2) {
+        start_ = args[0].AsDouble();
+        end_   = args[1].AsDouble();
+    } else if (args.size() >= 3) {
+        start_ = args[0].AsDouble();
+        end_   = args[1].AsDouble();
+        step_  = args[2].AsDouble();
+    } else {
+        throw std::runtime_error("range() expects 1, 2 or 3 args");
+    }
+    if (step_ == 0) throw std::runtime_error("range() step cannot be zero");
+
+    integral_ = std::holds_alternative<int64_t>(args[0].data) &&
+                (args.size() < 2 || std::holds_alternative<int64_t>(args[1].data)) &&
+                (args.size() < 3 || std::holds_alternative<int64_t>(args[2].data));
+    if (integral_) {
+        istart_ = static_cast<int64_t>(start_);
+        iend_   = static_cast<int64_t>(end_);
+        istep_  = static_cast<int64_t>(step_);
+    }
+    next_ = start_;
+    inext_ = istart_;
+}
+
+bool RangeIterator::Next(Value& out) {
+    if (integral_) {
+        if (istep_ > 0 ? inext_ >= iend_ : inext_ <= iend_) return false;
+        out = Value(inext_);
+        inext_ += istep_;
+        return true;
+    }
+    if (step_ > 0 ? next_ >= end_ : next_ <= end_) return false;
+    out = Value(next_);
+    next_ += step_;
+    return true;
+}
+
+std::size_t RangeIterator::Count() const {
+    if (integral_) {
+        if (istep_ > 0 ? istart_ >= iend_ : istart_ <= iend_) return 0;
+        return static_cast<std::size_t>((iend_ - istart_ + istep_ + (istep_ > 0 ? -1 : 1)) / istep_);
+    }
+    double count = std::ceil((end_ - start_) / step_);
+    return count > 0 ? static_cast<std::size_t>(std::min(count, 1e18)) : 0;
+}
+
+PackedList RangeIterator::Materialise() const {
+    PackedList res;
+    res.Reserve(Count());
+    if (integral_) {
+        if (istep_ > 0) {
+            for (int64_t v = istart_; v < iend_; v += istep_)
+                res.Push(v);
+        } else {
+            for (int64_t v = istart_; v > iend_; v += istep_)
+                res.Push(v);
+        }
+        return res;
+    }
+    if (step_ > 0) {
+        for (double v = start_; v < end_; v += step_)
+            res.Push(v);
+    } else {
+        for (double v = start_; v > end_; v += step_)
+            res.Push(v);
+    }
+    return res;
+}
+
+LineIterator::LineIterator(const std::string& path) : buf_(BufferSize) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0)
+        throw std::runtime_error("read_lines(): cannot open " + path + ": " + std::strerror(errno));
+}
+
+LineIterator::~LineIterator() {
+    ::close(fd_);
+}
+
+bool LineIterator::Next(Value& out) {
+    std::size_t scanned = begin_;
+    while (true) {
+        auto nl = static_cast<const char*>(std::memchr(buf_.data() + scanned, '\n', end_ - scanned));
+        if (nl) {
+            std::size_t stop = nl - buf_.data();
+            std::size_t len = stop - begin_;
+            if (len && buf_[stop - 1] == '\r') --len;
+            out = Value(std::string(buf_.data() + begin_, len));
+            begin_ = stop + 1;
+            return true;
+        }
+        if (eof_) {
+            if (begin_ == end_) return false;
+            out = Value(std::string(buf_.data() + begin_, end_ - begin_));
+            begin_ = end_;
+            return true;
+        }
+        scanned = end_ - begin_;
+        Fill();
+    }
+}
+
+// Moves the unread tail to the front of the buffer and reads more after it.
+void LineIterator::Fill() {
+    if (begin_ > 0) {
+        std::memmove(buf_.data(), buf_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    if (end_ == buf_.size()) buf_.resize(buf_.size() * 2);
+    ssize_t n;
+    do {
+        n = ::read(fd_, buf_.data() + end_, buf_.size() - end_);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) throw std::runtime_error(std::string("read_lines(): ") + std::strerror(errno));
+    if (n == 0) eof_ = true;
+    end_ += static_cast<std::size_t>(n);
+}
+
+Generator::Generator(Body body) : body_(std::move(body)) {}
+
+Generator::~Generator() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        producing_ = true;
+    }
+    turn_.notify_all();
+    thread_.join();
+}
+
+bool Generator::Next(Value& out) {
+    if (done_) return false;
+    if (running_) throw std::runtime_error("Generator is already running");
+    running_ = true;
+    if (!thread_.joinable()) thread_ = std::thread(&Generator::Run, this);
+    std::unique_lock<std::mutex> lock(mutex_);
+    producing_ = true;
+    turn_.notify_all();
+    turn_.wait(lock, [this] { return !producing_; });
+    running_ = false;
+    if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+    if (done_) return false;
+    out = std::move(*slot_);
+    slot_.reset();
+    return true;
+}
+
+void Generator::Yield(Value v) {
+    Generator* self = Current;
+    if (!self) throw std::runtime_error("yield outside of generator");
+    std::unique_lock<std::mutex> lock(self->mutex_);
+    self->slot_ = std::move(v);
+    self->producing_ = false;
+    self->turn_.notify_all();
+    self->turn_.wait(lock, [self] { return self->producing_; });
+    if (self->cancelled_) throw Cancelled{};
+}
+
+void Generator::Run() {
+    Current = this;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        turn_.wait(lock, [this] { return producing_; });
+    }
+    try {
+        if (!cancelled_) body_();
+    } catch (const Cancelled&) {
+    } catch (...) {
+        error_ = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    producing_ = false;
+    turn_.notify_all();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "interpreter.h"
+
+// Pull-based sequence consumed by `for`. Next stores the following element
+// in `out` and returns false once the sequence is exhausted.
+class Iterator {
+public:
+    static constexpr HeapKind HeapTag = HeapKind::Iterator;
+
+    virtual ~Iterator() = default;
+    virtual bool Next(Value& out) = 0;
+};
+
+class RangeIterator : public Iterator {
+public:
+    explicit RangeIterator(const std::vector<Value>& args);
+
+    bool Next(Value& out) override;
+    std::size_t Count() const;
+    PackedList Materialise() const;
+
+private:
+    bool integral_;
+    double start_, end_, step_;
+    int64_t istart_ = 0, iend_ = 0, istep_ = 1;
+    double next_;
+    int64_t inext_ = 0;
+};
+
+// Streams the lines of a file through a fixed read buffer, so memory use
+// depends on the longest line rather than on the file size.
+class LineIterator : public Iterator {
+public:
+    static constexpr std::size_t BufferSize = 1 << 20;
+
+    explicit LineIterator(const std::string& path);
+    ~LineIterator() override;
+
+    bool Next(Value& out) override;
+
+private:
+    int fd_;
+    bool eof_ = false;
+    std::vector<char> buf_;
+    std::size_t begin_ = 0;
+    std::size_t end_ = 0;
+
+    void Fill();
+};
+
+// Runs a function body on its own stack and hands control back and forth
+// with the consumer, so exactly one side runs at any time.
+class Generator : public Iterator {
+public:
+    using Body = std::function<void()>;
+
+    explicit Generator(Body body);
+    ~Generator() override;
+
+    bool Next(Value& out) override;
+
+    // Suspends the generator whose body is running on the calling thread.
+    static void Yield(Value v);
+
+private:
+    struct Cancelled {};
+
+    Body body_;
+    std::mutex mutex_;
+    std::condition_variable turn_;
+    bool producing_ = false;
+    bool running_ = false;
+    bool done_ = false;
+    bool cancelled_ = false;
+    std::optional<Value> slot_;
+    std::exception_ptr error_;
+    std::thread thread_;
+
+    void Run();
+};
@@ -0,0 +1,102 @@
+#include "ModuleCache.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include "semantic_analyser/SemanticAnalyser.h"
+#include "optimiser/LoopOptimiser.h"
+
+ModuleCache& ModuleCache::Instance() {
+    static ModuleCache cache;
+    return cache;
+}
+
+std::shared_ptr<const Module> ModuleCache::Load(const std::string& path) {
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(path, ec);
+    std::string key = ec ? path : canonical.string();
+    auto mtime = std::filesystem::last_write_time(key, ec);
+    if (ec) throw std::runtime_error("import: cannot open " + path);
+
+    std::promise<std::shared_ptr<const Module>> promise;
+    std::shared_future<std::shared_ptr<const Module>> result;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.MTime == mtime) return it->second.Result.get();
+        result = promise.get_future().share();
+        entries_[key] = Entry{mtime, result};
+    }
+    try {
+        promise.set_value(Compile(key));
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.MTime == mtime) entries_.erase(it);
+    }
+    return result.get();
+}
+
+void ModuleCache::Preload(const std::vector<std::string>& paths) {
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> level;
+    for (auto& p : paths)
+        if (seen.insert(p).second) level.push_back(p);
+    while (!level.empty()) {
+        std::vector<std::future<std::shared_ptr<const Module>>> pending;
+        pending.reserve(level.size());
+        for (auto& p : level)
+            pending.push_back(std::async(std::launch::async, [this, p] { return Load(p); }));
+        std::vector<std::string> next;
+        for (auto& f : pending) {
+            std::shared_ptr<const Module> module;
+            try {
+                module = f.get();
+            } catch (const std::exception&) {
+                continue;  // reported again when the import is evaluated
+            }
+            for (auto& p : module->Imports)
+                if (seen.insert(p).second) next.push_back(p);
+        }
+        level = std::move(next);
+    }
+}
+
+std::size_t ModuleCache::Compilations() const {
+    return compilations_;
+}
+
+std::shared_ptr<const Module> ModuleCache::Compile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("import: cannot open " + path);
+
+    auto module = std::make_shared<Module>();
+    module->Path = path;
+    SyntacticAnalyser parser(in);
+    module->Program = parser.Parse();
+    module->Imports = parser.Imports();
+
+    std::ostringstream errs;
+    if (!SemanticAnalyser(errs).Analyse(module->Program))
+        throw std::runtime_error("import " + path + ": " + errs.str());
+
+    {
+        std::lock_guard<std::mutex> lock(slotMutex_);
+        LoopOptimiser opt(nextSlot_);
+        opt.Optimise(module->Program);
+        std::size_t slots = opt.Slots();
+        auto band = bands_.find(path);
+        if (band == bands_.end() || band->second.Size < slots) {
+            std::size_t size = band == bands_.end() ? slots : std::max(slots, band->second.Size * 2);
+            band = bands_.insert_or_assign(path, Band{nextSlot_, size}).first;
+            nextSlot_ += size;
+        } else {
+            LoopOptimiser::Relocate(module->Program, nextSlot_, band->second.First);
+        }
+        module->FirstSlot = band->second.First;
+        module->SlotEnd = band->second.First + slots;
+    }
+    ++compilations_;
+    return module;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "syntactic_analyser/SyntacticAnalyser.h"
+
+struct Module {
+    std::string Path;
+    std::vector<Statement> Program;
+    std::vector<std::string> Imports;
+    std::size_t FirstSlot = 0;
+    std::size_t SlotEnd = 0;
+};
+
+// Process-wide cache of parsed, analysed and optimised modules, keyed by
+// canonical path. An entry is reused for as long as the file's mtime is
+// unchanged. Modules get hoisting slots from a band starting at SlotBase,
+// disjoint from the slots of the program that imports them. Each path
+// keeps its band across recompilations while it fits; one that outgrows
+// it gets a new band twice the size, so editing modules under a
+// long-lived process grows the slot tables by a bounded amount.
+class ModuleCache {
+public:
+    static constexpr std::size_t SlotBase = std::size_t{1} << 20;
+
+    static ModuleCache& Instance();
+
+    std::shared_ptr<const Module> Load(const std::string& path);
+    // Compiles `paths` and everything they import, one level at a time,
+    // with the modules of each level compiled in parallel. Failures are
+    // left for Load to report when the import is actually evaluated.
+    void Preload(const std::vector<std::string>& paths);
+    std::size_t Compilations() const;
+
+private:
+    struct Entry {
+        std::filesystem::file_time_type MTime;
+        std::shared_future<std::shared_ptr<const Module>> Result;
+    };
+
+    struct Band {
+        std::size_t First = 0;
+        std::size_t Size = 0;
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::mutex slotMutex_;
+    std::size_t nextSlot_ = SlotBase;
+    std::unordered_map<std::string, Band> bands_;
+    std::atomic<std::size_t> compilations_{0};
+
+    std::shared_ptr<const Module> Compile(const std::string& path);
+};
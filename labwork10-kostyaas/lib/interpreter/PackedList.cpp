@@ -0,0 +1,212 @@
+#include "PackedList.h"
+#include "interpreter.h"
+
+const PackedList::Storage& PackedList::Data() const {
+    static const Storage empty;
+    return storage_ ? *storage_ : empty;
+}
+
+PackedList::Storage& PackedList::Mut() {
+    if (!storage_) storage_ = MakeShared<Storage>();
+    else if (storage_.use_count() > 1) storage_ = MakeShared<Storage>(*storage_);
+    return *storage_;
+}
+
+bool PackedList::Shares(const PackedList& other) const {
+    return storage_ && storage_ == other.storage_;
+}
+
+std::size_t PackedList::size() const {
+    return std::visit([](auto&& s) -> std::size_t {
+        using T = std::decay_t<decltype(s)>;
+        if constexpr (std::is_same_v<T, std::monostate>) return 0;
+        else return s.size();
+    }, Data());
+}
+
+bool PackedList::empty() const {
+    return size() == 0;
+}
+
+PackedList::Shape PackedList::GetShape() const {
+    return static_cast<Shape>(Data().index());
+}
+
+std::size_t PackedList::ElementBytes() const {
+    switch (GetShape()) {
+        case Shape::Number:  return sizeof(double);
+        case Shape::Integer: return sizeof(int64_t);
+        case Shape::String:  return sizeof(std::string);
+        case Shape::Generic: return sizeof(std::shared_ptr<Value>) + sizeof(Value);
+        default:             return 0;
+    }
+}
+
+Value PackedList::At(std::size_t i) const {
+    if (auto pi = std::get_if<Integers>(&Data())) return Value((*pi)[i]);
+    if (auto pn = std::get_if<Numbers>(&Data())) return Value((*pn)[i]);
+    if (auto ps = std::get_if<Strings>(&Data())) return Value((*ps)[i]);
+    if (auto pg = std::get_if<Generic>(&Data())) return *(*pg)[i];
+    throw std::runtime_error("Array index out of range");
+}
+
+void PackedList::Set(std::size_t i, const Value& v) {
+    Prepare(v);
+    auto& st = Mut();
+    if (auto pi = std::get_if<Integers>(&st)) {
+        (*pi)[i] = std::get<int64_t>(v.data);
+    } else if (auto pn = std::get_if<Numbers>(&st)) {
+        (*pn)[i] = v.AsDouble();
+    } else if (auto ps = std::get_if<Strings>(&st)) {
+        (*ps)[i] = std::get<std::string>(v.data);
+    } else if (auto pg = std::get_if<Generic>(&st)) {
+        (*pg)[i] = MakeShared<Value>(v);
+    } else {
+        throw std::runtime_error("Array index out of range");
+    }
+}
+
+void PackedList::Push(const Value& v) {
+    if (std::holds_alternative<std::monostate>(Data())) Adopt(v);
+    else Prepare(v);
+    auto& st = Mut();
+    if (auto pi = std::get_if<Integers>(&st)) {
+        pi->push_back(std::get<int64_t>(v.data));
+    } else if (auto pn = std::get_if<Numbers>(&st)) {
+        pn->push_back(v.AsDouble());
+    } else if (auto ps = std::get_if<Strings>(&st)) {
+        ps->push_back(std::get<std::string>(v.data));
+    } else {
+        std::get<Generic>(st).push_back(MakeShared<Value>(v));
+    }
+}
+
+void PackedList::Push(double v) {
+    if (std::holds_alternative<std::monostate>(Data())) Replace(Numbers{});
+    if (std::holds_alternative<Integers>(Data())) Widen();
+    if (!std::holds_alternative<Numbers>(Data())) Upgrade();
+    auto& st = Mut();
+    if (auto pn = std::get_if<Numbers>(&st)) pn->push_back(v);
+    else std::get<Generic>(st).push_back(MakeShared<Value>(v));
+}
+
+void PackedList::Push(int64_t v) {
+    if (std::holds_alternative<std::monostate>(Data())) Replace(Integers{});
+    if (!std::holds_alternative<Integers>(Data()) && !std::holds_alternative<Numbers>(Data())) Upgrade();
+    auto& st = Mut();
+    if (auto pi = std::get_if<Integers>(&st)) pi->push_back(v);
+    else if (auto pn = std::get_if<Numbers>(&st)) pn->push_back(static_cast<double>(v));
+    else std::get<Generic>(st).push_back(MakeShared<Value>(v));
+}
+
+void PackedList::Reserve(std::size_t n) {
+    std::visit([n](auto&& s) {
+        using T = std::decay_t<decltype(s)>;
+        if constexpr (!std::is_same_v<T, std::monostate>) s.reserve(n);
+    }, Mut());
+}
+
+void PackedList::Append(const PackedList& other) {
+    if (other.empty()) return;
+    if (empty()) {
+        storage_ = other.storage_;
+        return;
+    }
+    const auto& o = other.Data();
+    if (std::holds_alternative<Integers>(Data()) && std::holds_alternative<Numbers>(o)) {
+        Widen();
+    }
+    if (std::holds_alternative<Numbers>(Data()) && std::holds_alternative<Integers>(o)) {
+        auto& n = std::get<Numbers>(Mut());
+        for (int64_t v : std::get<Integers>(o)) n.push_back(static_cast<double>(v));
+        return;
+    }
+    if (Data().index() == o.index() && !std::holds_alternative<Generic>(o)) {
+        std::visit([&o](auto&& s) {
+            using T = std::decay_t<decltype(s)>;
+            if constexpr (!std::is_same_v<T, std::monostate>) {
+                auto& items = std::get<T>(o);
+                s.insert(s.end(), items.begin(), items.end());
+            }
+        }, Mut());
+        return;
+    }
+    Upgrade();
+    auto& g = std::get<Generic>(Mut());
+    g.reserve(g.size() + other.size());
+    for (std::size_t i = 0; i < other.size(); ++i) {
+        g.push_back(MakeShared<Value>(other.At(i)));
+    }
+}
+
+PackedList PackedList::Slice(std::size_t from, std::size_t to) const {
+    PackedList res;
+    if (from >= to) return res;
+    std::visit([&](auto&& s) {
+        using T = std::decay_t<decltype(s)>;
+        if constexpr (std::is_same_v<T, Generic>) {
+            Generic g;
+            g.reserve(to - from);
+            for (std::size_t i = from; i < to; ++i) g.push_back(MakeShared<Value>(*s[i]));
+            res.Replace(std::move(g));
+        } else if constexpr (!std::is_same_v<T, std::monostate>) {
+            res.Replace(T(s.begin() + from, s.begin() + to));
+        }
+    }, Data());
+    return res;
+}
+
+const PackedList::Numbers* PackedList::GetNumbers() const {
+    return std::get_if<Numbers>(&Data());
+}
+
+const PackedList::Strings* PackedList::GetStrings() const {
+    return std::get_if<Strings>(&Data());
+}
+
+const PackedList::Generic* PackedList::GetGeneric() const {
+    return std::get_if<Generic>(&Data());
+}
+
+const PackedList::Integers* PackedList::GetIntegers() const {
+    return std::get_if<Integers>(&Data());
+}
+
+bool PackedList::Fits(const Value& v) const {
+    if (std::holds_alternative<Integers>(Data())) return std::holds_alternative<int64_t>(v.data);
+    if (std::holds_alternative<Numbers>(Data())) return v.IsNumber();
+    if (std::holds_alternative<Strings>(Data())) return std::holds_alternative<std::string>(v.data);
+    return true;
+}
+
+void PackedList::Adopt(const Value& v) {
+    if (std::holds_alternative<int64_t>(v.data)) Replace(Integers{});
+    else if (std::holds_alternative<double>(v.data)) Replace(Numbers{});
+    else if (std::holds_alternative<std::string>(v.data)) Replace(Strings{});
+    else Replace(Generic{});
+}
+
+void PackedList::Prepare(const Value& v) {
+    if (std::holds_alternative<Integers>(Data()) && std::holds_alternative<double>(v.data)) Widen();
+    else if (!Fits(v)) Upgrade();
+}
+
+void PackedList::Replace(Storage s) {
+    if (storage_ && storage_.use_count() == 1) *storage_ = std::move(s);
+    else storage_ = MakeShared<Storage>(std::move(s));
+}
+
+void PackedList::Widen() {
+    const auto& ints = std::get<Integers>(Data());
+    Replace(Numbers(ints.begin(), ints.end()));
+}
+
+void PackedList::Upgrade() {
+    if (std::holds_alternative<Generic>(Data())) return;
+    Generic g;
+    g.reserve(size());
+    for (std::size_t i = 0; i < size(); ++i) {
+        g.push_back(MakeShared<Value>(At(i)));
+    }
+    Replace(std::move(g));
+}
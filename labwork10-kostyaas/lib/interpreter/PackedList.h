@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+struct Value;
+
+class PackedList {
+public:
+    enum class Shape { Empty, Number, String, Generic, Integer };
+
+    using Numbers  = std::vector<double>;
+    using Strings  = std::vector<std::string>;
+    using Generic  = std::vector<std::shared_ptr<Value>>;
+    using Integers = std::vector<int64_t>;
+
+    PackedList() = default;
+
+    // Copies share storage; the first mutation of a shared list clones it.
+
+    std::size_t size() const;
+    bool empty() const;
+    Shape GetShape() const;
+    // Storage one element takes in the list's current shape; the text of
+    // strings is not included.
+    std::size_t ElementBytes() const;
+
+    Value At(std::size_t i) const;
+    void Set(std::size_t i, const Value& v);
+    void Push(const Value& v);
+    void Push(double v);
+    void Push(int64_t v);
+    void Reserve(std::size_t n);
+    void Append(const PackedList& other);
+    PackedList Slice(std::size_t from, std::size_t to) const;
+
+    const Numbers* GetNumbers() const;
+    const Strings* GetStrings() const;
+    const Generic* GetGeneric() const;
+    const Integers* GetIntegers() const;
+
+    bool Shares(const PackedList& other) const;
+
+private:
+    using Storage = std::variant<std::monostate, Numbers, Strings, Generic, Integers>;
+
+    std::shared_ptr<Storage> storage_;
+
+    const Storage& Data() const;
+    Storage& Mut();
+    void Replace(Storage s);
+
+    bool Fits(const Value& v) const;
+    void Adopt(const Value& v);
+    void Prepare(const Value& v);
+    void Widen();
+    void Upgrade();
+};
@@ -0,0 +1,158 @@
+#include "interpreter.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+namespace {
+
+// Lists shorter than two chunks run on the calling thread. Longer ones are
+// cut into at most MaxChunks pieces, so the partial results preduce combines
+// depend on the list length only, not on the number of cores.
+constexpr std::size_t MinChunk = 256;
+constexpr std::size_t MaxChunks = 64;
+
+const Value::Array& ListArg(const std::vector<Value>& args, const char* fn) {
+    if (args.empty() || !std::holds_alternative<Value::Array>(args[0].data))
+        throw std::runtime_error(std::string(fn) + "() expects a list as argument 1");
+    return std::get<Value::Array>(args[0].data);
+}
+
+const Value::FuncPtr& FuncArg(const std::vector<Value>& args, const char* fn) {
+    if (args.size() < 2 || !std::holds_alternative<Value::FuncPtr>(args[1].data))
+        throw std::runtime_error(std::string(fn) + "() expects a function as argument 2");
+    return std::get<Value::FuncPtr>(args[1].data);
+}
+
+}
+
+// A function may run on several threads when the optimiser found its body
+// pure, the names it assigns are unbound in its closure, and every function
+// it calls by name qualifies as well.
+bool Interpreter::IsParallel(const Value::FuncPtr& fn, std::unordered_set<const FunctionObject*>& seen) {
+    if (fn->native || fn->generator || !fn->literal || !fn->literal->Pure) return false;
+    if (!seen.insert(fn.get()).second) return true;
+    for (const auto& name : fn->literal->Locals) {
+        if (fn->closure->Find(name)) return false;
+    }
+    for (const auto& name : fn->literal->Calls) {
+        Value* v = fn->closure->Find(name);
+        auto callee = v ? std::get_if<Value::FuncPtr>(&v->data) : nullptr;
+        if (!callee || !IsParallel(*callee, seen)) return false;
+    }
+    return true;
+}
+
+// Calls body over consecutive chunks of [0, n) and returns the number of
+// chunks. Chunks go to worker interpreters on their own threads when `fn`
+// may run in parallel; otherwise the whole range is one chunk on this one.
+// Workers start from this interpreter's step count and deadline and their
+// steps are added back afterwards, so each may spend the remaining budget.
+std::size_t Interpreter::ForChunks(std::size_t n, const Value::FuncPtr& fn, const ChunkFn& body) {
+    std::unordered_set<const FunctionObject*> seen;
+    if (n < 2 * MinChunk || !IsParallel(fn, seen)) {
+        body(*this, 0, 0, n);
+        return 1;
+    }
+    std::size_t size = (n + MaxChunks - 1) / MaxChunks;
+    size = std::max(size, MinChunk);
+    std::size_t chunks = (n + size - 1) / size;
+    std::size_t threads = std::min<std::size_t>(chunks, std::max(1u, std::thread::hardware_concurrency()));
+
+    while (workers_.size() < threads) {
+        workers_.emplace_back(new Interpreter(output_, limits_));
+        workers_.back()->range_ = range_;
+    }
+    uint64_t base = stats_.Steps;
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (std::size_t t = 0; t < threads; ++t) {
+        Interpreter& worker = *workers_[t];
+        worker.hoisted_.resize(hoisted_.size());
+        worker.moduleHoisted_.resize(moduleHoisted_.size());
+        worker.start_ = start_;
+        worker.stats_.Steps = base;
+        worker.nextCheck_ = nextCheck_;
+        pool.emplace_back([&] {
+            RunArena::Scope arena(&worker.arena_);
+            for (std::size_t c = next++; c < chunks && !failed; c = next++) {
+                try {
+                    body(worker, c, c * size, std::min(n, (c + 1) * size));
+                } catch (...) {
+                    errors[c] = std::current_exception();
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+
+    for (std::size_t t = 0; t < threads; ++t) {
+        stats_.Steps += workers_[t]->stats_.Steps - base;
+        stats_.LargestAllocation = std::max(stats_.LargestAllocation, workers_[t]->stats_.LargestAllocation);
+    }
+    for (auto& e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+    if (stats_.Steps >= nextCheck_) CheckLimits();
+    return chunks;
+}
+
+void Interpreter::ParallelFunctions() {
+    DefineNative("pmap", [this](const std::vector<Value>& args) -> Value {
+        const auto& list = ListArg(args, "pmap");
+        const auto& fn = FuncArg(args, "pmap");
+        std::vector<Value> out(list.size());
+        ForChunks(list.size(), fn, [&](Interpreter& in, std::size_t, std::size_t from, std::size_t to) {
+            for (std::size_t i = from; i < to; ++i) out[i] = in.PerformFunction(fn, {list.At(i)});
+        });
+        Value::Array res;
+        for (auto& v : out) res.Push(v);
+        return Value(std::move(res));
+    });
+
+    DefineNative("pfilter", [this](const std::vector<Value>& args) -> Value {
+        const auto& list = ListArg(args, "pfilter");
+        const auto& fn = FuncArg(args, "pfilter");
+        std::vector<char> keep(list.size());
+        ForChunks(list.size(), fn, [&](Interpreter& in, std::size_t, std::size_t from, std::size_t to) {
+            for (std::size_t i = from; i < to; ++i) keep[i] = in.IsTruthy(in.PerformFunction(fn, {list.At(i)}));
+        });
+        Value::Array res;
+        for (std::size_t i = 0; i < list.size(); ++i) {
+            if (keep[i]) res.Push(list.At(i));
+        }
+        return Value(std::move(res));
+    });
+
+    // A plain left fold on the calling thread. Given a combiner as argument
+    // 4, chunks are folded separately, each from `init`, and the partial
+    // results are merged in order with the combiner; this equals the left
+    // fold when `init` is the combiner's identity and the combiner is
+    // associative.
+    DefineNative("preduce", [this](const std::vector<Value>& args) -> Value {
+        const auto& list = ListArg(args, "preduce");
+        const auto& fn = FuncArg(args, "preduce");
+        if (args.size() < 3) throw std::runtime_error("preduce() expects an initial value as argument 3");
+        if (args.size() < 4) {
+            Value acc = args[2];
+            for (std::size_t i = 0; i < list.size(); ++i) acc = PerformFunction(fn, {acc, list.At(i)});
+            return acc;
+        }
+        if (!std::holds_alternative<Value::FuncPtr>(args[3].data))
+            throw std::runtime_error("preduce() expects a function as argument 4");
+        const auto& combine = std::get<Value::FuncPtr>(args[3].data);
+        std::vector<Value> partial(MaxChunks);
+        std::size_t chunks = ForChunks(list.size(), fn, [&](Interpreter& in, std::size_t c, std::size_t from, std::size_t to) {
+            Value acc = args[2];
+            for (std::size_t i = from; i < to; ++i) acc = in.PerformFunction(fn, {acc, list.At(i)});
+            partial[c] = std::move(acc);
+        });
+        Value acc = std::move(partial[0]);
+        for (std::size_t c = 1; c < chunks; ++c) acc = PerformFunction(combine, {acc, partial[c]});
+        return acc;
+    });
+}
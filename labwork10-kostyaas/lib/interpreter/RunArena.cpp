@@ -0,0 +1,74 @@
+#include "RunArena.h"
+#include <algorithm>
+
+namespace {
+
+thread_local RunArena* Active = nullptr;
+
+}
+
+RunArena::RunArena(bool pooled, bool profiled)
+    : pooled_(pooled), profile_(profiled ? std::make_unique<HeapProfile>() : nullptr) {}
+
+RunArena* RunArena::Current() {
+    return Active;
+}
+
+std::pmr::memory_resource* RunArena::Memory() {
+    return Active ? Active : std::pmr::get_default_resource();
+}
+
+RunArena::Scope::Scope(RunArena* arena) : saved_(Active) {
+    Active = arena;
+}
+
+RunArena::Scope::~Scope() {
+    Active = saved_;
+}
+
+void* RunArena::do_allocate(std::size_t bytes, std::size_t align) {
+    ++allocations_;
+    live_ += bytes;
+    peak_ = std::max(peak_, live_);
+    void* p = Take(bytes, align);
+    if (profile_) profile_->Allocated(p, bytes);
+    return p;
+}
+
+void* RunArena::Take(std::size_t bytes, std::size_t align) {
+    std::size_t cls = (bytes + Granule - 1) / Granule;
+    if (!pooled_ || cls == 0 || cls > Classes || align > Granule) {
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    if (FreeBlock* block = free_[cls - 1]) {
+        free_[cls - 1] = block->next;
+        return block;
+    }
+    std::size_t size = cls * Granule;
+    if (static_cast<std::size_t>(limit_ - cursor_) < size) {
+        chunks_.emplace_back(new std::byte[ChunkBytes]);
+        cursor_ = chunks_.back().get();
+        limit_ = cursor_ + ChunkBytes;
+    }
+    void* p = cursor_;
+    cursor_ += size;
+    return p;
+}
+
+void RunArena::do_deallocate(void* p, std::size_t bytes, std::size_t align) {
+    live_ -= bytes;
+    if (profile_) profile_->Released(p);
+
+    std::size_t cls = (bytes + Granule - 1) / Granule;
+    if (!pooled_ || cls == 0 || cls > Classes || align > Granule) {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+        return;
+    }
+    auto block = static_cast<FreeBlock*>(p);
+    block->next = free_[cls - 1];
+    free_[cls - 1] = block;
+}
+
+bool RunArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
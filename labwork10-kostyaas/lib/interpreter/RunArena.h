@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+#include "HeapProfile.h"
+
+// Memory for the runtime values of one Interpret run: boxed list elements,
+// list storage, maps, functions and iterators. Small blocks are carved from
+// large chunks and recycled through per-size free lists; the chunks go back
+// to the system in one step when the arena is destroyed. Larger or
+// over-aligned blocks, and every block when `pooled` is false, are passed to
+// the global allocator, so the counters can be compared between the two.
+//
+// With `profiled` every block is also reported to a HeapProfile; without
+// it the profile does not exist and costs one test per block.
+//
+// An arena is used by one thread at a time; generator threads take turns
+// with the thread that drives them.
+class RunArena : public std::pmr::memory_resource {
+public:
+    explicit RunArena(bool pooled = true, bool profiled = false);
+
+    uint64_t Allocations() const { return allocations_; }
+    std::size_t PeakBytes() const { return peak_; }
+    HeapProfile* Profile() const { return profile_.get(); }
+
+    // The arena of the run executing on this thread, or nullptr.
+    static RunArena* Current();
+    // The current arena, or the default resource outside a run.
+    static std::pmr::memory_resource* Memory();
+
+    // Makes `arena` current on this thread until the scope ends.
+    class Scope {
+    public:
+        explicit Scope(RunArena* arena);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        RunArena* saved_;
+    };
+
+private:
+    static constexpr std::size_t Granule = 16;
+    static constexpr std::size_t Classes = 16;
+    static constexpr std::size_t ChunkBytes = std::size_t{64} << 10;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    bool pooled_;
+    std::unique_ptr<HeapProfile> profile_;
+    FreeBlock* free_[Classes] = {};
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+    std::byte* cursor_ = nullptr;
+    std::byte* limit_ = nullptr;
+    uint64_t allocations_ = 0;
+    std::size_t live_ = 0;
+    std::size_t peak_ = 0;
+
+    void* Take(std::size_t bytes, std::size_t align);
+    void* do_allocate(std::size_t bytes, std::size_t align) override;
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Heap profile category of a runtime object: types declare a static HeapTag,
+// everything else is list storage or a boxed list element.
+template <class T>
+constexpr HeapKind HeapKindOf() {
+    if constexpr (requires { T::HeapTag; }) return T::HeapTag;
+    else return HeapKind::List;
+}
+
+// std::make_shared that draws from the current run's arena when there is one.
+template <class T, class... Args>
+std::shared_ptr<T> MakeShared(Args&&... args) {
+    if (auto arena = RunArena::Current()) {
+        std::pmr::polymorphic_allocator<T> alloc(arena);
+        if (arena->Profile()) {
+            HeapProfile::KindScope kind(HeapKindOf<T>());
+            return std::allocate_shared<T>(alloc, std::forward<Args>(args)...);
+        }
+        return std::allocate_shared<T>(alloc, std::forward<Args>(args)...);
+    }
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
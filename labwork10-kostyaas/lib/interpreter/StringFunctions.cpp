@@ -0,0 +1,133 @@
+#include "interpreter.h"
+#include <cstring>
+#include <string_view>
+
+const std::string& StringArg(const std::vector<Value>& args, size_t i, const char* fn) {
+    if (i >= args.size() || !std::holds_alternative<std::string>(args[i].data))
+        throw std::runtime_error(std::string(fn) + "() expects string argument " + std::to_string(i + 1));
+    return std::get<std::string>(args[i].data);
+}
+
+namespace {
+
+size_t FindIn(std::string_view s, std::string_view sub, size_t from) {
+    if (sub.size() == 1) {
+        if (from >= s.size()) return std::string_view::npos;
+        auto p = static_cast<const char*>(std::memchr(s.data() + from, sub[0], s.size() - from));
+        return p ? static_cast<size_t>(p - s.data()) : std::string_view::npos;
+    }
+    return s.find(sub, from);
+}
+
+template<typename F>
+std::string MapChars(const std::string& s, F f) {
+    std::string res(s.size(), '\0');
+    for (size_t i = 0; i < s.size(); ++i) res[i] = f(s[i]);
+    return res;
+}
+
+}
+
+void Interpreter::DefineNative(const std::string& name, FunctionObject::NativeFn fn) {
+    globals_.Define(name, Value(MakeShared<FunctionObject>(std::move(fn))));
+}
+
+void Interpreter::StringFunctions() {
+    DefineNative("split", [](const std::vector<Value>& args) -> Value {
+        const std::string& s = StringArg(args, 0, "split");
+        const std::string& delim = StringArg(args, 1, "split");
+        Value::Array res;
+        if (delim.empty()) {
+            for (char c : s) res.Push(Value(std::string(1, c)));
+            return Value(std::move(res));
+        }
+        size_t start = 0;
+        for (size_t pos; (pos = FindIn(s, delim, start)) != std::string::npos; start = pos + delim.size())
+            res.Push(Value(s.substr(start, pos - start)));
+        res.Push(Value(s.substr(start)));
+        return Value(std::move(res));
+    });
+
+    DefineNative("join", [this](const std::vector<Value>& args) -> Value {
+        if (args.empty() || !std::holds_alternative<Value::Array>(args[0].data))
+            throw std::runtime_error("join() expects list argument 1");
+        const auto& list = std::get<Value::Array>(args[0].data);
+        std::string_view delim = args.size() > 1 ? std::string_view(StringArg(args, 1, "join")) : std::string_view();
+        if (list.empty()) return Value(std::string());
+        // A list of strings is usually packed, but one that held other
+        // values keeps the generic shape after they are replaced.
+        std::vector<const std::string*> parts;
+        parts.reserve(list.size());
+        if (auto strings = list.GetStrings()) {
+            for (const auto& s : *strings) parts.push_back(&s);
+        } else if (auto generic = list.GetGeneric()) {
+            for (const auto& v : *generic) {
+                auto s = std::get_if<std::string>(&v->data);
+                if (!s) throw std::runtime_error("join() expects list of strings");
+                parts.push_back(s);
+            }
+        } else {
+            throw std::runtime_error("join() expects list of strings");
+        }
+        size_t total = delim.size() * (parts.size() - 1);
+        for (const auto* p : parts) total += p->size();
+        ChargeHeap(total, HeapKind::String);
+        std::string res;
+        res.reserve(total);
+        for (size_t i = 0; i < parts.size(); ++i) {
+            if (i) res.append(delim);
+            res.append(*parts[i]);
+        }
+        return Value(std::move(res));
+    });
+
+    DefineNative("find", [](const std::vector<Value>& args) -> Value {
+        const std::string& s = StringArg(args, 0, "find");
+        const std::string& sub = StringArg(args, 1, "find");
+        size_t pos = sub.empty() ? 0 : FindIn(s, sub, 0);
+        return Value(pos == std::string::npos ? int64_t{-1} : static_cast<int64_t>(pos));
+    });
+
+    DefineNative("replace", [](const std::vector<Value>& args) -> Value {
+        const std::string& s = StringArg(args, 0, "replace");
+        const std::string& from = StringArg(args, 1, "replace");
+        const std::string& to = StringArg(args, 2, "replace");
+        if (from.empty()) return Value(s);
+        std::string res;
+        res.reserve(s.size());
+        size_t start = 0;
+        for (size_t pos; (pos = FindIn(s, from, start)) != std::string::npos; start = pos + from.size()) {
+            res.append(s, start, pos - start);
+            res.append(to);
+        }
+        res.append(s, start);
+        return Value(std::move(res));
+    });
+
+    DefineNative("lower", [](const std::vector<Value>& args) -> Value {
+        return Value(MapChars(StringArg(args, 0, "lower"), [](char c) -> char {
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+        }));
+    });
+
+    DefineNative("upper", [](const std::vector<Value>& args) -> Value {
+        return Value(MapChars(StringArg(args, 0, "upper"), [](char c) -> char {
+            return (c >= 'a' && c <= 'z') ? static_cast<char>(c - ('a' - 'A')) : c;
+        }));
+    });
+
+    DefineNative("strip", [](const std::vector<Value>& args) -> Value {
+        std::string_view s = StringArg(args, 0, "strip");
+        constexpr std::string_view ws = " \t\n\r\f\v";
+        size_t b = s.find_first_not_of(ws);
+        if (b == std::string_view::npos) return Value(std::string());
+        size_t e = s.find_last_not_of(ws);
+        return Value(std::string(s.substr(b, e - b + 1)));
+    });
+
+    DefineNative("startswith", [](const std::vector<Value>& args) -> Value {
+        const std::string& s = StringArg(args, 0, "startswith");
+        const std::string& prefix = StringArg(args, 1, "startswith");
+        return Value(std::string_view(s).starts_with(prefix));
+    });
+}
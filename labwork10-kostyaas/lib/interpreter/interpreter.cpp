@@ -1,16 +1,40 @@
 #include "Interpreter.h"
+#include "HashMap.h"
+#include "Iterators.h"
 #include "utils/ParseExpression.h"
+#include <sstream>
 
 Value::Value() : data(NilType{}) {}
 Value::Value(double v)            : data(v) {}
+Value::Value(int64_t v)           : data(v) {}
 Value::Value(const std::string& v): data(v) {}
+Value::Value(std::string&& v)     : data(std::move(v)) {}
 Value::Value(bool v)              : data(v) {}
 Value::Value(NilType v)           : data(v) {}
 Value::Value(const Array& v)      : data(v) {}
+Value::Value(Array&& v)           : data(std::move(v)) {}
 Value::Value(FuncPtr v)           : data(v) {}
+Value::Value(MapPtr v)            : data(v) {}
+Value::Value(IterPtr v)           : data(v) {}
 
-Environment::Environment(): parent_(nullptr) {}
-Environment::Environment(Environment* parent): parent_(parent) {}
+bool Value::IsNumber() const {
+    return std::holds_alternative<int64_t>(data) || std::holds_alternative<double>(data);
+}
+
+double Value::AsDouble() const {
+    if (auto pi = std::get_if<int64_t>(&data)) return static_cast<double>(*pi);
+    if (auto pd = std::get_if<double>(&data)) return *pd;
+    throw std::runtime_error("Operand is not a number");
+}
+
+int64_t Value::AsIndex() const {
+    if (auto pi = std::get_if<int64_t>(&data)) return *pi;
+    if (auto pd = std::get_if<double>(&data)) return static_cast<int64_t>(*pd);
+    throw std::runtime_error("Index is not a number");
+}
+
+Environment::Environment(): parent_(nullptr), values_(RunArena::Memory()) {}
+Environment::Environment(Environment* parent): parent_(parent), values_(RunArena::Memory()) {}
 
 bool Environment::Define(const std::string& name, Value val) {
     if (values_.count(name)) return false;
@@ -33,65 +57,219 @@ Value Environment::Get(const std::string& name) const {
     throw std::runtime_error("Undefined variable: " + name);
 }
 
+const std::pmr::unordered_map<std::string, Value>& Environment::Values() const {
+    return values_;
+}
+
+Value* Environment::Find(const std::string& name) {
+    auto it = values_.find(name);
+    if (it != values_.end()) return &it->second;
+    if (parent_) return parent_->Find(name);
+    return nullptr;
+}
+
 ReturnException::ReturnException(Value v) : std::runtime_error("Return"), value(std::move(v)) {}
 
-FunctionObject::FunctionObject(std::vector<std::string> p, const std::vector<Statement>* b, Environment* c) : params(std::move(p)), body(b), closure(c), native(nullptr) {}
+FunctionObject::FunctionObject(std::vector<std::string> p, const std::vector<Statement>* b, Environment* c, bool g) : params(std::move(p)), body(b), closure(c), native(nullptr), generator(g) {}
 
-FunctionObject::FunctionObject(NativeFn fn) : params(), body(nullptr), closure(nullptr), native(std::move(fn)) {}
+FunctionObject::FunctionObject(NativeFn fn) : params(), body(nullptr), closure(nullptr), native(std::move(fn)), generator(false) {}
 
 
-bool Interpreter::Interpret(std::istream& in, std::ostream& out) {
+bool Interpreter::Interpret(std::istream& in, std::ostream& out,
+                            const ExecutionLimits& limits, ExecutionStats* stats) {
+    std::shared_ptr<const CompiledScript> script;
     try {
-        SyntacticAnalyser parser(in);
-        auto program = parser.Parse();
+        script = Compile(in);
+    } catch (const std::exception& e) {
+        std::cerr << "Interpreter error: " << e.what() << "\n";
+        if (stats) *stats = ExecutionStats{};
+        return false;
+    }
+    return Run(*script, out, std::cin, std::cerr, limits, stats);
+}
 
-        SemanticAnalyser sem(out);
-        if (!sem.Analyse(program)) {
-            return false;
-        }
+std::shared_ptr<const CompiledScript> Interpreter::Compile(std::istream& in) {
+    auto script = std::make_shared<CompiledScript>();
+    SyntacticAnalyser parser(in);
+    script->Program = parser.Parse();
+    script->Imports = parser.Imports();
 
-        Interpreter interp(out);
+    std::ostringstream diagnostics;
+    script->Valid = SemanticAnalyser(diagnostics).Analyse(script->Program);
+    script->Diagnostics = diagnostics.str();
+    if (!script->Valid) return script;
+    ModuleCache::Instance().Preload(script->Imports);
+
+    LoopOptimiser opt;
+    opt.Optimise(script->Program);
+    script->Slots = opt.Slots();
+    script->OptimiserReport = opt.Report();
+    return script;
+}
+
+bool Interpreter::Run(const CompiledScript& script, std::ostream& out, std::istream& input,
+                      std::ostream& errors, const ExecutionLimits& limits, ExecutionStats* stats) {
+    out << script.Diagnostics;
+    if (!script.Valid) {
+        if (stats) *stats = ExecutionStats{};
+        return false;
+    }
+    Interpreter interp(out, limits);
+    interp.input_ = &input;
+    RunArena::Scope arena(&interp.arena_);
+    bool ok = false;
+    try {
+        interp.hoisted_.resize(script.Slots);
         interp.Functions();
-        interp.ParseList(program, &interp.globals_);
-        return true;
+        interp.StringFunctions();
+        interp.FileFunctions();
+        interp.ParallelFunctions();
+        interp.StartClock();
+        interp.ParseList(script.Program, &interp.globals_);
+        ok = true;
+    } catch (const LimitExceeded& e) {
+        interp.stats_.Aborted = true;
+        interp.stats_.AbortReason = e.what();
+        errors << "Interpreter aborted: " << e.what() << "\n";
     } catch (const std::exception& e) {
-        std::cerr << "Interpreter error: " << e.what() << "\n";
-        return false;
+        errors << "Interpreter error: " << e.what() << "\n";
     } catch (...) {
-        std::cerr << "Interpreter error: unknown\n";
-        return false;
+        errors << "Interpreter error: unknown\n";
+    }
+    if (stats) {
+        if (interp.start_ != std::chrono::steady_clock::time_point{})
+            interp.stats_.Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - interp.start_);
+        interp.stats_.Allocations = interp.arena_.Allocations();
+        interp.stats_.PeakBytes = interp.arena_.PeakBytes();
+        for (auto& worker : interp.workers_) {
+            interp.stats_.Allocations += worker->arena_.Allocations();
+            interp.stats_.PeakBytes += worker->arena_.PeakBytes();
+        }
+        *stats = interp.stats_;
+    }
+    if (interp.heap_) {
+        auto report = std::make_shared<HeapReport>(interp.CollectHeapReport());
+        report->Print(errors);
+        if (stats) stats->Heap = std::move(report);
+    }
+    return ok;
+}
+
+Interpreter::Interpreter(std::ostream& out, const ExecutionLimits& limits)
+    : arena_(limits.PooledValues, limits.ProfileHeap), globals_(), output_(out), limits_(limits),
+      heap_(arena_.Profile()) {}
+
+void Interpreter::StartClock() {
+    start_ = std::chrono::steady_clock::now();
+    bool timed = limits_.Deadline.count() > 0;
+    if (timed)
+        nextCheck_ = CheckInterval;
+    if (limits_.MaxSteps && (!timed || limits_.MaxSteps < nextCheck_))
+        nextCheck_ = limits_.MaxSteps;
+    if (heap_)
+        nextCheck_ = std::min(nextCheck_, heap_->NextSample());
+}
+
+void Interpreter::CheckLimits() {
+    if (limits_.MaxSteps && stats_.Steps >= limits_.MaxSteps)
+        throw LimitExceeded("step budget of " + std::to_string(limits_.MaxSteps) + " exhausted");
+    if (limits_.Deadline.count() > 0) {
+        if (std::chrono::steady_clock::now() - start_ >= limits_.Deadline)
+            throw LimitExceeded("deadline of " + std::to_string(limits_.Deadline.count()) + " ms exceeded");
+        nextCheck_ = stats_.Steps + CheckInterval;
+    } else {
+        nextCheck_ = UINT64_MAX;
+    }
+    if (limits_.MaxSteps && limits_.MaxSteps < nextCheck_)
+        nextCheck_ = limits_.MaxSteps;
+    // Steps are counted at loop back-edges and calls, so this is where the
+    // heap size series is sampled.
+    if (heap_) {
+        heap_->Sample(stats_.Steps);
+        nextCheck_ = std::min(nextCheck_, heap_->NextSample());
+    }
+}
+
+void Interpreter::ChargeLargeHeap(std::size_t bytes, HeapKind kind) {
+    if (heap_) heap_->Built(kind, bytes);
+    if (bytes > stats_.LargestAllocation)
+        stats_.LargestAllocation = bytes;
+    if (limits_.MaxAllocationBytes && bytes > limits_.MaxAllocationBytes)
+        throw LimitExceeded("allocation of " + std::to_string(bytes) + " bytes exceeds the cap of " +
+                            std::to_string(limits_.MaxAllocationBytes));
+    if (!heap_) heapWatermark_ = stats_.LargestAllocation;
+}
+
+HeapReport Interpreter::CollectHeapReport() const {
+    HeapReport report = heap_->Report();
+    for (const auto& worker : workers_) report.Merge(worker->heap_->Report());
+    return report;
+}
+
+Interpreter::HoistScope::HoistScope(Interpreter& interp, const std::vector<std::size_t>& slots)
+    : interp_(interp), slots_(slots) {
+    if (slots_.empty()) return;
+    saved_.reserve(slots_.size());
+    for (auto slot : slots_) {
+        auto& cached = interp_.HoistSlot(slot);
+        saved_.push_back(std::move(cached));
+        cached.reset();
     }
 }
 
-Interpreter::Interpreter(std::ostream& out) : globals_(), output_(out) {}
+Interpreter::HoistScope::~HoistScope() {
+    for (size_t i = 0; i < saved_.size(); ++i)
+        interp_.HoistSlot(slots_[i]) = std::move(saved_[i]);
+}
+
+// Runs a module once per interpreter and exposes its top-level names as a
+// map. The compiled tree comes from the process-wide ModuleCache.
+Value Interpreter::Import(const std::string& path) {
+    auto module = ModuleCache::Instance().Load(path);
+    auto found = modules_.find(module->Path);
+    if (found != modules_.end()) {
+        if (!found->second.env)
+            throw std::runtime_error("Circular import of " + module->Path);
+        return found->second.exports;
+    }
+    auto& instance = modules_[module->Path];
+    instance.module = module;
+    size_t needed = module->SlotEnd - ModuleCache::SlotBase;
+    if (moduleHoisted_.size() < needed) moduleHoisted_.resize(needed);
+
+    auto env = std::make_unique<Environment>(&globals_);
+    try {
+        for (const auto& st : module->Program) Perform(st, env.get());
+    } catch (...) {
+        modules_.erase(module->Path);
+        throw;
+    }
+
+    std::vector<const std::string*> names;
+    for (const auto& [name, value] : env->Values()) names.push_back(&name);
+    std::sort(names.begin(), names.end(), [](auto a, auto b) { return *a < *b; });
+    auto exports = MakeShared<HashMap>();
+    for (auto name : names) exports->Set(Value(*name), env->Values().at(*name));
+
+    instance.env = std::move(env);
+    instance.exports = Value(exports);
+    return instance.exports;
+}
 
 void Interpreter::Functions() {
+    DefineNative("read", [this](const std::vector<Value>&) -> Value {
+        std::string line;
+        if (!std::getline(*input_, line)) return Value(NilType{});
+        return Value(std::move(line));
+    });
+
     globals_.Define("print",
-        Value(std::make_shared<FunctionObject>(
+        Value(MakeShared<FunctionObject>(
             FunctionObject::NativeFn(
                 [this](const std::vector<Value>& args) -> Value {
                     if (!args.empty()) {
-                        const auto& v = args[0].data;
-                        if (auto pd = std::get_if<double>(&v)) {
-                            double d = *pd;
-                            if (d == static_cast<int64_t>(d))
-                                output_ << static_cast<int64_t>(d);
-                            else
-                                output_ << d;
-                        }
-                        else if (auto ps = std::get_if<std::string>(&v)) {
-                            const std::string& s = *ps;
-                            if (s.find(' ') != std::string::npos)
-                                output_ << '"' << s << '"';
-                            else
-                                output_ << s;
-                        }
-                        else if (auto pb = std::get_if<bool>(&v)) {
-                            output_ << (*pb ? "true" : "false");
-                        }
-                        else {
-                            output_ << "nil";
-                        }
+                        PrintValue(args[0], false);
                     }
                     return Value(NilType{});
                 }
@@ -100,62 +278,101 @@ void Interpreter::Functions() {
     );
 
     globals_.Define("len",
-        Value(std::make_shared<FunctionObject>(
+        Value(MakeShared<FunctionObject>(
             FunctionObject::NativeFn(
                 [](const std::vector<Value>& args) -> Value {
                     if (args.empty()) return Value(0.0);
                     const auto& v = args[0].data;
                     if (auto ps = std::get_if<std::string>(&v))
-                        return Value(static_cast<double>(ps->size()));
+                        return Value(static_cast<int64_t>(ps->size()));
                     if (auto pa = std::get_if<Value::Array>(&v))
-                        return Value(static_cast<double>(pa->size()));
-                    throw std::runtime_error("len() argument must be string or array");
+                        return Value(static_cast<int64_t>(pa->size()));
+                    if (auto pm = std::get_if<Value::MapPtr>(&v))
+                        return Value(static_cast<int64_t>((*pm)->size()));
+                    throw std::runtime_error("len() argument must be string, array or map");
                 }
             )
         ))
     );
 
-    globals_.Define("range",
-    Value(std::make_shared<FunctionObject>(
+    range_ = MakeShared<FunctionObject>(
         FunctionObject::NativeFn(
-            [](const std::vector<Value>& args)->Value {
-                double start = 0, end = 0, step = 1;
-                if (args.size() == 1) {
-                    end = std::get<double>(args[0].data);
-                } else if (args.size() == 2) {
-                    start = std::get<double>(args[0].data);
-                    end   = std::get<double>(args[1].data);
-                } else if (args.size() >= 3) {
-                    start = std::get<double>(args[0].data);
-                    end   = std::get<double>(args[1].data);
-                    step  = std::get<double>(args[2].data);
-                } else {
-                    throw std::runtime_error("range() expects 1, 2 or 3 args");
-                }
-                if (step == 0) throw std::runtime_error("range() step cannot be zero");
-
-                Value::Array res;
-                if (step > 0) {
-                    for (double v = start; v < end; v += step)
-                        res.push_back(std::make_shared<Value>(v));
-                } else {
-                    for (double v = start; v > end; v += step)
-                        res.push_back(std::make_shared<Value>(v));
-                }
-                return Value(res);
+            [this](const std::vector<Value>& args) -> Value {
+                RangeIterator range(args);
+                ChargeHeap(range.Count() * sizeof(double), HeapKind::List);
+                return Value(range.Materialise());
             }
         )
-    )));
+    );
+    globals_.Define("range", Value(range_));
+
+    globals_.Define("keys",
+        Value(MakeShared<FunctionObject>(
+            FunctionObject::NativeFn(
+                [](const std::vector<Value>& args) -> Value {
+                    if (args.empty() || !std::holds_alternative<Value::MapPtr>(args[0].data))
+                        throw std::runtime_error("keys() argument must be map");
+                    const auto& m = *std::get<Value::MapPtr>(args[0].data);
+                    Value::Array res;
+                    for (size_t i = 0; i < m.size(); ++i)
+                        res.Push(m.KeyAt(i));
+                    return Value(std::move(res));
+                }
+            )
+        ))
+    );
 
+    globals_.Define("values",
+        Value(MakeShared<FunctionObject>(
+            FunctionObject::NativeFn(
+                [](const std::vector<Value>& args) -> Value {
+                    if (args.empty() || !std::holds_alternative<Value::MapPtr>(args[0].data))
+                        throw std::runtime_error("values() argument must be map");
+                    const auto& m = *std::get<Value::MapPtr>(args[0].data);
+                    Value::Array res;
+                    for (size_t i = 0; i < m.size(); ++i)
+                        res.Push(m.ValueAt(i));
+                    return Value(std::move(res));
+                }
+            )
+        ))
+    );
+
+    globals_.Define("has",
+        Value(MakeShared<FunctionObject>(
+            FunctionObject::NativeFn(
+                [](const std::vector<Value>& args) -> Value {
+                    if (args.size() < 2 || !std::holds_alternative<Value::MapPtr>(args[0].data))
+                        throw std::runtime_error("has() expects map and key");
+                    if (!HashMap::IsHashable(args[1])) return Value(false);
+                    return Value(std::get<Value::MapPtr>(args[0].data)->Has(args[1]));
+                }
+            )
+        ))
+    );
 }
 
 Value Interpreter::PerformFunction(
         const Value::FuncPtr& fn,
         const std::vector<Value>& args)
 {
+    Tick();
     if (fn->native) {
         return fn->native(args);
     }
+    if (fn->generator) {
+        return Value(Value::IterPtr(MakeShared<Generator>([this, fn, args] {
+            RunArena::Scope arena(&arena_);
+            CallBody(fn, args);
+        })));
+    }
+    return CallBody(fn, args);
+}
+
+Value Interpreter::CallBody(
+        const Value::FuncPtr& fn,
+        const std::vector<Value>& args)
+{
     Environment local(fn->closure);
     for (size_t i = 0; i < fn->params.size(); ++i) {
         Value v = (i < args.size() ? args[i] : Value(NilType{}));
@@ -176,6 +393,7 @@ Value Interpreter::ParseNode(const Expression& expr, Environment* env) {
 }
 
 void Interpreter::Perform(const Statement& stmt, Environment* env) {
+    if (heap_) [[unlikely]] HeapProfile::Enter(stmt.Line);
     std::visit([&](auto&& s){
         using T = std::decay_t<decltype(s)>;
         if constexpr(std::is_same_v<T, ExpressionStatement>) {
@@ -188,19 +406,13 @@ void Interpreter::Perform(const Statement& stmt, Environment* env) {
                 ParseList(s.ElseBranch, env);
         }
         else if constexpr(std::is_same_v<T, WhileStatement>) {
-            while (IsTruthy(ParseNode(s.Condition, env)))
-                ParseList(s.Body, env);
+            PerformWhile(s, env);
         }
         else if constexpr(std::is_same_v<T, ForStatement>) {
-            Value iterable = ParseNode(s.Iterable, env);
-            if (!std::holds_alternative<Value::Array>(iterable.data))
-                throw std::runtime_error("Can only iterate arrays");
-            auto& arr = std::get<Value::Array>(iterable.data);
-            for (size_t idx = 0; idx < arr.size(); ++idx) {
-                Environment loopEnv(env);
-                loopEnv.Define(s.Var, *arr[idx]);
-                ParseList(s.Body, &loopEnv);
-            }
+            PerformFor(s, env);
+        }
+        else if constexpr(std::is_same_v<T, CountedLoopStatement>) {
+            PerformCounted(s, env);
         }
 
         else if constexpr(std::is_same_v<T, ReturnStatement>) {
@@ -211,6 +423,9 @@ void Interpreter::Perform(const Statement& stmt, Environment* env) {
         else if constexpr(std::is_same_v<T, BlockStatement>) {
             ParseList(s.Statements, env);
         }
+        else if constexpr(std::is_same_v<T, YieldStatement>) {
+            Generator::Yield(ParseNode(s.Value, env));
+        }
         else if constexpr (std::is_same_v<AssignExpression, T>) {
           Value val = ParseNode(*s.Rhs, env);
           if (s.Op == TokenType::Assign) {
@@ -224,6 +439,120 @@ void Interpreter::Perform(const Statement& stmt, Environment* env) {
     }, stmt.Value);
 }
 
+void Interpreter::PerformWhile(const WhileStatement& s, Environment* env) {
+    HoistScope scope(*this, s.Hoisted);
+    while (IsTruthy(ParseNode(s.Condition, env))) {
+        ParseList(s.Body, env);
+        Tick();
+    }
+}
+
+void Interpreter::PerformFor(const ForStatement& s, Environment* env) {
+    HoistScope scope(*this, s.Hoisted);
+    Value iterable = LazyIterable(s.Iterable, env);
+    if (auto pi = std::get_if<Value::IterPtr>(&iterable.data)) {
+        auto it = *pi;
+        Value item;
+        while (it->Next(item)) {
+            Environment loopEnv(env);
+            loopEnv.Define(s.Var, std::move(item));
+            ParseList(s.Body, &loopEnv);
+            Tick();
+        }
+        return;
+    }
+    if (auto pm = std::get_if<Value::MapPtr>(&iterable.data)) {
+        auto map = *pm;
+        for (size_t idx = 0; idx < map->size(); ++idx) {
+            Environment loopEnv(env);
+            loopEnv.Define(s.Var, map->KeyAt(idx));
+            ParseList(s.Body, &loopEnv);
+            Tick();
+        }
+        return;
+    }
+    if (!std::holds_alternative<Value::Array>(iterable.data))
+        throw std::runtime_error("Can only iterate arrays, maps and iterators");
+    auto& arr = std::get<Value::Array>(iterable.data);
+    if (auto ints = arr.GetIntegers()) {
+        for (int64_t n : *ints) {
+            Environment loopEnv(env);
+            loopEnv.Define(s.Var, Value(n));
+            ParseList(s.Body, &loopEnv);
+            Tick();
+        }
+        return;
+    }
+    if (auto nums = arr.GetNumbers()) {
+        for (double d : *nums) {
+            Environment loopEnv(env);
+            loopEnv.Define(s.Var, Value(d));
+            ParseList(s.Body, &loopEnv);
+            Tick();
+        }
+        return;
+    }
+    for (size_t idx = 0; idx < arr.size(); ++idx) {
+        Environment loopEnv(env);
+        loopEnv.Define(s.Var, arr.At(idx));
+        ParseList(s.Body, &loopEnv);
+        Tick();
+    }
+}
+
+// `for x in range(...)` streams the builtin range instead of building the list.
+Value Interpreter::LazyIterable(const Expression& iterable, Environment* env) {
+    auto call = std::get_if<CallExpression>(&iterable.Value);
+    if (!call || !std::holds_alternative<VariableExpression>(call->Callee->Value))
+        return ParseNode(iterable, env);
+    Value callee = ParseNode(*call->Callee, env);
+    auto fn = std::get_if<Value::FuncPtr>(&callee.data);
+    if (!fn || *fn != range_)
+        return ParseNode(iterable, env);
+    std::vector<Value> args;
+    args.reserve(call->Args.size());
+    for (auto& a : call->Args) args.push_back(ParseNode(*a, env));
+    Tick();
+    return Value(Value::IterPtr(MakeShared<RangeIterator>(args)));
+}
+
+void Interpreter::PerformCounted(const CountedLoopStatement& s, Environment* env) {
+    HoistScope scope(*this, s.Loop.Hoisted);
+    const auto& cond = std::get<BinaryExpression>(s.Loop.Condition.Value);
+    const auto& body = s.Loop.Body;
+    Value* counter = env->Find(s.Var);
+    if (counter && std::holds_alternative<int64_t>(counter->data)) {
+        Value limitv = ParseNode(*cond.Rhs, env);
+        if (auto pl = std::get_if<int64_t>(&limitv.data)) {
+            int64_t limit = *pl;
+            while (true) {
+                int64_t i = std::get<int64_t>(counter->data);
+                bool go = s.Cmp == TokenType::Less      ? i <  limit :
+                          s.Cmp == TokenType::LessEqual ? i <= limit :
+                          s.Cmp == TokenType::Greater   ? i >  limit : i >= limit;
+                if (!go) return;
+                {
+                    Environment block(env);
+                    for (size_t k = 0; k + 1 < body.size(); ++k)
+                        Perform(body[k], &block);
+                }
+                Tick();
+                int64_t next;
+                if (__builtin_add_overflow(i, static_cast<int64_t>(s.Step), &next) ||
+                    next > Value::MaxExactInt || next < -Value::MaxExactInt) {
+                    Perform(body.back(), env);
+                    break;
+                }
+                *counter = Value(next);
+            }
+        }
+    }
+    while (IsTruthy(ParseNode(s.Loop.Condition, env))) {
+        ParseList(body, env);
+        Tick();
+    }
+}
+
 Value Interpreter::ParseList(
         const std::vector<Statement>& stmts,
         Environment* parent)
@@ -242,6 +571,12 @@ bool Interpreter::IsTruthy(const Value& v) const {
 }
 
 bool Interpreter::IsEqual(const Value& a, const Value& b) const {
+    if (a.IsNumber() && b.IsNumber()) {
+        auto ai = std::get_if<int64_t>(&a.data);
+        auto bi = std::get_if<int64_t>(&b.data);
+        if (ai && bi) return *ai == *bi;
+        return a.AsDouble() == b.AsDouble();
+    }
     if (a.data.index() != b.data.index()) return false;
     if (auto ad = std::get_if<double>(&a.data))
         return *ad == std::get<double>(b.data);
@@ -250,9 +585,75 @@ bool Interpreter::IsEqual(const Value& a, const Value& b) const {
     if (auto ab = std::get_if<bool>(&a.data))
         return *ab == std::get<bool>(b.data);
     if (std::holds_alternative<NilType>(a.data)) return true;
+    if (auto aa = std::get_if<Value::Array>(&a.data)) {
+        const auto& ba = std::get<Value::Array>(b.data);
+        if (aa->size() != ba.size()) return false;
+        for (size_t i = 0; i < aa->size(); ++i)
+            if (!IsEqual(aa->At(i), ba.At(i))) return false;
+        return true;
+    }
+    if (auto ai = std::get_if<Value::IterPtr>(&a.data))
+        return *ai == std::get<Value::IterPtr>(b.data);
+    if (auto am = std::get_if<Value::MapPtr>(&a.data)) {
+        const auto& bm = std::get<Value::MapPtr>(b.data);
+        if (*am == bm) return true;
+        if ((*am)->size() != bm->size()) return false;
+        for (size_t i = 0; i < (*am)->size(); ++i) {
+            const Value* other = bm->Find((*am)->KeyAt(i));
+            if (!other || !IsEqual((*am)->ValueAt(i), *other)) return false;
+        }
+        return true;
+    }
     return false;
 }
 
+void Interpreter::PrintValue(const Value& v, bool nested) {
+    if (auto pi = std::get_if<int64_t>(&v.data)) {
+        output_ << *pi;
+    }
+    else if (auto pd = std::get_if<double>(&v.data)) {
+        double d = *pd;
+        if (d == static_cast<int64_t>(d))
+            output_ << static_cast<int64_t>(d);
+        else
+            output_ << d;
+    }
+    else if (auto ps = std::get_if<std::string>(&v.data)) {
+        const std::string& s = *ps;
+        if (nested || s.find(' ') != std::string::npos)
+            output_ << '"' << s << '"';
+        else
+            output_ << s;
+    }
+    else if (auto pb = std::get_if<bool>(&v.data)) {
+        output_ << (*pb ? "true" : "false");
+    }
+    else if (auto pa = std::get_if<Value::Array>(&v.data)) {
+        output_ << '[';
+        for (size_t i = 0; i < pa->size(); ++i) {
+            if (i) output_ << ", ";
+            PrintValue(pa->At(i), true);
+        }
+        output_ << ']';
+    }
+    else if (auto pm = std::get_if<Value::MapPtr>(&v.data)) {
+        output_ << '{';
+        for (size_t i = 0; i < (*pm)->size(); ++i) {
+            if (i) output_ << ", ";
+            PrintValue((*pm)->KeyAt(i), true);
+            output_ << ": ";
+            PrintValue((*pm)->ValueAt(i), true);
+        }
+        output_ << '}';
+    }
+    else if (std::holds_alternative<Value::IterPtr>(v.data)) {
+        output_ << "<iterator>";
+    }
+    else {
+        output_ << "nil";
+    }
+}
+
 bool Interpreter(std::istream& in, std::ostream& out) {
     return Interpreter::Interpret(in, out);
 }
\ No newline at end of file
@@ -5,30 +5,52 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <functional>
+#include <optional>
 #include <stdexcept>
 #include <cmath>
 #include <iostream>
 
 #include "syntactic_analyser/SyntacticAnalyser.h"
 #include "semantic_analyser/SemanticAnalyser.h"
+#include "optimiser/LoopOptimiser.h"
+#include "PackedList.h"
+#include "ExecutionLimits.h"
+#include "ModuleCache.h"
+#include "RunArena.h"
 
 struct NilType {};
 struct FunctionObject;
+class HashMap;
+class Iterator;
 
 struct Value {
-    using Array   = std::vector<std::shared_ptr<Value>>;
+    using Array   = PackedList;
     using FuncPtr = std::shared_ptr<FunctionObject>;
+    using MapPtr  = std::shared_ptr<HashMap>;
+    using IterPtr = std::shared_ptr<Iterator>;
 
-    std::variant<double, std::string, bool, NilType, Array, FuncPtr> data;
+    std::variant<double, std::string, bool, NilType, Array, FuncPtr, MapPtr, int64_t, IterPtr> data;
+
+    static constexpr int64_t MaxExactInt = int64_t{1} << 53;
 
     Value();
     explicit Value(double v);
+    explicit Value(int64_t v);
     explicit Value(const std::string& v);
+    explicit Value(std::string&& v);
     explicit Value(bool v);
     explicit Value(NilType v);
     explicit Value(const Array& v);
+    explicit Value(Array&& v);
     explicit Value(FuncPtr v);
+    explicit Value(MapPtr v);
+    explicit Value(IterPtr v);
+
+    bool IsNumber() const;
+    double AsDouble() const;
+    int64_t AsIndex() const;
 };
 
 class Environment {
@@ -39,10 +61,13 @@ public:
     bool Define(const std::string& name, Value val);
     bool Assign(const std::string& name, Value val);
     Value Get(const std::string& name) const;
+    Value* Find(const std::string& name);
+    const std::pmr::unordered_map<std::string, Value>& Values() const;
 
 private:
     Environment* parent_;
-    std::unordered_map<std::string, Value> values_;
+    // Drawn from the run's arena when created during a run.
+    std::pmr::unordered_map<std::string, Value> values_;
 };
 
 class ReturnException : public std::runtime_error {
@@ -53,36 +78,131 @@ public:
 
 struct FunctionObject {
     using NativeFn = std::function<Value(const std::vector<Value>&)>;
+    static constexpr HeapKind HeapTag = HeapKind::Function;
 
     std::vector<std::string> params;
     const std::vector<Statement>* body;
     Environment* closure;
     NativeFn native;
-    FunctionObject(std::vector<std::string> p, const std::vector<Statement>* b, Environment* c);
+    bool generator;
+    const FunctionExpression* literal = nullptr;
+    FunctionObject(std::vector<std::string> p, const std::vector<Statement>* b, Environment* c, bool g = false);
     explicit FunctionObject(NativeFn fn);
 };
 
+// A parsed, analysed and optimised program. It is never modified after
+// Compile, so one instance may be run by several threads at once.
+struct CompiledScript {
+    std::vector<Statement> Program;
+    std::vector<std::string> Imports;
+    std::size_t Slots = 0;
+    bool Valid = false;
+    std::string Diagnostics;
+    // One line per loop the optimiser made counted or hoisted from.
+    std::vector<std::string> OptimiserReport;
+};
+
 class Interpreter {
 public:
-    static bool Interpret(std::istream& in, std::ostream& out);
+    static bool Interpret(std::istream& in, std::ostream& out,
+                          const ExecutionLimits& limits = {}, ExecutionStats* stats = nullptr);
+    // Throws std::runtime_error on syntax errors; semantic errors are kept
+    // in Diagnostics and make the script invalid.
+    static std::shared_ptr<const CompiledScript> Compile(std::istream& in);
+    // Writes the diagnostics and the program's output to `out`. read() takes
+    // lines from `input`, and runtime errors are reported on `errors`.
+    static bool Run(const CompiledScript& script, std::ostream& out, std::istream& input, std::ostream& errors,
+                    const ExecutionLimits& limits = {}, ExecutionStats* stats = nullptr);
 
 private:
+    static constexpr uint64_t CheckInterval = 1024;
+
+    // Declared first so that it outlives every value of the run.
+    RunArena arena_;
+    // Interpreters for pmap, pfilter and preduce threads. They own the
+    // arenas their results were allocated from, so they live as long as
+    // this one.
+    std::vector<std::unique_ptr<Interpreter>> workers_;
     Environment globals_;
     std::ostream& output_;
-
-    explicit Interpreter(std::ostream& out);
+    std::istream* input_ = &std::cin;
+    std::vector<std::optional<Value>> hoisted_;
+    std::vector<std::optional<Value>> moduleHoisted_;
+    Value::FuncPtr range_;
+
+    struct ModuleInstance {
+        std::shared_ptr<const Module> module;
+        std::unique_ptr<Environment> env;
+        Value exports;
+    };
+    std::unordered_map<std::string, ModuleInstance> modules_;
+
+    ExecutionLimits limits_;
+    ExecutionStats stats_;
+    HeapProfile* heap_;
+    uint64_t nextCheck_ = UINT64_MAX;
+    // ChargeHeap only does work above this size: the largest allocation so
+    // far, or 0 while profiling.
+    std::size_t heapWatermark_ = 0;
+    std::chrono::steady_clock::time_point start_;
+
+    class HoistScope {
+    public:
+        HoistScope(Interpreter& interp, const std::vector<std::size_t>& slots);
+        ~HoistScope();
+    private:
+        Interpreter& interp_;
+        const std::vector<std::size_t>& slots_;
+        std::vector<std::optional<Value>> saved_;
+    };
+
+    Interpreter(std::ostream& out, const ExecutionLimits& limits);
+
+    void Tick() {
+        if (++stats_.Steps >= nextCheck_) CheckLimits();
+    }
+    std::optional<Value>& HoistSlot(std::size_t slot) {
+        return slot < ModuleCache::SlotBase ? hoisted_[slot] : moduleHoisted_[slot - ModuleCache::SlotBase];
+    }
+    Value Import(const std::string& path);
+
+    void StartClock();
+    void CheckLimits();
+    void ChargeHeap(std::size_t bytes, HeapKind kind) {
+        if (bytes > heapWatermark_) ChargeLargeHeap(bytes, kind);
+    }
+    void ChargeLargeHeap(std::size_t bytes, HeapKind kind);
+    HeapReport CollectHeapReport() const;
 
     void Functions();
+    void StringFunctions();
+    void FileFunctions();
+    void ParallelFunctions();
+    void DefineNative(const std::string& name, FunctionObject::NativeFn fn);
 
     Value ParseNode(const Expression& expr, Environment* env);
     void Perform(const Statement& stmt, Environment* env);
     Value ParseList(const std::vector<Statement>& stmts, Environment* env);
+    void PerformWhile(const WhileStatement& s, Environment* env);
+    void PerformFor(const ForStatement& s, Environment* env);
+    void PerformCounted(const CountedLoopStatement& s, Environment* env);
     Value PerformFunction(const Value::FuncPtr& fn, const std::vector<Value>& args);
+    Value CallBody(const Value::FuncPtr& fn, const std::vector<Value>& args);
+    Value LazyIterable(const Expression& iterable, Environment* env);
+
+    using ChunkFn = std::function<void(Interpreter& worker, std::size_t chunk, std::size_t from, std::size_t to)>;
+    std::size_t ForChunks(std::size_t n, const Value::FuncPtr& fn, const ChunkFn& body);
+    bool IsParallel(const Value::FuncPtr& fn, std::unordered_set<const FunctionObject*>& seen);
 
     bool IsTruthy(const Value& v) const;
     bool IsEqual(const Value& a, const Value& b) const;
+    void PrintValue(const Value& v, bool nested);
 
     friend struct ParseExpression;
 };
 
-bool Interpreter(std::istream& in, std::ostream& out);
\ No newline at end of file
+bool Interpreter(std::istream& in, std::ostream& out);
+
+// The string argument `i` of the native `fn`; throws a runtime error
+// naming `fn` when it is missing or not a string.
+const std::string& StringArg(const std::vector<Value>& args, size_t i, const char* fn);
\ No newline at end of file
@@ -5,6 +5,7 @@
 LexicalAnalyser::LexicalAnalyser(std::istream& in)
     : in_(in) {
     lookahead_ = Scan();
+    lookaheadEnd_ = line_;
 }
 
 const Token& LexicalAnalyser::Top() const {
@@ -13,10 +14,16 @@ const Token& LexicalAnalyser::Top() const {
 
 Token LexicalAnalyser::Next() {
     Token cur = lookahead_;
+    end_ = lookaheadEnd_;
     lookahead_ = Scan();
+    lookaheadEnd_ = line_;
     return cur;
 }
 
+std::size_t LexicalAnalyser::EndLine() const {
+    return end_;
+}
+
 void LexicalAnalyser::Update() {
     if (cur_ == '\n') {
         ++line_;
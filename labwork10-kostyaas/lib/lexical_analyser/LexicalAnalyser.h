@@ -9,12 +9,15 @@ public:
     explicit LexicalAnalyser(std::istream& in);
     const Token& Top() const;
     Token Next();
+    // Line on which the token last returned by Next() ends.
+    std::size_t EndLine() const;
 
 private:
     std::istream& in_;
     std::size_t line_{1}, col_{0};
     int cur_{in_.get()};
     Token lookahead_;
+    std::size_t lookaheadEnd_{1}, end_{1};
 
     static constexpr std::array<std::pair<const char*, TokenType>, 10> MultiCharOps{{
         {"==", TokenType::DoubleEqual},
@@ -29,7 +32,7 @@ private:
         {"^=", TokenType::CaretEqual}
     }};
 
-    static constexpr std::array<std::pair<char, TokenType>, 14> SingleCharOps{{
+    static constexpr std::array<std::pair<char, TokenType>, 17> SingleCharOps{{
         {'+', TokenType::Plus},
         {'-', TokenType::Minus},
         {'*', TokenType::Asterisk},
@@ -43,10 +46,13 @@ private:
         {')', TokenType::RParen},
         {'[', TokenType::LBracket},
         {']', TokenType::RBracket},
-        {',', TokenType::Comma}
+        {'{', TokenType::LBrace},
+        {'}', TokenType::RBrace},
+        {',', TokenType::Comma},
+        {':', TokenType::Colon}
     }};
 
-    static constexpr std::array<std::pair<const char*, TokenType>, 17> Keywords{{
+    static constexpr std::array<std::pair<const char*, TokenType>, 19> Keywords{{
         {"nil", TokenType::Nil},
         {"true", TokenType::Boolean},
         {"false", TokenType::Boolean},
@@ -63,7 +69,9 @@ private:
         {"or", TokenType::Or},
         {"not", TokenType::Not},
         {"break", TokenType::Break},
-        {"continue", TokenType::Continue}
+        {"continue", TokenType::Continue},
+        {"yield", TokenType::Yield},
+        {"import", TokenType::Import}
     }};
 
     void Update();
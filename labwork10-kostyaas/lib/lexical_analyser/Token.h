@@ -24,6 +24,8 @@ enum class TokenType {
     Not,
     Break,
     Continue,
+    Yield,
+    Import,
     Plus,
     Minus,
     Asterisk,
@@ -48,7 +50,9 @@ enum class TokenType {
     LBracket,
     RBracket,
     Comma,
-    Colon
+    Colon,
+    LBrace,
+    RBrace
 };
 
 struct Token {
@@ -0,0 +1,427 @@
+#include "LoopOptimiser.h"
+
+namespace {
+
+const std::unordered_set<std::string> SafeNatives = {
+    "print", "len", "range", "keys", "values", "has",
+    "split", "join", "find", "replace", "lower", "upper", "strip", "startswith",
+    "read_file", "read_lines", "write_file", "append_file"
+};
+
+const std::unordered_set<std::string> PureNatives = {
+    "len", "range", "keys", "values", "has",
+    "split", "join", "find", "replace", "lower", "upper", "strip", "startswith"
+};
+
+// Pure natives that touch no interpreter state, so any thread may call them.
+// range and join charge the heap budget of the interpreter that defined them.
+const std::unordered_set<std::string> ParallelNatives = {
+    "len", "keys", "values", "has",
+    "split", "find", "replace", "lower", "upper", "strip", "startswith"
+};
+
+template<typename F>
+void ForEachChild(Expression& e, F&& f) {
+    std::visit([&](auto& n) {
+        using T = std::decay_t<decltype(n)>;
+        if constexpr (std::is_same_v<T, UnaryExpression>) {
+            f(*n.Rhs);
+        } else if constexpr (std::is_same_v<T, BinaryExpression>) {
+            f(*n.Lhs);
+            f(*n.Rhs);
+        } else if constexpr (std::is_same_v<T, CallExpression>) {
+            f(*n.Callee);
+            for (auto& a : n.Args) f(*a);
+        } else if constexpr (std::is_same_v<T, ListExpression>) {
+            for (auto& el : n.Elements) f(*el);
+        } else if constexpr (std::is_same_v<T, AssignExpression>) {
+            f(*n.Rhs);
+        } else if constexpr (std::is_same_v<T, IndexExpression>) {
+            f(*n.Obj);
+            f(*n.Index);
+        } else if constexpr (std::is_same_v<T, SliceExpression>) {
+            f(*n.Obj);
+            f(*n.From);
+            if (n.To) f(*n.To);
+        } else if constexpr (std::is_same_v<T, MapExpression>) {
+            for (auto& k : n.Keys) f(*k);
+            for (auto& v : n.Values) f(*v);
+        } else if constexpr (std::is_same_v<T, IndexAssignExpression>) {
+            f(*n.Obj);
+            f(*n.Index);
+            f(*n.Rhs);
+        }
+    }, e.Value);
+}
+
+template<typename F, typename G>
+void ForEachPart(Statement& st, F&& onExpr, G&& onBlock) {
+    std::visit([&](auto& s) {
+        using T = std::decay_t<decltype(s)>;
+        if constexpr (std::is_same_v<T, ExpressionStatement>) {
+            onExpr(s.Expression);
+        } else if constexpr (std::is_same_v<T, IfStatement>) {
+            onExpr(s.Condition);
+            onBlock(s.ThenBranch);
+            onBlock(s.ElseBranch);
+        } else if constexpr (std::is_same_v<T, WhileStatement>) {
+            onExpr(s.Condition);
+            onBlock(s.Body);
+        } else if constexpr (std::is_same_v<T, ForStatement>) {
+            onExpr(s.Iterable);
+            onBlock(s.Body);
+        } else if constexpr (std::is_same_v<T, ReturnStatement>) {
+            if (s.Value) onExpr(*s.Value);
+        } else if constexpr (std::is_same_v<T, YieldStatement>) {
+            onExpr(s.Value);
+        } else if constexpr (std::is_same_v<T, BlockStatement>) {
+            onBlock(s.Statements);
+        } else if constexpr (std::is_same_v<T, CountedLoopStatement>) {
+            onExpr(s.Loop.Condition);
+            onBlock(s.Loop.Body);
+        }
+    }, st.Value);
+}
+
+void ShiftSlots(std::vector<Statement>& stmts, std::size_t from, std::size_t to);
+
+void ShiftSlots(Expression& e, std::size_t from, std::size_t to) {
+    if (auto h = std::get_if<HoistedExpression>(&e.Value)) {
+        h->Slot = h->Slot - from + to;
+        ShiftSlots(*h->Inner, from, to);
+        return;
+    }
+    if (auto f = std::get_if<FunctionExpression>(&e.Value)) {
+        ShiftSlots(f->Body, from, to);
+        return;
+    }
+    ForEachChild(e, [&](Expression& c) { ShiftSlots(c, from, to); });
+}
+
+void ShiftSlots(std::vector<Statement>& stmts, std::size_t from, std::size_t to) {
+    for (auto& st : stmts) {
+        std::vector<std::size_t>* hoisted = nullptr;
+        if (auto w = std::get_if<WhileStatement>(&st.Value)) hoisted = &w->Hoisted;
+        if (auto f = std::get_if<ForStatement>(&st.Value)) hoisted = &f->Hoisted;
+        if (auto c = std::get_if<CountedLoopStatement>(&st.Value)) hoisted = &c->Loop.Hoisted;
+        if (hoisted)
+            for (auto& slot : *hoisted) slot = slot - from + to;
+        ForEachPart(st,
+            [&](Expression& e) { ShiftSlots(e, from, to); },
+            [&](std::vector<Statement>& b) { ShiftSlots(b, from, to); });
+    }
+}
+
+bool IsLeaf(const Expression& e) {
+    return std::holds_alternative<NumberExpression>(e.Value) ||
+           std::holds_alternative<StringExpression>(e.Value) ||
+           std::holds_alternative<BoolExpression>(e.Value) ||
+           std::holds_alternative<NilExpression>(e.Value) ||
+           std::holds_alternative<VariableExpression>(e.Value);
+}
+
+}
+
+void LoopOptimiser::Optimise(std::vector<Statement>& program) {
+    CollectRebound(program);
+    VisitBlock(program);
+}
+
+LoopOptimiser::LoopOptimiser(std::size_t firstSlot) : FirstSlot(firstSlot), SlotCount(firstSlot) {}
+
+std::size_t LoopOptimiser::Slots() const {
+    return SlotCount - FirstSlot;
+}
+
+void LoopOptimiser::Relocate(std::vector<Statement>& program, std::size_t from, std::size_t to) {
+    if (from != to) ShiftSlots(program, from, to);
+}
+
+const std::vector<std::string>& LoopOptimiser::Report() const {
+    return Lines;
+}
+
+void LoopOptimiser::CollectRebound(std::vector<Statement>& stmts) {
+    for (auto& st : stmts) {
+        if (auto f = std::get_if<ForStatement>(&st.Value)) Rebound.insert(f->Var);
+        ForEachPart(st,
+            [this](Expression& e) { CollectRebound(e); },
+            [this](std::vector<Statement>& b) { CollectRebound(b); });
+    }
+}
+
+void LoopOptimiser::CollectRebound(Expression& e) {
+    if (auto a = std::get_if<AssignExpression>(&e.Value)) Rebound.insert(a->Name);
+    if (auto f = std::get_if<FunctionExpression>(&e.Value)) {
+        for (auto& p : f->Params) Rebound.insert(p);
+        CollectRebound(f->Body);
+        return;
+    }
+    ForEachChild(e, [this](Expression& c) { CollectRebound(c); });
+}
+
+void LoopOptimiser::ScanLoop(std::vector<Statement>& stmts, LoopInfo& info, const std::string& counter) {
+    for (auto& st : stmts) {
+        if (auto f = std::get_if<ForStatement>(&st.Value)) {
+            info.Assigned.insert(f->Var);
+            if (f->Var == counter) info.CounterWrites += 2;
+            if (!IsInertIterable(f->Iterable)) info.Opaque = true;
+        }
+        if (std::holds_alternative<YieldStatement>(st.Value)) {
+            info.Yields = true;
+            info.Opaque = true;
+        }
+        ForEachPart(st,
+            [&](Expression& e) { ScanLoop(e, info, counter); },
+            [&](std::vector<Statement>& b) { ScanLoop(b, info, counter); });
+    }
+}
+
+void LoopOptimiser::ScanLoop(Expression& e, LoopInfo& info, const std::string& counter) {
+    if (std::holds_alternative<FunctionExpression>(e.Value)) return;
+    if (auto a = std::get_if<AssignExpression>(&e.Value)) {
+        info.Assigned.insert(a->Name);
+        if (a->Name == counter) ++info.CounterWrites;
+    }
+    if (std::holds_alternative<IndexAssignExpression>(e.Value)) info.Mutates = true;
+    if (std::holds_alternative<ImportExpression>(e.Value)) info.Opaque = true;
+    if (auto c = std::get_if<CallExpression>(&e.Value)) {
+        if (!IsTrusted(*c->Callee, false)) info.Opaque = true;
+    }
+    if (auto h = std::get_if<HoistedExpression>(&e.Value)) {
+        ScanLoop(*h->Inner, info, counter);
+        return;
+    }
+    ForEachChild(e, [&](Expression& c) { ScanLoop(c, info, counter); });
+}
+
+void LoopOptimiser::MarkPure(FunctionExpression& f) {
+    std::unordered_set<std::string> calls;
+    std::unordered_set<std::string> locals;
+    f.Pure = !f.Generator && ScanPure(f.Body, calls, locals);
+    for (auto& p : f.Params) {
+        if (calls.count(p)) f.Pure = false;
+        locals.erase(p);
+    }
+    f.Calls.assign(calls.begin(), calls.end());
+    f.Locals.assign(locals.begin(), locals.end());
+}
+
+bool LoopOptimiser::ScanPure(std::vector<Statement>& stmts, std::unordered_set<std::string>& calls,
+                             std::unordered_set<std::string>& locals) const {
+    bool pure = true;
+    for (auto& st : stmts) {
+        if (std::holds_alternative<YieldStatement>(st.Value)) return false;
+        if (auto f = std::get_if<ForStatement>(&st.Value)) {
+            // `for x in range(...)` streams without calling the native.
+            auto c = std::get_if<CallExpression>(&f->Iterable.Value);
+            if (c && IsTrusted(*c->Callee, true) && std::get<VariableExpression>(c->Callee->Value).Name == "range") {
+                for (auto& a : c->Args) pure = pure && ScanPure(*a, calls, locals);
+                pure = pure && ScanPure(f->Body, calls, locals);
+                continue;
+            }
+        }
+        ForEachPart(st,
+            [&](Expression& e) { pure = pure && ScanPure(e, calls, locals); },
+            [&](std::vector<Statement>& b) { pure = pure && ScanPure(b, calls, locals); });
+        if (!pure) return false;
+    }
+    return pure;
+}
+
+bool LoopOptimiser::ScanPure(Expression& e, std::unordered_set<std::string>& calls,
+                             std::unordered_set<std::string>& locals) const {
+    if (std::holds_alternative<FunctionExpression>(e.Value) ||
+        std::holds_alternative<ImportExpression>(e.Value)) {
+        return false;
+    }
+    if (auto h = std::get_if<HoistedExpression>(&e.Value)) return ScanPure(*h->Inner, calls, locals);
+    if (auto a = std::get_if<AssignExpression>(&e.Value)) locals.insert(a->Name);
+    if (auto ia = std::get_if<IndexAssignExpression>(&e.Value)) {
+        // Maps are shared by reference; lists are copied on first write.
+        auto v = std::get_if<VariableExpression>(&ia->Obj->Value);
+        if (!v || ia->Obj->Type != StaticType::List) return false;
+        locals.insert(v->Name);
+    }
+    if (auto c = std::get_if<CallExpression>(&e.Value)) {
+        auto v = std::get_if<VariableExpression>(&c->Callee->Value);
+        if (!v) return false;
+        if (!IsTrusted(*c->Callee, true) || !ParallelNatives.count(v->Name)) calls.insert(v->Name);
+    }
+    bool pure = true;
+    ForEachChild(e, [&](Expression& c) { pure = pure && ScanPure(c, calls, locals); });
+    return pure;
+}
+
+bool LoopOptimiser::IsTrusted(const Expression& callee, bool pure) const {
+    auto v = std::get_if<VariableExpression>(&callee.Value);
+    if (!v || Rebound.count(v->Name)) return false;
+    return pure ? PureNatives.count(v->Name) > 0 : SafeNatives.count(v->Name) > 0;
+}
+
+// The iterable of a for loop is evaluated once, but a generator it yields
+// runs between iterations and may change what the body reads. Only
+// literals and calls to trusted natives, which return plain values, are
+// known not to.
+bool LoopOptimiser::IsInertIterable(const Expression& e) const {
+    if (std::holds_alternative<StringExpression>(e.Value) || std::holds_alternative<ListExpression>(e.Value))
+        return true;
+    auto c = std::get_if<CallExpression>(&e.Value);
+    return c && IsTrusted(*c->Callee, false);
+}
+
+bool LoopOptimiser::IsInvariant(Expression& e, const LoopInfo& info) const {
+    if (info.Opaque) return false;
+    return std::visit([&](auto& n) -> bool {
+        using T = std::decay_t<decltype(n)>;
+        if constexpr (std::is_same_v<T, NumberExpression> ||
+                      std::is_same_v<T, StringExpression> ||
+                      std::is_same_v<T, BoolExpression>   ||
+                      std::is_same_v<T, NilExpression>    ||
+                      std::is_same_v<T, HoistedExpression>) {
+            return true;
+        } else if constexpr (std::is_same_v<T, VariableExpression>) {
+            return !info.Assigned.count(n.Name);
+        } else if constexpr (std::is_same_v<T, UnaryExpression> ||
+                             std::is_same_v<T, BinaryExpression> ||
+                             std::is_same_v<T, ListExpression>) {
+            bool ok = true;
+            ForEachChild(e, [&](Expression& c) { ok = ok && IsInvariant(c, info); });
+            return ok;
+        } else if constexpr (std::is_same_v<T, IndexExpression> ||
+                             std::is_same_v<T, SliceExpression>) {
+            if (info.Mutates) return false;
+            bool ok = true;
+            ForEachChild(e, [&](Expression& c) { ok = ok && IsInvariant(c, info); });
+            return ok;
+        } else if constexpr (std::is_same_v<T, CallExpression>) {
+            if (info.Mutates || !IsTrusted(*n.Callee, true)) return false;
+            for (auto& a : n.Args)
+                if (!IsInvariant(*a, info)) return false;
+            return true;
+        } else {
+            return false;
+        }
+    }, e.Value);
+}
+
+void LoopOptimiser::Hoist(Expression& e, const LoopInfo& info, std::vector<std::size_t>& slots) {
+    if (std::holds_alternative<HoistedExpression>(e.Value) ||
+        std::holds_alternative<FunctionExpression>(e.Value)) return;
+    if (!IsLeaf(e) && IsInvariant(e, info)) {
+        auto inner = std::make_unique<Expression>(std::move(e));
+        StaticType type = inner->Type;
+        e = Expression{HoistedExpression{SlotCount, std::move(inner)}};
+        e.Type = type;
+        slots.push_back(SlotCount++);
+        return;
+    }
+    ForEachChild(e, [&](Expression& c) { Hoist(c, info, slots); });
+}
+
+void LoopOptimiser::HoistBlock(std::vector<Statement>& stmts, const LoopInfo& info, std::vector<std::size_t>& slots) {
+    for (auto& st : stmts) {
+        ForEachPart(st,
+            [&](Expression& e) { Hoist(e, info, slots); },
+            [&](std::vector<Statement>& b) { HoistBlock(b, info, slots); });
+    }
+}
+
+void LoopOptimiser::VisitBlock(std::vector<Statement>& stmts) {
+    for (auto& st : stmts) {
+        if (std::holds_alternative<WhileStatement>(st.Value)) {
+            OptimiseWhile(st);
+        } else if (auto f = std::get_if<ForStatement>(&st.Value)) {
+            OptimiseFor(*f);
+        }
+        ForEachPart(st,
+            [this](Expression& e) { VisitExpression(e); },
+            [this](std::vector<Statement>& b) { VisitBlock(b); });
+    }
+}
+
+void LoopOptimiser::VisitExpression(Expression& e) {
+    if (auto f = std::get_if<FunctionExpression>(&e.Value)) {
+        VisitBlock(f->Body);
+        MarkPure(*f);
+        return;
+    }
+    if (auto h = std::get_if<HoistedExpression>(&e.Value)) {
+        VisitExpression(*h->Inner);
+        return;
+    }
+    ForEachChild(e, [this](Expression& c) { VisitExpression(c); });
+}
+
+void LoopOptimiser::OptimiseWhile(Statement& st) {
+    auto& s = std::get<WhileStatement>(st.Value);
+    std::size_t id = ++LoopCount;
+
+    std::string var;
+    TokenType cmp = TokenType::Less;
+    long long step = 0;
+    bool counted = MatchCounted(s, var, cmp, step);
+
+    LoopInfo info;
+    ScanLoop(s.Condition, info, var);
+    ScanLoop(s.Body, info, var);
+    if (counted) {
+        auto& cond = std::get<BinaryExpression>(s.Condition.Value);
+        counted = !info.Opaque && info.CounterWrites == 1 && IsInvariant(*cond.Rhs, info);
+    }
+
+    if (!info.Yields) {
+        Hoist(s.Condition, info, s.Hoisted);
+        HoistBlock(s.Body, info, s.Hoisted);
+    }
+
+    std::string line = "loop #" + std::to_string(id) + " (while):";
+    if (counted) line += " counted on " + var + ",";
+    line += " hoisted " + std::to_string(s.Hoisted.size());
+    if (counted || !s.Hoisted.empty()) Lines.push_back(line);
+
+    if (counted) {
+        std::size_t line = st.Line;
+        st = Statement{CountedLoopStatement{std::move(s), var, cmp, step}};
+        st.Line = line;
+    }
+}
+
+void LoopOptimiser::OptimiseFor(ForStatement& s) {
+    std::size_t id = ++LoopCount;
+    LoopInfo info;
+    info.Assigned.insert(s.Var);
+    ScanLoop(s.Iterable, info, "");
+    if (!IsInertIterable(s.Iterable)) info.Opaque = true;
+    ScanLoop(s.Body, info, "");
+    if (!info.Yields) HoistBlock(s.Body, info, s.Hoisted);
+    if (!s.Hoisted.empty()) {
+        Lines.push_back("loop #" + std::to_string(id) + " (for " + s.Var + "): hoisted " +
+                        std::to_string(s.Hoisted.size()));
+    }
+}
+
+bool LoopOptimiser::MatchCounted(WhileStatement& s, std::string& var, TokenType& cmp, long long& step) const {
+    auto cond = std::get_if<BinaryExpression>(&s.Condition.Value);
+    if (!cond) return false;
+    if (cond->Op != TokenType::Less && cond->Op != TokenType::LessEqual &&
+        cond->Op != TokenType::Greater && cond->Op != TokenType::GreaterEqual) return false;
+    auto lhs = std::get_if<VariableExpression>(&cond->Lhs->Value);
+    if (!lhs || s.Body.empty()) return false;
+
+    auto last = std::get_if<ExpressionStatement>(&s.Body.back().Value);
+    if (!last) return false;
+    auto assign = std::get_if<AssignExpression>(&last->Expression.Value);
+    if (!assign || assign->Op != TokenType::Assign || assign->Name != lhs->Name) return false;
+    auto inc = std::get_if<BinaryExpression>(&assign->Rhs->Value);
+    if (!inc || (inc->Op != TokenType::Plus && inc->Op != TokenType::Minus)) return false;
+    auto self = std::get_if<VariableExpression>(&inc->Lhs->Value);
+    auto by = std::get_if<NumberExpression>(&inc->Rhs->Value);
+    if (!self || self->Name != lhs->Name || !by || !by->Integral) return false;
+
+    var = lhs->Name;
+    cmp = cond->Op;
+    step = static_cast<long long>(by->Value);
+    if (inc->Op == TokenType::Minus) step = -step;
+    return true;
+}
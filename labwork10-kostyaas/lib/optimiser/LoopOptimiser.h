@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include "syntactic_analyser/SyntacticAnalyser.h"
+
+class LoopOptimiser {
+public:
+    // Slots are numbered from `firstSlot`, so separately optimised trees
+    // can share one interpreter without their caches colliding.
+    explicit LoopOptimiser(std::size_t firstSlot = 0);
+
+    void Optimise(std::vector<Statement>& program);
+    std::size_t Slots() const;
+    const std::vector<std::string>& Report() const;
+
+    // Moves every slot of an optimised program from `from` onwards to `to`
+    // onwards.
+    static void Relocate(std::vector<Statement>& program, std::size_t from, std::size_t to);
+
+private:
+    struct LoopInfo {
+        std::unordered_set<std::string> Assigned;
+        std::size_t CounterWrites = 0;
+        bool Opaque = false;
+        bool Mutates = false;
+        // A yield suspends the loop while other code runs, so its cache
+        // slots could be reused by another frame before it resumes.
+        bool Yields = false;
+    };
+
+    std::unordered_set<std::string> Rebound;
+    std::size_t FirstSlot;
+    std::size_t SlotCount;
+    std::size_t LoopCount = 0;
+    std::vector<std::string> Lines;
+
+    void CollectRebound(std::vector<Statement>& stmts);
+    void CollectRebound(Expression& e);
+
+    void ScanLoop(std::vector<Statement>& stmts, LoopInfo& info, const std::string& counter);
+    void ScanLoop(Expression& e, LoopInfo& info, const std::string& counter);
+
+    bool IsTrusted(const Expression& callee, bool pure) const;
+    bool IsInertIterable(const Expression& e) const;
+    void MarkPure(FunctionExpression& f);
+    bool ScanPure(std::vector<Statement>& stmts, std::unordered_set<std::string>& calls,
+                  std::unordered_set<std::string>& locals) const;
+    bool ScanPure(Expression& e, std::unordered_set<std::string>& calls,
+                  std::unordered_set<std::string>& locals) const;
+    bool IsInvariant(Expression& e, const LoopInfo& info) const;
+    void Hoist(Expression& e, const LoopInfo& info, std::vector<std::size_t>& slots);
+    void HoistBlock(std::vector<Statement>& stmts, const LoopInfo& info, std::vector<std::size_t>& slots);
+
+    void VisitBlock(std::vector<Statement>& stmts);
+    void VisitExpression(Expression& e);
+    void OptimiseWhile(Statement& st);
+    void OptimiseFor(ForStatement& s);
+    bool MatchCounted(WhileStatement& s, std::string& var, TokenType& cmp, long long& step) const;
+};
@@ -1,5 +1,70 @@
 #include "SemanticAnalyser.h"
 
+namespace {
+
+const std::unordered_map<std::string, StaticType> NativeResults = {
+    {"print", StaticType::Nil},
+    {"len", StaticType::Number},
+    {"range", StaticType::List},
+    {"keys", StaticType::List},
+    {"values", StaticType::List},
+    {"has", StaticType::Bool},
+    {"split", StaticType::List},
+    {"join", StaticType::String},
+    {"find", StaticType::Number},
+    {"replace", StaticType::String},
+    {"lower", StaticType::String},
+    {"upper", StaticType::String},
+    {"strip", StaticType::String},
+    {"startswith", StaticType::Bool},
+    {"read_file", StaticType::String},
+    {"write_file", StaticType::Nil},
+    {"append_file", StaticType::Nil}
+};
+
+const char* TypeName(StaticType t) {
+    switch (t) {
+        case StaticType::Number:   return "number";
+        case StaticType::String:   return "string";
+        case StaticType::Bool:     return "bool";
+        case StaticType::Nil:      return "nil";
+        case StaticType::List:     return "list";
+        case StaticType::Map:      return "map";
+        case StaticType::Function: return "function";
+        default:                   return "unknown";
+    }
+}
+
+const char* OpName(TokenType op) {
+    switch (op) {
+        case TokenType::Plus:         return "+";
+        case TokenType::Minus:        return "-";
+        case TokenType::Asterisk:     return "*";
+        case TokenType::Slash:        return "/";
+        case TokenType::Percent:      return "%";
+        case TokenType::Caret:        return "^";
+        case TokenType::Less:         return "<";
+        case TokenType::LessEqual:    return "<=";
+        case TokenType::Greater:      return ">";
+        case TokenType::GreaterEqual: return ">=";
+        default:                      return "?";
+    }
+}
+
+bool Known(StaticType t) {
+    return t != StaticType::Unknown;
+}
+
+bool Numeric(StaticType t) {
+    return t == StaticType::Number || t == StaticType::Bool;
+}
+
+StaticType Merge(StaticType a, StaticType b) {
+    return a == b ? a : StaticType::Unknown;
+}
+
+}
+
 void SymbolTable::EnterScope() {
     Scopes.emplace_back();
 }
@@ -8,11 +73,11 @@ void SymbolTable::ExitScope() {
     if (!Scopes.empty()) Scopes.pop_back();
 }
 
-bool SymbolTable::Declare(const std::string& name) {
+bool SymbolTable::Declare(const std::string& name, StaticType type) {
     if (Scopes.empty()) EnterScope();
     auto& top = Scopes.back();
     if (top.count(name)) return false;
-    top[name] = true;
+    top[name] = type;
     return true;
 }
 
@@ -23,27 +88,192 @@ bool SymbolTable::Exists(const std::string& name) const {
     return false;
 }
 
+StaticType SymbolTable::TypeOf(const std::string& name) const {
+    for (auto it = Scopes.rbegin(); it != Scopes.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) return found->second;
+    }
+    return StaticType::Unknown;
+}
+
+void SymbolTable::SetType(const std::string& name, StaticType type) {
+    for (auto it = Scopes.rbegin(); it != Scopes.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) {
+            found->second = type;
+            return;
+        }
+    }
+}
+
+void SymbolTable::Forget() {
+    for (auto& scope : Scopes) {
+        for (auto& [name, type] : scope) type = StaticType::Unknown;
+    }
+}
+
+SymbolTable::State SymbolTable::Snapshot() const {
+    return Scopes;
+}
+
+void SymbolTable::Restore(State state) {
+    Scopes = std::move(state);
+}
+
+void SymbolTable::Join(const State& other) {
+    for (size_t i = 0; i < Scopes.size() && i < other.size(); ++i) {
+        for (auto& [name, type] : Scopes[i]) {
+            auto found = other[i].find(name);
+            type = found == other[i].end() ? StaticType::Unknown : Merge(type, found->second);
+        }
+        for (auto& [name, type] : other[i]) {
+            if (!Scopes[i].count(name)) Scopes[i][name] = StaticType::Unknown;
+        }
+    }
+}
+
 SemanticAnalyser::SemanticAnalyser(std::ostream& errs)
     : Errs(errs) {}
 
 bool SemanticAnalyser::Analyse(const std::vector<Statement>& program) {
+    Begin(program);
+    bool ok = true;
+    for (auto& st : program) ok &= VisitStatement(st);
+    Table.ExitScope();
+    return ok;
+}
+
+void SemanticAnalyser::Begin(const std::vector<Statement>& program) {
+    Table = SymbolTable();
+    Rebound.clear();
+    FunctionDepth = 0;
     Table.EnterScope();
+    CollectRebound(program);
 
     const char* builtins[] = {
         "print", "println", "read", "stacktrace",
         "abs", "ceil", "floor", "round", "sqrt", "rnd",
         "parse_num", "to_string",
         "len", "lower", "upper", "split", "join", "replace",
+        "find", "strip", "startswith",
         "range",
-        "push", "pop", "insert", "remove", "sort"
+        "push", "pop", "insert", "remove", "sort",
+        "keys", "values", "has",
+        "read_file", "read_lines", "write_file", "append_file",
+        "pmap", "pfilter", "preduce"
     };
     for (auto name : builtins) {
-        Table.Declare(name);
+        Table.Declare(name, StaticType::Function);
     }
+}
 
-    bool ok = true;
-    for (auto& st : program) ok &= VisitStatement(st);
-    Table.ExitScope();
+bool SemanticAnalyser::AnalyseStatement(const Statement& statement) {
+    return VisitStatement(statement);
+}
+
+SymbolTable::State SemanticAnalyser::Checkpoint() const {
+    return Table.Snapshot();
+}
+
+void SemanticAnalyser::Resume(SymbolTable::State state) {
+    Table.Restore(std::move(state));
+}
+
+const std::unordered_set<std::string>& SemanticAnalyser::Rebounds() const {
+    return Rebound;
+}
+
+void SemanticAnalyser::Report(const std::string& msg) {
+    if (!Quiet) Errs << msg << "\n";
+}
+
+void SemanticAnalyser::CollectRebound(const std::vector<Statement>& stmts) {
+    for (auto& st : stmts) {
+        std::visit([this](auto&& s) {
+            using T = std::decay_t<decltype(s)>;
+            if constexpr (std::is_same_v<T, ExpressionStatement>) {
+                CollectRebound(s.Expression);
+            } else if constexpr (std::is_same_v<T, IfStatement>) {
+                CollectRebound(s.Condition);
+                CollectRebound(s.ThenBranch);
+                CollectRebound(s.ElseBranch);
+            } else if constexpr (std::is_same_v<T, WhileStatement>) {
+                CollectRebound(s.Condition);
+                CollectRebound(s.Body);
+            } else if constexpr (std::is_same_v<T, ForStatement>) {
+                Rebound.insert(s.Var);
+                CollectRebound(s.Iterable);
+                CollectRebound(s.Body);
+            } else if constexpr (std::is_same_v<T, ReturnStatement>) {
+                if (s.Value) CollectRebound(*s.Value);
+            } else if constexpr (std::is_same_v<T, YieldStatement>) {
+                CollectRebound(s.Value);
+            } else if constexpr (std::is_same_v<T, BlockStatement>) {
+                CollectRebound(s.Statements);
+            }
+        }, st.Value);
+    }
+}
+
+void SemanticAnalyser::CollectRebound(const Expression& expr) {
+    std::visit([this](auto&& e) {
+        using T = std::decay_t<decltype(e)>;
+        if constexpr (std::is_same_v<T, AssignExpression>) {
+            Rebound.insert(e.Name);
+            CollectRebound(*e.Rhs);
+        } else if constexpr (std::is_same_v<T, FunctionExpression>) {
+            for (auto& p : e.Params) Rebound.insert(p);
+            CollectRebound(e.Body);
+        } else if constexpr (std::is_same_v<T, UnaryExpression>) {
+            CollectRebound(*e.Rhs);
+        } else if constexpr (std::is_same_v<T, BinaryExpression>) {
+            CollectRebound(*e.Lhs);
+            CollectRebound(*e.Rhs);
+        } else if constexpr (std::is_same_v<T, CallExpression>) {
+            CollectRebound(*e.Callee);
+            for (auto& a : e.Args) CollectRebound(*a);
+        } else if constexpr (std::is_same_v<T, ListExpression>) {
+            for (auto& el : e.Elements) CollectRebound(*el);
+        } else if constexpr (std::is_same_v<T, MapExpression>) {
+            for (auto& k : e.Keys) CollectRebound(*k);
+            for (auto& v : e.Values) CollectRebound(*v);
+        } else if constexpr (std::is_same_v<T, IndexExpression>) {
+            CollectRebound(*e.Obj);
+            CollectRebound(*e.Index);
+        } else if constexpr (std::is_same_v<T, SliceExpression>) {
+            CollectRebound(*e.Obj);
+            CollectRebound(*e.From);
+            if (e.To) CollectRebound(*e.To);
+        } else if constexpr (std::is_same_v<T, IndexAssignExpression>) {
+            CollectRebound(*e.Obj);
+            CollectRebound(*e.Index);
+            CollectRebound(*e.Rhs);
+        }
+    }, expr.Value);
+}
+
+bool SemanticAnalyser::IsNative(const Expression& callee) const {
+    auto v = std::get_if<VariableExpression>(&callee.Value);
+    return v && !Rebound.count(v->Name) && NativeResults.count(v->Name);
+}
+
+bool SemanticAnalyser::AnalyseLoop(const std::function<bool()>& pass) {
+    bool quiet = Quiet;
+    Quiet = true;
+    bool stable = false;
+    for (int i = 0; i < MaxLoopPasses && !stable; ++i) {
+        auto entry = Table.Snapshot();
+        pass();
+        auto exit = Table.Snapshot();
+        Table.Restore(entry);
+        Table.Join(exit);
+        stable = Table.Snapshot() == entry;
+    }
+    if (!stable) Table.Forget();
+    Quiet = quiet;
+    auto entry = Table.Snapshot();
+    bool ok = pass();
+    Table.Restore(std::move(entry));
     return ok;
 }
 
@@ -55,36 +285,104 @@ bool SemanticAnalyser::VisitStatement(const Statement& Statement) {
         if constexpr (std::is_same_v<T, WhileStatement>)  return CheckWhile(s);
         if constexpr (std::is_same_v<T, ForStatement>)    return CheckFor(s);
         if constexpr (std::is_same_v<T, ReturnStatement>) return CheckReturn(s);
+        if constexpr (std::is_same_v<T, YieldStatement>)  return CheckYield(s);
         if constexpr (std::is_same_v<T, BlockStatement>)  return CheckBlock(s);
         return true;
     }, Statement.Value);
 }
 
 bool SemanticAnalyser::VisitExpression(const Expression& expr) {
-    return std::visit([this](auto&& e) -> bool {
+    return std::visit([this, &expr](auto&& e) -> bool {
         using T = std::decay_t<decltype(e)>;
-        if constexpr (std::is_same_v<T, NumberExpression> ||
-                      std::is_same_v<T, StringExpression> ||
-                      std::is_same_v<T, BoolExpression>   ||
-                      std::is_same_v<T, NilExpression>)    return true;
-        if constexpr (std::is_same_v<T, VariableExpression>) return CheckVariable(e);
-        if constexpr (std::is_same_v<T, UnaryExpression>)    return CheckUnary(e);
-        if constexpr (std::is_same_v<T, BinaryExpression>)   return CheckBinary(e);
-        if constexpr (std::is_same_v<T, CallExpression>)     return CheckCall(e);
-        if constexpr (std::is_same_v<T, ListExpression>)     return CheckList(e);
+        if constexpr (std::is_same_v<T, NumberExpression>) {
+            expr.Type = StaticType::Number;
+            return true;
+        }
+        if constexpr (std::is_same_v<T, StringExpression>) {
+            expr.Type = StaticType::String;
+            return true;
+        }
+        if constexpr (std::is_same_v<T, BoolExpression>) {
+            expr.Type = StaticType::Bool;
+            return true;
+        }
+        if constexpr (std::is_same_v<T, NilExpression>) {
+            expr.Type = StaticType::Nil;
+            return true;
+        }
+        if constexpr (std::is_same_v<T, VariableExpression>) {
+            expr.Type = Table.TypeOf(e.Name);
+            return CheckVariable(e);
+        }
+        if constexpr (std::is_same_v<T, UnaryExpression>) {
+            bool ok = CheckUnary(e);
+            expr.Type = UnaryType(e);
+            return ok;
+        }
+        if constexpr (std::is_same_v<T, BinaryExpression>) {
+            bool ok = CheckBinary(e);
+            expr.Type = BinaryType(e);
+            return ok;
+        }
+        if constexpr (std::is_same_v<T, CallExpression>) {
+            bool ok = CheckCall(e);
+            expr.Type = CallType(e);
+            if (!IsNative(*e.Callee)) Table.Forget();
+            return ok;
+        }
+        if constexpr (std::is_same_v<T, ListExpression>) {
+            expr.Type = StaticType::List;
+            return CheckList(e);
+        }
+        if constexpr (std::is_same_v<T, MapExpression>) {
+            expr.Type = StaticType::Map;
+            return CheckMap(e);
+        }
+        if constexpr (std::is_same_v<T, ImportExpression>) {
+            expr.Type = StaticType::Map;
+            Table.Forget();
+            return true;
+        }
+        if constexpr (std::is_same_v<T, IndexExpression> || std::is_same_v<T, SliceExpression>) {
+            bool ok = VisitExpression(*e.Obj);
+            if constexpr (std::is_same_v<T, IndexExpression>) {
+                ok &= VisitExpression(*e.Index);
+            } else {
+                ok &= VisitExpression(*e.From);
+                if (e.To) ok &= VisitExpression(*e.To);
+            }
+            expr.Type = IndexType(*e.Obj, std::is_same_v<T, SliceExpression>);
+            return ok;
+        }
+        if constexpr (std::is_same_v<T, IndexAssignExpression>) {
+            bool ok = VisitExpression(*e.Obj);
+            ok &= VisitExpression(*e.Index);
+            ok &= VisitExpression(*e.Rhs);
+            expr.Type = e.Rhs->Type;
+            return ok;
+        }
         if constexpr (std::is_same_v<T, FunctionExpression>) {
+            expr.Type = StaticType::Function;
+            auto outer = Table.Snapshot();
+            Table.Forget();
             Table.EnterScope();
             for (auto& p : e.Params) Table.Declare(p);
+            ++FunctionDepth;
             bool ok = true;
             for (auto& st : e.Body) ok &= VisitStatement(st);
+            --FunctionDepth;
             Table.ExitScope();
+            Table.Restore(std::move(outer));
             return ok;
         }
         if constexpr (std::is_same_v<T, AssignExpression>) {
             if (!Table.Exists(e.Name)) {
                 Table.Declare(e.Name);
             }
-            return VisitExpression(*e.Rhs);
+            bool ok = VisitExpression(*e.Rhs);
+            expr.Type = e.Rhs->Type;
+            Table.SetType(e.Name, expr.Type);
+            return ok;
         }
         return true;
     }, expr.Value);
@@ -96,31 +394,49 @@ bool SemanticAnalyser::CheckExpressionStatement(const ExpressionStatement& s) {
 
 bool SemanticAnalyser::CheckIf(const IfStatement& s) {
     bool ok = VisitExpression(s.Condition);
+    auto before = Table.Snapshot();
     Table.EnterScope();
     for (auto& st : s.ThenBranch) ok &= VisitStatement(st);
     Table.ExitScope();
+    auto afterThen = Table.Snapshot();
+    Table.Restore(std::move(before));
     if (!s.ElseBranch.empty()) {
         Table.EnterScope();
         for (auto& st : s.ElseBranch) ok &= VisitStatement(st);
         Table.ExitScope();
     }
+    Table.Join(afterThen);
     return ok;
 }
 
 bool SemanticAnalyser::CheckWhile(const WhileStatement& s) {
-    bool ok = VisitExpression(s.Condition);
-    Table.EnterScope();
-    for (auto& st : s.Body) ok &= VisitStatement(st);
-    Table.ExitScope();
-    return ok;
+    return AnalyseLoop([this, &s] {
+        bool ok = VisitExpression(s.Condition);
+        Table.EnterScope();
+        for (auto& st : s.Body) ok &= VisitStatement(st);
+        Table.ExitScope();
+        return ok;
+    });
 }
 
 bool SemanticAnalyser::CheckFor(const ForStatement& s) {
     bool ok = VisitExpression(s.Iterable);
-    Table.EnterScope();
-    ok &= Table.Declare(s.Var);
-    for (auto& st : s.Body) ok &= VisitStatement(st);
-    Table.ExitScope();
+    StaticType element = StaticType::Unknown;
+    if (auto call = std::get_if<CallExpression>(&s.Iterable.Value)) {
+        auto callee = std::get_if<VariableExpression>(&call->Callee->Value);
+        if (callee && callee->Name == "range" && IsNative(*call->Callee)) element = StaticType::Number;
+    }
+    // Anything but range() may be a generator, which runs between passes
+    // of the body and can change the type of any variable.
+    bool generated = element != StaticType::Number;
+    ok &= AnalyseLoop([this, &s, element, generated] {
+        if (generated) Table.Forget();
+        Table.EnterScope();
+        bool ok = Table.Declare(s.Var, element);
+        for (auto& st : s.Body) ok &= VisitStatement(st);
+        Table.ExitScope();
+        return ok;
+    });
     return ok;
 }
 
@@ -128,6 +444,16 @@ bool SemanticAnalyser::CheckReturn(const ReturnStatement& s) {
     return s.Value ? VisitExpression(*s.Value) : true;
 }
 
+bool SemanticAnalyser::CheckYield(const YieldStatement& s) {
+    bool ok = VisitExpression(s.Value);
+    Table.Forget();
+    if (FunctionDepth == 0) {
+        Report("yield outside of function");
+        return false;
+    }
+    return ok;
+}
+
 bool SemanticAnalyser::CheckBlock(const BlockStatement& s) {
     Table.EnterScope();
     bool ok = true;
@@ -154,20 +480,32 @@ bool SemanticAnalyser::CheckLiteral(const NilExpression&) {
 
 bool SemanticAnalyser::CheckVariable(const VariableExpression& e) {
     if (!Table.Exists(e.Name)) {
-        Errs << "Undefined variable: " << e.Name << "\n";
+        Report("Undefined variable: " + e.Name);
         return false;
     }
     return true;
 }
 
 bool SemanticAnalyser::CheckUnary(const UnaryExpression& e) {
-    return VisitExpression(*e.Rhs);
+    if (!VisitExpression(*e.Rhs)) return false;
+    if (e.Op == TokenType::Minus && Known(e.Rhs->Type) && e.Rhs->Type != StaticType::Number) {
+        Report(std::string("Type error: unary - applied to ") + TypeName(e.Rhs->Type));
+        return false;
+    }
+    return true;
 }
 
 bool SemanticAnalyser::CheckBinary(const BinaryExpression& e) {
     bool ok = VisitExpression(*e.Lhs);
     ok &= VisitExpression(*e.Rhs);
-    return ok;
+    if (!ok) return false;
+    if (e.Op == TokenType::And || e.Op == TokenType::Or) return true;
+    if (Known(e.Lhs->Type) && Known(e.Rhs->Type) && !Known(BinaryType(e))) {
+        Report(std::string("Type error: ") + TypeName(e.Lhs->Type) + " " + OpName(e.Op) +
+               " " + TypeName(e.Rhs->Type));
+        return false;
+    }
+    return true;
 }
 
 bool SemanticAnalyser::CheckCall(const CallExpression& e) {
@@ -181,3 +519,72 @@ bool SemanticAnalyser::CheckList(const ListExpression& e) {
     for (auto& el : e.Elements) ok &= VisitExpression(*el);
     return ok;
 }
+
+bool SemanticAnalyser::CheckMap(const MapExpression& e) {
+    bool ok = true;
+    for (auto& k : e.Keys) ok &= VisitExpression(*k);
+    for (auto& v : e.Values) ok &= VisitExpression(*v);
+    return ok;
+}
+
+StaticType SemanticAnalyser::UnaryType(const UnaryExpression& e) {
+    if (e.Op != TokenType::Minus) return StaticType::Bool;
+    return e.Rhs->Type == StaticType::Number ? StaticType::Number : StaticType::Unknown;
+}
+
+StaticType SemanticAnalyser::BinaryType(const BinaryExpression& e) {
+    StaticType l = e.Lhs->Type;
+    StaticType r = e.Rhs->Type;
+    switch (e.Op) {
+        case TokenType::And:
+        case TokenType::Or:
+            return Merge(l, r);
+        case TokenType::DoubleEqual:
+        case TokenType::NotEqual:
+            return StaticType::Bool;
+        default:
+            break;
+    }
+    if (!Known(l) || !Known(r)) return StaticType::Unknown;
+
+    switch (e.Op) {
+        case TokenType::Plus:
+            if (l == StaticType::Number && Numeric(r)) return StaticType::Number;
+            if ((l == StaticType::String || l == StaticType::List) && r == l) return l;
+            break;
+        case TokenType::Minus:
+            if (l == StaticType::Number && Numeric(r)) return StaticType::Number;
+            if (l == StaticType::String && r == l) return l;
+            break;
+        case TokenType::Asterisk:
+            if (l == StaticType::Number && Numeric(r)) return StaticType::Number;
+            if (l == StaticType::String && Numeric(r)) return StaticType::String;
+            break;
+        case TokenType::Slash:
+        case TokenType::Percent:
+        case TokenType::Caret:
+            if (Numeric(l) && Numeric(r)) return StaticType::Number;
+            break;
+        case TokenType::Less:
+        case TokenType::LessEqual:
+        case TokenType::Greater:
+        case TokenType::GreaterEqual:
+            if (Numeric(l) && Numeric(r)) return StaticType::Bool;
+            if (l == StaticType::String && r == l) return StaticType::Bool;
+            break;
+        default:
+            break;
+    }
+    return StaticType::Unknown;
+}
+
+StaticType SemanticAnalyser::CallType(const CallExpression& e) const {
+    if (!IsNative(*e.Callee)) return StaticType::Unknown;
+    return NativeResults.at(std::get<VariableExpression>(e.Callee->Value).Name);
+}
+
+StaticType SemanticAnalyser::IndexType(const Expression& obj, bool slice) {
+    if (obj.Type == StaticType::String) return StaticType::String;
+    if (obj.Type == StaticType::List && slice) return StaticType::List;
+    return StaticType::Unknown;
+}
\ No newline at end of file
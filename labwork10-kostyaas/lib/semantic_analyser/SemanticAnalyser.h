@@ -2,18 +2,29 @@
 
 #include <vector>
 #include <ostream>
+#include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include "syntactic_analyser/SyntacticAnalyser.h"
 
 class SymbolTable {
 public:
+    using State = std::vector<std::unordered_map<std::string, StaticType>>;
+
     void EnterScope();
     void ExitScope();
-    bool Declare(const std::string& name);
+    bool Declare(const std::string& name, StaticType type = StaticType::Unknown);
     bool Exists(const std::string& name) const;
+    StaticType TypeOf(const std::string& name) const;
+    void SetType(const std::string& name, StaticType type);
+    void Forget();
+
+    State Snapshot() const;
+    void Restore(State state);
+    void Join(const State& other);
 
 private:
-    std::vector<std::unordered_map<std::string,bool>> Scopes;
+    State Scopes;
 };
 
 class SemanticAnalyser {
@@ -21,9 +32,29 @@ public:
     explicit SemanticAnalyser(std::ostream& errs);
     bool Analyse(const std::vector<Statement>& program);
 
+    // Step-wise form of Analyse for callers that re-check part of a program:
+    // Begin() opens the global scope, AnalyseStatement() checks one top-level
+    // statement, Checkpoint() and Resume() save and restore the globals.
+    void Begin(const std::vector<Statement>& program);
+    bool AnalyseStatement(const Statement& statement);
+    SymbolTable::State Checkpoint() const;
+    void Resume(SymbolTable::State state);
+    const std::unordered_set<std::string>& Rebounds() const;
+
 private:
+    static constexpr int MaxLoopPasses = 4;
+
     std::ostream& Errs;
     SymbolTable Table;
+    std::unordered_set<std::string> Rebound;
+    bool Quiet = false;
+    int FunctionDepth = 0;
+
+    void Report(const std::string& msg);
+    void CollectRebound(const std::vector<Statement>& stmts);
+    void CollectRebound(const Expression& e);
+    bool IsNative(const Expression& callee) const;
+    bool AnalyseLoop(const std::function<bool()>& pass);
 
     bool VisitStatement(const Statement& Statement);
     bool VisitExpression(const Expression& expr);
@@ -33,6 +64,7 @@ private:
     bool CheckWhile(const WhileStatement& s);
     bool CheckFor(const ForStatement& s);
     bool CheckReturn(const ReturnStatement& s);
+    bool CheckYield(const YieldStatement& s);
     bool CheckBlock(const BlockStatement& s);
 
     bool CheckLiteral(const NumberExpression& e);
@@ -44,4 +76,10 @@ private:
     bool CheckBinary(const BinaryExpression& e);
     bool CheckCall(const CallExpression& e);
     bool CheckList(const ListExpression& e);
+    bool CheckMap(const MapExpression& e);
+
+    StaticType UnaryType(const UnaryExpression& e);
+    StaticType BinaryType(const BinaryExpression& e);
+    StaticType CallType(const CallExpression& e) const;
+    StaticType IndexType(const Expression& obj, bool slice);
 };
\ No newline at end of file
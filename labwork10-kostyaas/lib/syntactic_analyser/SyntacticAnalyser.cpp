@@ -1,19 +1,31 @@
 #include "SyntacticAnalyser.h"
 #include <stdexcept>
 #include <algorithm>
+#include <utility>
 
 SyntacticAnalyser::SyntacticAnalyser(std::istream& in)
     : Lex_(in), Cur_(Lex_.Next()) {}
 
+const std::vector<std::string>& SyntacticAnalyser::Imports() const {
+  return Imports_;
+}
+
+const std::vector<LineSpan>& SyntacticAnalyser::Spans() const {
+  return Spans_;
+}
+
 std::vector<Statement> SyntacticAnalyser::Parse() {
   std::vector<Statement> Program;
   while (Cur_.type != TokenType::EndOfFile) {
+    std::size_t first = Cur_.line;
     Program.push_back(ParseStatement());
+    Spans_.push_back({first, LastLine_});
   }
   return Program;
 }
 
 void SyntacticAnalyser::Update() {
+  LastLine_ = Lex_.EndLine();
   Cur_ = Lex_.Next();
 }
 
@@ -28,12 +40,18 @@ void SyntacticAnalyser::Check(TokenType t) {
 }
 
 Statement SyntacticAnalyser::ParseStatement() {
-  if (Cur_.type == TokenType::If)    { Update(); return ParseIf(); }
-  if (Cur_.type == TokenType::While) { Update(); return ParseWhile(); }
-  if (Cur_.type == TokenType::For)   { Update(); return ParseFor(); }
-  if (Cur_.type == TokenType::Return){ Update(); return ParseReturn(); }
-  Expression E = ParseExpression();
-  return Statement{ExpressionStatement{std::move(E)}};
+  std::size_t Line = Cur_.line;
+  Statement S = [&] {
+    if (Cur_.type == TokenType::If)    { Update(); return ParseIf(); }
+    if (Cur_.type == TokenType::While) { Update(); return ParseWhile(); }
+    if (Cur_.type == TokenType::For)   { Update(); return ParseFor(); }
+    if (Cur_.type == TokenType::Return){ Update(); return ParseReturn(); }
+    if (Cur_.type == TokenType::Yield) { Update(); return ParseYield(); }
+    Expression E = ParseExpression();
+    return Statement{ExpressionStatement{std::move(E)}};
+  }();
+  S.Line = Line;
+  return S;
 }
 
 Statement SyntacticAnalyser::ParseIf() {
@@ -50,11 +68,13 @@ Statement SyntacticAnalyser::ParseIf() {
   while (Cur_.type == TokenType::Else) {
     Update();
     if (Cur_.type == TokenType::If) {
+      std::size_t Line = Cur_.line;
       Update();
       Expression eCond = ParseExpression();
       Check(TokenType::Then);
       auto eThen = ParseBlock({TokenType::Else, TokenType::End});
       Cur_rent->ElseBranch.push_back(Statement{ IfStatement{ std::move(eCond), std::move(eThen), {} } });
+      Cur_rent->ElseBranch.back().Line = Line;
       auto& nested = std::get<IfStatement>(Cur_rent->ElseBranch.back().Value);
       Cur_rent = &nested;
     } else {
@@ -99,6 +119,11 @@ Statement SyntacticAnalyser::ParseReturn() {
   return Statement{ReturnStatement{std::move(Val)}};
 }
 
+Statement SyntacticAnalyser::ParseYield() {
+  ++Yields_;
+  return Statement{YieldStatement{ParseExpression()}};
+}
+
 std::vector<Statement> SyntacticAnalyser::ParseBlock(std::initializer_list<TokenType> endTypes) {
   std::vector<Statement> Statements;
   while (Cur_.type != TokenType::EndOfFile &&
@@ -121,6 +146,10 @@ Expression SyntacticAnalyser::ParseAssignment() {
     TokenType Op = Cur_.type;
     Update();
     auto rhs = std::make_unique<Expression>(ParseAssignment());
+    if (Op == TokenType::Assign && std::holds_alternative<IndexExpression>(E.Value)) {
+      auto target = std::get<IndexExpression>(std::move(E.Value));
+      return Expression{IndexAssignExpression{std::move(target.Obj), std::move(target.Index), std::move(rhs)}};
+    }
     if (!std::holds_alternative<VariableExpression>(E.Value))
       throw std::runtime_error("Invalid assignment target");
     auto var = std::get<VariableExpression>(std::move(E.Value)).Name;
@@ -252,7 +281,9 @@ Expression SyntacticAnalyser::ParseCall() {
 Expression SyntacticAnalyser::ParsePrimary() {
   if (Cur_.type == TokenType::Number) {
     Token tok = Cur_; Update();
-    return Expression{NumberExpression{std::stod(tok.lexeme)}};
+    double v = std::stod(tok.lexeme);
+    bool integral = tok.lexeme.find_first_of(".eE") == std::string::npos && v <= 9007199254740992.0;
+    return Expression{NumberExpression{v, integral}};
   }
   if (Cur_.type == TokenType::String) {
     Token tok = Cur_; Update();
@@ -270,6 +301,14 @@ Expression SyntacticAnalyser::ParsePrimary() {
     Token tok = Cur_; Update();
     return Expression{VariableExpression{tok.lexeme}};
   }
+  if (Cur_.type == TokenType::Import) {
+    Update();
+    if (Cur_.type != TokenType::String)
+      throw std::runtime_error("Checked module path");
+    Token tok = Cur_; Update();
+    Imports_.push_back(tok.lexeme);
+    return Expression{ImportExpression{tok.lexeme}};
+  }
   if (Cur_.type == TokenType::LBracket) {
     Update();
     std::vector<std::unique_ptr<Expression>> Elements;
@@ -280,6 +319,18 @@ Expression SyntacticAnalyser::ParsePrimary() {
     Check(TokenType::RBracket);
     return Expression{ListExpression{std::move(Elements)}};
   }
+  if (Cur_.type == TokenType::LBrace) {
+    Update();
+    std::vector<std::unique_ptr<Expression>> Keys, Values;
+    while (Cur_.type != TokenType::RBrace) {
+      Keys.push_back(std::make_unique<Expression>(ParseExpression()));
+      Check(TokenType::Colon);
+      Values.push_back(std::make_unique<Expression>(ParseExpression()));
+      if (!Match(TokenType::Comma)) break;
+    }
+    Check(TokenType::RBrace);
+    return Expression{MapExpression{std::move(Keys), std::move(Values)}};
+  }
   if (Cur_.type == TokenType::Function) {
     Update();
     Check(TokenType::LParen);
@@ -293,10 +344,13 @@ Expression SyntacticAnalyser::ParsePrimary() {
       } while (Match(TokenType::Comma));
     }
     Check(TokenType::RParen);
+    std::size_t OuterYields = std::exchange(Yields_, 0);
     auto Body = ParseBlock({TokenType::End});
     Check(TokenType::End);
     Check(TokenType::Function);
-    return Expression{FunctionExpression{std::move(Params), std::move(Body)}};
+    bool Generator = Yields_ > 0;
+    Yields_ = OuterYields;
+    return Expression{FunctionExpression{std::move(Params), std::move(Body), Generator}};
   }
   if (Cur_.type == TokenType::LParen) {
     Update();
@@ -6,8 +6,20 @@
 #include <variant>
 #include "lexical_analyser/LexicalAnalyser.h"
 
+enum class StaticType {
+  Unknown,
+  Number,
+  String,
+  Bool,
+  Nil,
+  List,
+  Map,
+  Function
+};
+
 struct NumberExpression {
   double Value;
+  bool Integral = false;
 };
 
 struct StringExpression {
@@ -47,6 +59,14 @@ struct ListExpression {
 struct FunctionExpression {
   std::vector<std::string> Params;
   std::vector<struct Statement> Body;
+  bool Generator = false;
+  // Set by LoopOptimiser when the body only reads enclosing variables, so
+  // calls may run on several threads at once. Whether the names in Calls
+  // hold such functions and the names in Locals are unbound outside is
+  // only known when the closure exists, so the interpreter checks them.
+  bool Pure = false;
+  std::vector<std::string> Calls{};
+  std::vector<std::string> Locals{};
 };
 
 struct AssignExpression {
@@ -64,6 +84,25 @@ struct SliceExpression {
   std::unique_ptr<Expression> From, To;
 };
 
+struct MapExpression {
+  std::vector<std::unique_ptr<Expression>> Keys;
+  std::vector<std::unique_ptr<Expression>> Values;
+};
+
+struct IndexAssignExpression {
+  std::unique_ptr<Expression> Obj, Index;
+  std::unique_ptr<Expression> Rhs;
+};
+
+struct HoistedExpression {
+  std::size_t Slot;
+  std::unique_ptr<Expression> Inner;
+};
+
+struct ImportExpression {
+  std::string Path;
+};
+
 using ExpressionVariant = std::variant<
   NumberExpression,
   StringExpression,
@@ -77,11 +116,16 @@ using ExpressionVariant = std::variant<
   FunctionExpression,
   AssignExpression,
   IndexExpression,
-  SliceExpression
+  SliceExpression,
+  MapExpression,
+  IndexAssignExpression,
+  HoistedExpression,
+  ImportExpression
 >;
 
 struct Expression {
   ExpressionVariant Value;
+  mutable StaticType Type = StaticType::Unknown;
   template<typename T>
   Expression(T&& v): Value(std::forward<T>(v)) {}
 };
@@ -99,18 +143,31 @@ struct IfStatement {
 struct WhileStatement {
   Expression Condition;
   std::vector<struct Statement> Body;
+  std::vector<std::size_t> Hoisted{};
 };
 
 struct ForStatement {
   std::string Var;
   Expression Iterable;
   std::vector<struct Statement> Body;
+  std::vector<std::size_t> Hoisted{};
+};
+
+struct CountedLoopStatement {
+  WhileStatement Loop;
+  std::string Var;
+  TokenType Cmp;
+  long long Step;
 };
 
 struct ReturnStatement {
   std::unique_ptr<Expression> Value;
 };
 
+struct YieldStatement {
+  Expression Value;
+};
+
 struct BlockStatement {
   std::vector<struct Statement> Statements;
 };
@@ -121,23 +178,42 @@ using StatementVariant = std::variant<
   WhileStatement,
   ForStatement,
   ReturnStatement,
-  BlockStatement
+  BlockStatement,
+  CountedLoopStatement,
+  YieldStatement
 >;
 
 struct Statement {
   StatementVariant Value;
+  // Line the statement starts on, 0 when unknown. Statements parsed by
+  // IncrementalFrontEnd count from the start of their fragment.
+  std::size_t Line = 0;
   template<typename T>
   Statement(T&& v): Value(std::forward<T>(v)) {}
 };
 
+// Source lines covered by a top-level statement, both ends inclusive.
+struct LineSpan {
+  std::size_t First;
+  std::size_t Last;
+};
+
 class SyntacticAnalyser {
 public:
   explicit SyntacticAnalyser(std::istream& in);
   std::vector<Statement> Parse();
+  // Module paths named by `import` expressions seen so far, in source order.
+  const std::vector<std::string>& Imports() const;
+  // Line span of each statement returned by Parse(), index for index.
+  const std::vector<LineSpan>& Spans() const;
 
 private:
   LexicalAnalyser Lex_;
   Token Cur_;
+  std::size_t Yields_ = 0;
+  std::vector<std::string> Imports_;
+  std::vector<LineSpan> Spans_;
+  std::size_t LastLine_ = 0;
 
   void Update();
   bool Match(TokenType t);
@@ -148,6 +224,7 @@ private:
   Statement ParseWhile();
   Statement ParseFor();
   Statement ParseReturn();
+  Statement ParseYield();
   std::vector<Statement> ParseBlock(std::initializer_list<TokenType> endTypes);
 
   Expression ParseExpression();
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "interpreter/interpreter.h"
+#include "interpreter/HashMap.h"
 
 struct ParseExpression {
     class Interpreter* I;
     Environment* env;
-    Value operator()(const NumberExpression& e) const { return Value(e.Value); }
+    Value operator()(const NumberExpression& e) const {
+        if (e.Integral) return Value(static_cast<int64_t>(e.Value));
+        return Value(e.Value);
+    }
     Value operator()(const StringExpression& e) const { return Value(e.Value); }
     Value operator()(const BoolExpression&   e) const { return Value(e.Value); }
     Value operator()(const NilExpression&    ) const { return Value(NilType{}); }
@@ -15,6 +19,7 @@ struct ParseExpression {
     Value operator()(const UnaryExpression& e) const {
         Value r = I->ParseNode(*e.Rhs, env);
         if (e.Op==TokenType::Minus) {
+            if (auto pi = std::get_if<int64_t>(&r.data)) return Value(-*pi);
             return Value(-std::get<double>(r.data));
         }
         return Value(!I->IsTruthy(r));
@@ -36,7 +41,19 @@ struct ParseExpression {
         auto& a = L.data;
         auto& b = R.data;
 
+        auto li = std::get_if<int64_t>(&a);
+        auto ri = std::get_if<int64_t>(&b);
+        if (li && ri) {
+            Value res;
+            if (IntArith(e.Op, *li, *ri, res)) return res;
+        }
+        if (e.Lhs->Type == StaticType::Number && e.Rhs->Type == StaticType::Number) {
+            Value res;
+            if (NumberArith(e.Op, L.AsDouble(), R.AsDouble(), res)) return res;
+        }
+
         auto to_num = [&](const Value& v)->double {
+            if (auto pi = std::get_if<int64_t>(&v.data)) return static_cast<double>(*pi);
             if (auto pd = std::get_if<double>(&v.data)) return *pd;
             if (auto pb = std::get_if<bool>(&v.data))   return *pb ? 1.0 : 0.0;
             throw std::runtime_error("Operand is not a number or bool");
@@ -44,15 +61,25 @@ struct ParseExpression {
 
         switch (e.Op) {
           case TokenType::Plus:
-            if (auto pd = std::get_if<double>(&a))
-              return Value(*pd + to_num(R));
-            if (auto ps = std::get_if<std::string>(&a))
-              return Value(*ps + std::get<std::string>(b));
+            if (L.IsNumber())
+              return Value(to_num(L) + to_num(R));
+            if (auto ps = std::get_if<std::string>(&a)) {
+              const auto& t = std::get<std::string>(b);
+              I->ChargeHeap(ps->size() + t.size(), HeapKind::String);
+              return Value(*ps + t);
+            }
+            if (auto pa = std::get_if<Value::Array>(&a)) {
+              const auto& pb = std::get<Value::Array>(b);
+              I->ChargeHeap(pa->size() * pa->ElementBytes() + pb.size() * pb.ElementBytes(), HeapKind::List);
+              Value::Array res = *pa;
+              res.Append(std::get<Value::Array>(b));
+              return Value(std::move(res));
+            }
             break;
 
           case TokenType::Minus:
-            if (auto pd = std::get_if<double>(&a))
-              return Value(*pd - to_num(R));
+            if (L.IsNumber())
+              return Value(to_num(L) - to_num(R));
             if (auto ps = std::get_if<std::string>(&a)) {
               std::string s = *ps, t = std::get<std::string>(b);
               if (s.size() >= t.size() &&
@@ -63,13 +90,16 @@ struct ParseExpression {
             break;
 
           case TokenType::Asterisk:
-            if (auto pd = std::get_if<double>(&a))
-              return Value(*pd * to_num(R));
+            if (L.IsNumber())
+              return Value(to_num(L) * to_num(R));
             if (auto ps = std::get_if<std::string>(&a)) {
-              std::string s = *ps;
-              int times = static_cast<int>(std::floor(to_num(R)));
+              const std::string& s = *ps;
+              double times = std::floor(to_num(R));
+              if (times <= 0 || s.empty()) return Value(std::string());
+              I->ChargeHeap(static_cast<size_t>(std::min(times, 1e18 / s.size())) * s.size(), HeapKind::String);
               std::string out;
-              for (int i = 0; i < times; ++i) out += s;
+              out.reserve(static_cast<size_t>(times) * s.size());
+              for (size_t i = 0; i < static_cast<size_t>(times); ++i) out += s;
               return Value(out);
             }
             break;
@@ -89,28 +119,28 @@ struct ParseExpression {
             return Value(!I->IsEqual(L, R));
 
           case TokenType::Less:
-            if (std::holds_alternative<double>(L.data) || std::holds_alternative<bool>(L.data))
+            if (L.IsNumber() || std::holds_alternative<bool>(L.data))
               return Value(to_num(L) < to_num(R));
             if (auto ps = std::get_if<std::string>(&a))
               return Value(*ps < std::get<std::string>(b));
             break;
 
           case TokenType::LessEqual:
-            if (std::holds_alternative<double>(L.data) || std::holds_alternative<bool>(L.data))
+            if (L.IsNumber() || std::holds_alternative<bool>(L.data))
               return Value(to_num(L) <= to_num(R));
             if (auto ps = std::get_if<std::string>(&a))
               return Value(*ps <= std::get<std::string>(b));
             break;
 
           case TokenType::Greater:
-            if (std::holds_alternative<double>(L.data) || std::holds_alternative<bool>(L.data))
+            if (L.IsNumber() || std::holds_alternative<bool>(L.data))
               return Value(to_num(L) > to_num(R));
             if (auto ps = std::get_if<std::string>(&a))
               return Value(*ps > std::get<std::string>(b));
             break;
 
           case TokenType::GreaterEqual:
-            if (std::holds_alternative<double>(L.data) || std::holds_alternative<bool>(L.data))
+            if (L.IsNumber() || std::holds_alternative<bool>(L.data))
               return Value(to_num(L) >= to_num(R));
             if (auto ps = std::get_if<std::string>(&a))
               return Value(*ps >= std::get<std::string>(b));
@@ -123,6 +153,52 @@ struct ParseExpression {
         throw std::runtime_error("Bad operands for binary operation");
     }
 
+    static bool IntArith(TokenType op, int64_t l, int64_t r, Value& res) {
+        auto exact = [&res](int64_t v) {
+            if (v < -Value::MaxExactInt || v > Value::MaxExactInt) return false;
+            res = Value(v);
+            return true;
+        };
+        int64_t v;
+        switch (op) {
+          case TokenType::Plus:
+            return !__builtin_add_overflow(l, r, &v) && exact(v);
+          case TokenType::Minus:
+            return !__builtin_sub_overflow(l, r, &v) && exact(v);
+          case TokenType::Asterisk:
+            return !__builtin_mul_overflow(l, r, &v) && exact(v);
+          case TokenType::Percent:
+            if (r == 0) return false;
+            res = Value(l % r);
+            return true;
+          case TokenType::DoubleEqual:  res = Value(l == r); return true;
+          case TokenType::NotEqual:     res = Value(l != r); return true;
+          case TokenType::Less:         res = Value(l < r);  return true;
+          case TokenType::LessEqual:    res = Value(l <= r); return true;
+          case TokenType::Greater:      res = Value(l > r);  return true;
+          case TokenType::GreaterEqual: res = Value(l >= r); return true;
+          default:
+            return false;
+        }
+    }
+
+    static bool NumberArith(TokenType op, double l, double r, Value& res) {
+        switch (op) {
+          case TokenType::Plus:         res = Value(l + r); return true;
+          case TokenType::Minus:        res = Value(l - r); return true;
+          case TokenType::Asterisk:     res = Value(l * r); return true;
+          case TokenType::Slash:        res = Value(l / r); return true;
+          case TokenType::Percent:      res = Value(std::fmod(l, r)); return true;
+          case TokenType::Caret:        res = Value(std::pow(l, r)); return true;
+          case TokenType::Less:         res = Value(l < r);  return true;
+          case TokenType::LessEqual:    res = Value(l <= r); return true;
+          case TokenType::Greater:      res = Value(l > r);  return true;
+          case TokenType::GreaterEqual: res = Value(l >= r); return true;
+          default:
+            return false;
+        }
+    }
+
     Value operator()(const CallExpression& e) const {
         Value c = I->ParseNode(*e.Callee, env);
         if (!std::holds_alternative<Value::FuncPtr>(c.data))
@@ -136,13 +212,14 @@ struct ParseExpression {
     Value operator()(const ListExpression& e) const {
         Value::Array a;
         for (auto& el : e.Elements)
-            a.push_back(std::make_shared<Value>(I->ParseNode(*el, env)));
-        return Value(a);
+            a.Push(I->ParseNode(*el, env));
+        return Value(std::move(a));
     }
     Value operator()(const FunctionExpression& e) const {
-        auto fnobj = std::make_shared<FunctionObject>(
-            e.Params, &e.Body, env
+        auto fnobj = MakeShared<FunctionObject>(
+            e.Params, &e.Body, env, e.Generator
         );
+        fnobj->literal = &e;
         return Value(fnobj);
     }
     Value operator()(const AssignExpression& e) const {
@@ -152,32 +229,99 @@ struct ParseExpression {
         return val;
     }
 
+    Value operator()(const MapExpression& e) const {
+        auto m = MakeShared<HashMap>();
+        for (size_t i = 0; i < e.Keys.size(); ++i) {
+            Value key = I->ParseNode(*e.Keys[i], env);
+            if (!HashMap::IsHashable(key))
+                throw std::runtime_error("Unhashable map key");
+            m->Set(key, I->ParseNode(*e.Values[i], env));
+        }
+        return Value(m);
+    }
+
+    Value operator()(const IndexAssignExpression& e) const {
+        Value idxv = I->ParseNode(*e.Index, env);
+        Value val = I->ParseNode(*e.Rhs, env);
+        Value* target = nullptr;
+        Value holder;
+        if (auto pv = std::get_if<VariableExpression>(&e.Obj->Value)) {
+            target = env->Find(pv->Name);
+            if (!target) throw std::runtime_error("Undefined variable: " + pv->Name);
+        } else {
+            holder = I->ParseNode(*e.Obj, env);
+            target = &holder;
+        }
+        if (auto pm = std::get_if<Value::MapPtr>(&target->data)) {
+            if (!HashMap::IsHashable(idxv))
+                throw std::runtime_error("Unhashable map key");
+            (*pm)->Set(idxv, val);
+            return val;
+        }
+        if (auto pa = std::get_if<Value::Array>(&target->data)) {
+            int64_t idx = idxv.AsIndex();
+            int64_t n = (int64_t)pa->size();
+            if (idx < 0) idx += n;
+            if (idx < 0 || idx >= n) throw std::runtime_error("Array index out of range");
+            pa->Set(idx, val);
+            return val;
+        }
+        throw std::runtime_error("Index assignment to non-indexable type");
+    }
+
+    Value operator()(const ImportExpression& e) const {
+        return I->Import(e.Path);
+    }
+    Value operator()(const HoistedExpression& e) const {
+        if (auto& slot = I->HoistSlot(e.Slot)) return *slot;
+        Value v = I->ParseNode(*e.Inner, env);
+        I->HoistSlot(e.Slot) = v;
+        return v;
+    }
+
+    // Reads a variable in place rather than copying it out of the scope;
+    // any other expression is evaluated into `holder`.
+    const Value& Borrow(const Expression& e, Value& holder) const {
+        if (auto pv = std::get_if<VariableExpression>(&e.Value)) {
+            if (const Value* v = env->Find(pv->Name)) return *v;
+        }
+        holder = I->ParseNode(e, env);
+        return holder;
+    }
+
     Value operator()(const IndexExpression& e) const {
-        Value obj = I->ParseNode(*e.Obj, env);
         Value idxv = I->ParseNode(*e.Index, env);
-        int idx = static_cast<int>(std::get<double>(idxv.data));
+        Value holder;
+        const Value& obj = Borrow(*e.Obj, holder);
+        if (auto pm = std::get_if<Value::MapPtr>(&obj.data)) {
+            if (!HashMap::IsHashable(idxv))
+                throw std::runtime_error("Unhashable map key");
+            const Value* found = (*pm)->Find(idxv);
+            return found ? *found : Value(NilType{});
+        }
+        int64_t idx = idxv.AsIndex();
         if (auto ps = std::get_if<std::string>(&obj.data)) {
-            int n = (int)ps->size();
+            int64_t n = (int64_t)ps->size();
             if (idx < 0) idx += n;
             if (idx < 0 || idx >= n) throw std::runtime_error("String index out of range");
             return Value(std::string(1, (*ps)[idx]));
         }
         if (auto pa = std::get_if<Value::Array>(&obj.data)) {
-            int n = (int)pa->size();
+            int64_t n = (int64_t)pa->size();
             if (idx < 0) idx += n;
             if (idx < 0 || idx >= n) throw std::runtime_error("Array index out of range");
-            return *(*pa)[idx];
+            return pa->At(idx);
         }
         throw std::runtime_error("Indexing non-indexable type");
     }
 
     Value operator()(const SliceExpression& e) const {
-        Value obj = I->ParseNode(*e.Obj, env);
-        int from = static_cast<int>(std::get<double>(I->ParseNode(*e.From, env).data));
-        int to;
-        if (e.To) {
-            to = static_cast<int>(std::get<double>(I->ParseNode(*e.To, env).data));
-        } else {
+        int from = static_cast<int>(I->ParseNode(*e.From, env).AsIndex());
+        int to = 0;
+        if (e.To) to = static_cast<int>(I->ParseNode(*e.To, env).AsIndex());
+        Value holder;
+        const Value& obj = Borrow(*e.Obj, holder);
+        if (!e.To) {
             if (auto ps = std::get_if<std::string>(&obj.data))
                 to = (int)ps->size();
             else if (auto pa = std::get_if<Value::Array>(&obj.data))
@@ -199,10 +343,7 @@ struct ParseExpression {
             if (to   < 0) to   += n;
             from = std::clamp(from, 0, n);
             to   = std::clamp(to,   0, n);
-            Value::Array res;
-            for (int i = from; i < to; ++i)
-                res.push_back(std::make_shared<Value>(*(*pa)[i]));
-            return Value(res);
+            return Value(pa->Slice(from, to));
         }
         throw std::runtime_error("Slicing non-sliceable type");
     }
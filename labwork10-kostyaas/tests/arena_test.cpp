@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include "Interpreter.h"
+
+namespace {
+
+const char* Script = R"(
+items = []
+for i in range(200)
+    items = items + [[i, "s", {"k": i}]]
+end for
+g = function(x) return x * 2 end function
+print(len(items))
+print(g(3))
+)";
+
+std::string RunScript(bool pooled, ExecutionStats& stats) {
+    std::istringstream in(Script);
+    std::ostringstream out;
+    ExecutionLimits limits;
+    limits.PooledValues = pooled;
+    EXPECT_TRUE(Interpreter::Interpret(in, out, limits, &stats));
+    return out.str();
+}
+
+}
+
+TEST(ArenaTestSuite, CountsValueAllocations) {
+    ExecutionStats stats;
+    ASSERT_EQ(RunScript(true, stats), "2006");
+    EXPECT_GE(stats.Allocations, 600u);
+    EXPECT_GT(stats.PeakBytes, 0u);
+}
+
+TEST(ArenaTestSuite, GlobalAllocatorGivesSameCounts) {
+    ExecutionStats pooled;
+    ExecutionStats global;
+    ASSERT_EQ(RunScript(true, pooled), RunScript(false, global));
+    EXPECT_EQ(pooled.Allocations, global.Allocations);
+    EXPECT_EQ(pooled.PeakBytes, global.PeakBytes);
+}
+
+TEST(ArenaTestSuite, NoArenaOutsideRun) {
+    EXPECT_EQ(RunArena::Current(), nullptr);
+    auto v = MakeShared<Value>(1.0);
+    EXPECT_EQ(std::get<double>(v->data), 1.0);
+}
+
+TEST(ArenaTestSuite, TracksLiveAndPeakBytes) {
+    RunArena arena;
+    {
+        RunArena::Scope scope(&arena);
+        auto a = MakeShared<Value>(std::string("a"));
+        auto b = MakeShared<Value>(2.0);
+        a.reset();
+        auto c = MakeShared<Value>(3.0);
+    }
+    EXPECT_EQ(RunArena::Current(), nullptr);
+    EXPECT_EQ(arena.Allocations(), 3u);
+    EXPECT_GT(arena.PeakBytes(), 0u);
+}
+
+TEST(ArenaTestSuite, GeneratorValuesUseRunArena) {
+    std::istringstream in(R"(
+gen = function(n)
+    for i in range(n)
+        yield [i, [i]]
+    end for
+end function
+total = 0
+for pair in gen(50)
+    total = total + pair[0]
+end for
+print(total)
+)");
+    std::ostringstream out;
+    ExecutionStats stats;
+    ASSERT_TRUE(Interpreter::Interpret(in, out, {}, &stats));
+    EXPECT_EQ(out.str(), "1225");
+    EXPECT_GE(stats.Allocations, 50u);
+}
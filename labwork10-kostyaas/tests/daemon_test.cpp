@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "daemon/ScriptServer.h"
+
+namespace {
+
+std::string SocketPath(const std::string& name) {
+    return testing::TempDir() + "itmoscript_" + name + "_" + std::to_string(::getpid()) + ".sock";
+}
+
+protocol::Request SourceRequest(const std::string& code, const std::string& input = "") {
+    return {protocol::RequestKind::Source, code, input};
+}
+
+const char* SumScript = R"(
+total = 0
+for i in range(100)
+    total = total + i
+end for
+print(total)
+)";
+
+}
+
+TEST(DaemonTestSuite, RunsSourceRequest) {
+    ScriptServer server(SocketPath("source"), 2);
+    server.Start();
+    auto resp = protocol::Call(SocketPath("source"), SourceRequest(SumScript));
+    EXPECT_EQ(resp.Code, protocol::Status::Ok);
+    EXPECT_EQ(resp.Output, "4950");
+    EXPECT_EQ(resp.Errors, "");
+}
+
+TEST(DaemonTestSuite, ConcurrentClientsShareCompiledScript) {
+    std::string path = SocketPath("concurrent");
+    ScriptServer server(path, 4);
+    server.Start();
+
+    std::atomic<int> good{0};
+    std::vector<std::thread> clients;
+    for (int c = 0; c < 8; ++c) {
+        clients.emplace_back([&] {
+            int fd = protocol::Connect(path);
+            for (int r = 0; r < 10; ++r) {
+                protocol::WriteRequest(fd, SourceRequest(SumScript));
+                protocol::Response resp;
+                if (protocol::ReadResponse(fd, resp) && resp.Code == protocol::Status::Ok && resp.Output == "4950")
+                    ++good;
+            }
+            ::close(fd);
+        });
+    }
+    for (auto& t : clients) t.join();
+    EXPECT_EQ(good, 80);
+    EXPECT_GE(server.Compilations(), 1u);
+    EXPECT_LE(server.Compilations(), 4u);
+    EXPECT_EQ(server.Compilations() + server.CacheHits(), 80u);
+}
+
+TEST(DaemonTestSuite, ReadTakesLinesFromRequestInput) {
+    ScriptServer server(SocketPath("input"), 1);
+    auto resp = server.Handle(SourceRequest(R"(
+lines = []
+line = read()
+while line != nil
+    lines = lines + [line]
+    line = read()
+end while
+print(lines)
+)", "first\nsecond\n"));
+    EXPECT_EQ(resp.Code, protocol::Status::Ok) << resp.Errors;
+    EXPECT_EQ(resp.Output, "[\"first\", \"second\"]");
+}
+
+TEST(DaemonTestSuite, PathCacheFollowsModificationTime) {
+    std::string script = testing::TempDir() + "itmoscript_daemon_script.is";
+    std::ofstream(script) << "print(1)";
+    ScriptServer server(SocketPath("path"), 1);
+    protocol::Request req{protocol::RequestKind::Path, script, ""};
+
+    EXPECT_EQ(server.Handle(req).Output, "1");
+    EXPECT_EQ(server.Handle(req).Output, "1");
+    EXPECT_EQ(server.Compilations(), 1u);
+    EXPECT_EQ(server.CacheHits(), 1u);
+
+    std::ofstream(script) << "print(2)";
+    auto later = std::filesystem::last_write_time(script) + std::chrono::seconds(2);
+    std::filesystem::last_write_time(script, later);
+    EXPECT_EQ(server.Handle(req).Output, "2");
+    EXPECT_EQ(server.Compilations(), 2u);
+}
+
+TEST(DaemonTestSuite, ReportsErrorsWithStatus) {
+    ScriptServer server(SocketPath("errors"), 1);
+
+    auto syntax = server.Handle(SourceRequest("x = (1 +"));
+    EXPECT_EQ(syntax.Code, protocol::Status::Failed);
+    EXPECT_NE(syntax.Errors.find("Interpreter error"), std::string::npos);
+
+    auto semantic = server.Handle(SourceRequest("print(y)"));
+    EXPECT_EQ(semantic.Code, protocol::Status::Failed);
+    EXPECT_NE(semantic.Output.find("Undefined variable: y"), std::string::npos);
+
+    auto runtime = server.Handle(SourceRequest("print(1)\nx = [1, 2][7]"));
+    EXPECT_EQ(runtime.Code, protocol::Status::Failed);
+    EXPECT_EQ(runtime.Output, "1");
+    EXPECT_NE(runtime.Errors.find("Interpreter error"), std::string::npos);
+
+    auto missing = server.Handle({protocol::RequestKind::Path, "/nonexistent/script.is", ""});
+    EXPECT_EQ(missing.Code, protocol::Status::BadRequest);
+}
+
+TEST(DaemonTestSuite, DeadlineAbortsRun) {
+    ExecutionLimits limits;
+    limits.Deadline = std::chrono::milliseconds(50);
+    ScriptServer server(SocketPath("deadline"), 1, limits);
+    auto resp = server.Handle(SourceRequest("while true\nend while"));
+    EXPECT_EQ(resp.Code, protocol::Status::Failed);
+    EXPECT_NE(resp.Errors.find("aborted"), std::string::npos);
+}
+
+TEST(DaemonTestSuite, MalformedRequestGetsBadRequest) {
+    std::string path = SocketPath("malformed");
+    ScriptServer server(path, 1);
+    server.Start();
+    int fd = protocol::Connect(path);
+    const char junk[] = "X123";
+    ASSERT_EQ(::send(fd, junk, sizeof(junk) - 1, MSG_NOSIGNAL), 3 + 1);
+    protocol::Response resp;
+    ASSERT_TRUE(protocol::ReadResponse(fd, resp));
+    EXPECT_EQ(resp.Code, protocol::Status::BadRequest);
+    ::close(fd);
+
+    auto after = protocol::Call(path, SourceRequest("print(5)"));
+    EXPECT_EQ(after.Output, "5");
+}
+
+TEST(DaemonTestSuite, StopClosesIdleConnections) {
+    std::string path = SocketPath("stop");
+    auto server = std::make_unique<ScriptServer>(path, 1);
+    server->Start();
+    int fd = protocol::Connect(path);
+    protocol::WriteRequest(fd, SourceRequest("print(1)"));
+    protocol::Response resp;
+    ASSERT_TRUE(protocol::ReadResponse(fd, resp));
+    server->Stop();
+    EXPECT_FALSE(protocol::ReadResponse(fd, resp));
+    ::close(fd);
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST(DaemonTestSuite, IdleConnectionsDoNotHoldWorkers) {
+    std::string path = SocketPath("idle");
+    ScriptServer server(path, 1);
+    server.Start();
+    int idle = protocol::Connect(path);
+    int served = protocol::Connect(path);
+    protocol::WriteRequest(served, SourceRequest("print(1)"));
+    protocol::Response resp;
+    ASSERT_TRUE(protocol::ReadResponse(served, resp));
+
+    int other = protocol::Connect(path);
+    timeval tv{2, 0};
+    ::setsockopt(other, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    protocol::WriteRequest(other, SourceRequest("print(2)"));
+    ASSERT_TRUE(protocol::ReadResponse(other, resp));
+    EXPECT_EQ(resp.Output, "2");
+
+    protocol::WriteRequest(idle, SourceRequest("print(3)"));
+    ASSERT_TRUE(protocol::ReadResponse(idle, resp));
+    EXPECT_EQ(resp.Output, "3");
+    for (int fd : {idle, served, other}) ::close(fd);
+}
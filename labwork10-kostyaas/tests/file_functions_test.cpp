@@ -0,0 +1,84 @@
+#include <lib/Interpreter/Interpreter.h>
+#include <gtest/gtest.h>
+#include <fstream>
+#include "Iterators.h"
+
+namespace {
+
+std::string TempPath(const std::string& name) {
+    return testing::TempDir() + "itmoscript_" + name;
+}
+
+}
+
+TEST(FileFunctionsTestSuite, WriteAppendReadTest) {
+    std::string path = TempPath("write.txt");
+    std::string code =
+        "p = \"" + path + "\"\n"
+        "write_file(p, \"one\\n\")\n"
+        "append_file(p, \"two\")\n"
+        "print(len(read_file(p)))\n";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), "7");
+
+    std::ifstream f(path);
+    std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(content, "one\ntwo");
+}
+
+TEST(FileFunctionsTestSuite, ReadLinesTest) {
+    std::string path = TempPath("lines.txt");
+    std::ofstream(path) << "alpha\r\nbeta\n\ngamma";
+    std::string code =
+        "for line in read_lines(\"" + path + "\")\n"
+        "  print(len(line))\n"
+        "  print(\";\")\n"
+        "end for\n";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), "5;4;0;5;");
+}
+
+TEST(FileFunctionsTestSuite, ReadLinesLongerThanBufferTest) {
+    std::string path = TempPath("long.txt");
+    std::string longLine(LineIterator::BufferSize + 123, 'x');
+    {
+        std::ofstream f(path);
+        for (int i = 0; i < 3; ++i) f << longLine << "\n";
+        for (int i = 0; i < 100000; ++i) f << i << "\n";
+    }
+    std::string code =
+        "n = 0\n"
+        "total = 0\n"
+        "for line in read_lines(\"" + path + "\")\n"
+        "  n = n + 1\n"
+        "  total = total + len(line)\n"
+        "end for\n"
+        "print(n)\n"
+        "print(\";\")\n"
+        "print(total)\n";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    size_t digits = 0;
+    for (int i = 0; i < 100000; ++i) digits += std::to_string(i).size();
+    ASSERT_EQ(output.str(), "100003;" + std::to_string(3 * longLine.size() + digits));
+}
+
+TEST(FileFunctionsTestSuite, MissingFileTest) {
+    std::string code = "print(read_file(\"" + TempPath("missing/none.txt") + "\"))";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_FALSE(Interpreter(input, output));
+}
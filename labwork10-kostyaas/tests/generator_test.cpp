@@ -0,0 +1,146 @@
+#include <lib/Interpreter/Interpreter.h>
+#include <gtest/gtest.h>
+
+TEST(GeneratorTestSuite, YieldStreamsValuesTest) {
+    std::string code = R"(
+        count = function(n)
+            i = 0
+            while i < n
+                yield i
+                i = i + 1
+            end while
+        end function
+
+        for x in count(4)
+            print(x)
+        end for
+    )";
+
+    std::string expected = "0123";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+TEST(GeneratorTestSuite, ReturnEndsGeneratorTest) {
+    std::string code = R"(
+        gen = function()
+            yield "a"
+            yield "b"
+            return nil
+            yield "c"
+        end function
+
+        for x in gen()
+            print(x)
+        end for
+    )";
+
+    std::string expected = "ab";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+TEST(GeneratorTestSuite, EarlyExitFromInfiniteGeneratorTest) {
+    std::string code = R"(
+        naturals = function()
+            n = 1
+            while true
+                yield n
+                n = n + 1
+            end while
+        end function
+
+        first = function(limit)
+            for x in naturals()
+                if x > limit then return x end if
+            end for
+        end function
+
+        print(first(100))
+    )";
+
+    std::string expected = "101";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+TEST(GeneratorTestSuite, NestedGeneratorsTest) {
+    std::string code = R"(
+        count = function(n)
+            for i in range(n)
+                yield i
+            end for
+        end function
+
+        squares = function(n)
+            for i in count(n)
+                yield i * i
+            end for
+        end function
+
+        total = 0
+        for s in squares(1000)
+            total = total + s
+        end for
+        print(total)
+    )";
+
+    std::string expected = "332833500";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+TEST(GeneratorTestSuite, GeneratorErrorPropagatesTest) {
+    std::string code = R"(
+        bad = function()
+            yield 1
+            yield len(1)
+        end function
+
+        for x in bad()
+            print(x)
+        end for
+    )";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_FALSE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), "1");
+}
+
+TEST(GeneratorTestSuite, LazyRangeTest) {
+    std::string code = R"(
+        find = function(limit)
+            for i in range(1000000000000)
+                if i * i > limit then return i end if
+            end for
+        end function
+
+        print(find(1000000))
+    )";
+
+    std::string expected = "1001";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <sstream>
+#include "Interpreter.h"
+
+namespace {
+
+const char* Script = R"(items = []
+for i in range(300)
+    items = items + [[i, {"k": i}]]
+end for
+s = ""
+for i in range(100)
+    s = s + "abcdefgh"
+end for
+f = function(x) return x * 2 end function
+print(len(items))
+)";
+
+ExecutionStats RunScript(const std::string& code, bool profile, std::string* errors = nullptr) {
+    std::istringstream in(code);
+    auto script = Interpreter::Compile(in);
+    std::istringstream input;
+    std::ostringstream out;
+    std::ostringstream err;
+    ExecutionLimits limits;
+    limits.ProfileHeap = profile;
+    ExecutionStats stats;
+    EXPECT_TRUE(Interpreter::Run(*script, out, input, err, limits, &stats)) << err.str();
+    if (errors) *errors = err.str();
+    return stats;
+}
+
+const HeapSite* FindSite(const HeapReport& report, std::size_t line, HeapKind kind) {
+    auto it = std::find_if(report.Sites.begin(), report.Sites.end(), [&](const HeapSite& s) {
+        return s.Line == line && s.Kind == kind;
+    });
+    return it == report.Sites.end() ? nullptr : &*it;
+}
+
+}
+
+TEST(HeapProfileTestSuite, DisabledByDefault) {
+    std::string errors;
+    auto stats = RunScript(Script, false, &errors);
+    EXPECT_EQ(stats.Heap, nullptr);
+    EXPECT_EQ(errors, "");
+}
+
+TEST(HeapProfileTestSuite, CountsKindsAndLines) {
+    std::string errors;
+    auto stats = RunScript(Script, true, &errors);
+    ASSERT_NE(stats.Heap, nullptr);
+    const auto& heap = *stats.Heap;
+
+    auto kind = [&](HeapKind k) { return heap.Kinds[static_cast<std::size_t>(k)]; };
+    EXPECT_EQ(kind(HeapKind::Map).Allocations, 300u);
+    EXPECT_EQ(kind(HeapKind::String).Allocations, 100u);
+    EXPECT_GT(kind(HeapKind::List).Peak, 0u);
+    EXPECT_GT(kind(HeapKind::Environment).Allocations, 0u);
+    EXPECT_GT(kind(HeapKind::Function).Allocations, 0u);
+
+    auto lists = FindSite(heap, 3, HeapKind::List);
+    ASSERT_NE(lists, nullptr);
+    EXPECT_EQ(heap.Sites.front().Line, 3u);
+    EXPECT_EQ(FindSite(heap, 3, HeapKind::Map)->Counters.Peak, kind(HeapKind::Map).Peak);
+    ASSERT_NE(FindSite(heap, 7, HeapKind::String), nullptr);
+    EXPECT_EQ(FindSite(heap, 7, HeapKind::String)->Counters.Live, 0u);
+    EXPECT_NE(FindSite(heap, 9, HeapKind::Function), nullptr);
+
+    EXPECT_NE(errors.find("Heap profile: peak"), std::string::npos);
+    EXPECT_NE(errors.find("line 3"), std::string::npos);
+}
+
+TEST(HeapProfileTestSuite, SamplesFollowLoopGrowth) {
+    auto stats = RunScript(Script, true);
+    const auto& samples = stats.Heap->Samples;
+    ASSERT_GE(samples.size(), 4u);
+    for (std::size_t i = 1; i < samples.size(); ++i) EXPECT_GT(samples[i].Step, samples[i - 1].Step);
+    EXPECT_GT(samples.back().Live, samples.front().Live);
+    EXPECT_LE(samples.back().Live, stats.Heap->PeakBytes);
+}
+
+TEST(HeapProfileTestSuite, SampleSeriesStaysBounded) {
+    HeapProfile profile;
+    for (uint64_t step = 0; step < 2'000'000; ++step) profile.Sample(step);
+    auto report = profile.Report();
+    EXPECT_LE(report.Samples.size(), HeapProfile::MaxSamples);
+    EXPECT_GT(report.Samples.size(), HeapProfile::MaxSamples / 2);
+    EXPECT_EQ(report.Samples.front().Step, 0u);
+}
+
+TEST(HeapProfileTestSuite, ParallelWorkersAreMerged) {
+    auto stats = RunScript(R"(
+sq = function(x) return [x, x * x] end function
+out = pmap(range(2000), sq)
+print(len(out))
+)", true);
+    EXPECT_GE(stats.Heap->Kinds[static_cast<std::size_t>(HeapKind::List)].Allocations, 2000u);
+    EXPECT_NE(FindSite(*stats.Heap, 2, HeapKind::List), nullptr);
+}
+
+TEST(HeapProfileTestSuite, SameResultsWithAndWithoutProfile) {
+    auto plain = RunScript(Script, false);
+    auto profiled = RunScript(Script, true);
+    EXPECT_EQ(plain.Allocations, profiled.Allocations);
+    EXPECT_EQ(plain.PeakBytes, profiled.PeakBytes);
+    EXPECT_EQ(plain.Steps, profiled.Steps);
+}
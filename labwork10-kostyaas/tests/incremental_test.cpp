@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "frontend/IncrementalFrontEnd.h"
+
+namespace {
+
+std::string Numbered(int count) {
+    std::string src;
+    for (int i = 0; i < count; ++i) {
+        src += "v" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    }
+    return src;
+}
+
+void ExpectMatchesFullParse(const IncrementalFrontEnd& fe) {
+    IncrementalFrontEnd full(fe.Source());
+    EXPECT_EQ(fe.Valid(), full.Valid());
+    EXPECT_EQ(fe.Errors(), full.Errors());
+    ASSERT_EQ(fe.Spans().size(), full.Spans().size());
+    for (std::size_t i = 0; i < full.Spans().size(); ++i) {
+        EXPECT_EQ(fe.Spans()[i].First, full.Spans()[i].First) << i;
+        EXPECT_EQ(fe.Spans()[i].Last, full.Spans()[i].Last) << i;
+    }
+}
+
+}
+
+TEST(IncrementalTest, SpansFollowSource) {
+    IncrementalFrontEnd fe("x = 1\n\nif x > 0 then\n  print(x)\nend if\ny = \"a\nb\" z = 2\n");
+    ASSERT_TRUE(fe.Valid()) << fe.Errors();
+    ASSERT_EQ(fe.Spans().size(), 4u);
+    EXPECT_EQ(fe.Spans()[1].First, 3u);
+    EXPECT_EQ(fe.Spans()[1].Last, 5u);
+    EXPECT_EQ(fe.Spans()[2].First, 6u);
+    EXPECT_EQ(fe.Spans()[2].Last, 7u);
+    EXPECT_EQ(fe.Spans()[3].First, 7u);
+}
+
+TEST(IncrementalTest, OneLineEditReparsesNeighboursOnly) {
+    IncrementalFrontEnd fe(Numbered(5000));
+    ASSERT_TRUE(fe.Valid());
+    fe.Apply({2500, 2500, "v2499 = v2498 + 1"});
+    EXPECT_TRUE(fe.Valid()) << fe.Errors();
+    EXPECT_LE(fe.LastStats().Reparsed, 3u);
+    EXPECT_LT(fe.LastStats().Reanalysed, 1000u);
+    EXPECT_EQ(fe.Program().size(), 5000u);
+    ExpectMatchesFullParse(fe);
+}
+
+TEST(IncrementalTest, InsertAndDeleteShiftLaterSpans) {
+    IncrementalFrontEnd fe(Numbered(100));
+    fe.Apply({10, 9, "a = 1\nb = a + 1\n"});
+    EXPECT_EQ(fe.Program().size(), 102u);
+    EXPECT_EQ(fe.Spans().back().First, 102u);
+    ExpectMatchesFullParse(fe);
+    fe.Apply({1, 20, ""});
+    EXPECT_EQ(fe.Program().size(), 82u);
+    EXPECT_EQ(fe.Spans().front().First, 1u);
+    ExpectMatchesFullParse(fe);
+}
+
+TEST(IncrementalTest, RemovedDefinitionReportsLaterUses) {
+    std::string src = "x = 1\n" + Numbered(2000) + "print(x)\n";
+    IncrementalFrontEnd fe(src);
+    ASSERT_TRUE(fe.Valid());
+    EXPECT_FALSE(fe.Apply({1, 1, ""}));
+    EXPECT_NE(fe.Errors().find("Undefined variable: x"), std::string::npos);
+    ExpectMatchesFullParse(fe);
+    EXPECT_TRUE(fe.Apply({1, 0, "x = 2"}));
+    ExpectMatchesFullParse(fe);
+}
+
+TEST(IncrementalTest, ChangedTypeReachesLaterStatements) {
+    IncrementalFrontEnd fe("s = 1\n" + Numbered(600) + "t = -s\n");
+    ASSERT_TRUE(fe.Valid());
+    EXPECT_FALSE(fe.Apply({1, 1, "s = \"text\""}));
+    EXPECT_NE(fe.Errors().find("Type error"), std::string::npos);
+    ExpectMatchesFullParse(fe);
+}
+
+TEST(IncrementalTest, EditContinuingPreviousStatement) {
+    IncrementalFrontEnd fe("x = 1\n\ny = 2\nz = 3\n");
+    fe.Apply({2, 2, "- x"});
+    EXPECT_EQ(fe.Program().size(), 3u);
+    EXPECT_EQ(fe.Spans()[0].Last, 2u);
+    ExpectMatchesFullParse(fe);
+}
+
+TEST(IncrementalTest, OpenBlockSwallowsFollowingStatements) {
+    IncrementalFrontEnd fe(Numbered(50));
+    EXPECT_FALSE(fe.Apply({10, 9, "while false"}));
+    EXPECT_FALSE(fe.Errors().empty());
+    EXPECT_TRUE(fe.Apply({30, 29, "end while"}));
+    EXPECT_EQ(fe.Program().size(), 32u);
+    ExpectMatchesFullParse(fe);
+    fe.Apply({20, 20, "v18 = v17 * 2"});
+    ExpectMatchesFullParse(fe);
+}
+
+TEST(IncrementalTest, RebindingBuiltinReanalysesEverything) {
+    IncrementalFrontEnd fe(Numbered(300) + "n = len(\"abc\") + 1\n");
+    ASSERT_TRUE(fe.Valid());
+    fe.Apply({1, 0, "len = function(s) return \"x\" end function"});
+    EXPECT_EQ(fe.LastStats().Reanalysed, fe.Program().size());
+    ExpectMatchesFullParse(fe);
+}
+
+TEST(IncrementalTest, EditOutOfRangeThrows) {
+    IncrementalFrontEnd fe("x = 1\n");
+    EXPECT_THROW(fe.Apply({3, 3, "y = 2"}), std::runtime_error);
+    EXPECT_THROW(fe.Apply({0, 0, "y = 2"}), std::runtime_error);
+}
@@ -52,7 +52,8 @@ TEST(Interpreter, ListIndex) {
 }
 TEST(Interpreter, Slice) {
     std::string o;
-    EXPECT_FALSE(run("s=\"abcde\"\nprint(s[1:4])", o));
+    EXPECT_TRUE(run("s=\"abcde\"\nprint(s[1:4])", o));
+    EXPECT_EQ(o, "bcd");
 }
 TEST(Interpreter, Function) {
     std::string o;
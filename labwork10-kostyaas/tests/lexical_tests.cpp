@@ -128,6 +128,13 @@ TEST(Lexer, Comma) {
     LexicalAnalyser lex(in);
     EXPECT_EQ(lex.Next().type, TokenType::Comma);
 }
+TEST(Lexer, BracesAndColon) {
+    std::istringstream in("{:}");
+    LexicalAnalyser lex(in);
+    EXPECT_EQ(lex.Next().type, TokenType::LBrace);
+    EXPECT_EQ(lex.Next().type, TokenType::Colon);
+    EXPECT_EQ(lex.Next().type, TokenType::RBrace);
+}
 TEST(Lexer, SkipWhitespace) {
     std::istringstream in("   \n\tfoo");
     LexicalAnalyser lex(in);
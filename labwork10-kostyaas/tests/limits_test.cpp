@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include "Interpreter.h"
+
+namespace {
+
+bool run(const std::string& code, const ExecutionLimits& limits, ExecutionStats& stats) {
+    std::istringstream in(code);
+    std::ostringstream out;
+    return Interpreter::Interpret(in, out, limits, &stats);
+}
+
+}
+
+TEST(LimitsTestSuite, StepBudgetStopsInfiniteLoop) {
+    ExecutionLimits limits;
+    limits.MaxSteps = 10000;
+    ExecutionStats stats;
+    ASSERT_FALSE(run("i = 0\nwhile true\ni = i + 1\nend while", limits, stats));
+    ASSERT_TRUE(stats.Aborted);
+    ASSERT_EQ(stats.Steps, 10000u);
+}
+
+TEST(LimitsTestSuite, StepBudgetCountsCalls) {
+    ExecutionLimits limits;
+    limits.MaxSteps = 500;
+    ExecutionStats stats;
+    ASSERT_FALSE(run("f = function(n) return f(n + 1) end function\nf(0)", limits, stats));
+    ASSERT_TRUE(stats.Aborted);
+}
+
+TEST(LimitsTestSuite, DeadlineStopsInfiniteLoop) {
+    ExecutionLimits limits;
+    limits.Deadline = std::chrono::milliseconds(50);
+    ExecutionStats stats;
+    ASSERT_FALSE(run("while true\nend while", limits, stats));
+    ASSERT_TRUE(stats.Aborted);
+    ASSERT_GE(stats.Elapsed, std::chrono::milliseconds(50));
+    ASSERT_LT(stats.Elapsed, std::chrono::seconds(5));
+}
+
+TEST(LimitsTestSuite, HeapCapStopsLargeRange) {
+    ExecutionLimits limits;
+    limits.MaxAllocationBytes = 1 << 20;
+    ExecutionStats stats;
+    ASSERT_FALSE(run("r = range(1000000000)", limits, stats));
+    ASSERT_TRUE(stats.Aborted);
+}
+
+TEST(LimitsTestSuite, HeapCapStopsStringGrowth) {
+    ExecutionLimits limits;
+    limits.MaxAllocationBytes = 1 << 20;
+    ExecutionStats stats;
+    ASSERT_FALSE(run("s = \"ab\"\nwhile true\ns = s + s\nend while", limits, stats));
+    ASSERT_TRUE(stats.Aborted);
+    ASSERT_FALSE(run("s = \"ab\" * 10000000", limits, stats));
+    ASSERT_TRUE(stats.Aborted);
+}
+
+TEST(LimitsTestSuite, AllocationCapChargesListElementsBySize) {
+    ExecutionLimits limits;
+    limits.MaxAllocationBytes = 1 << 20;
+    ExecutionStats stats;
+    ASSERT_FALSE(run("a = split(\"x\" * 49999, \"\")\nb = a + a", limits, stats));
+    ASSERT_TRUE(stats.Aborted);
+}
+
+TEST(LimitsTestSuite, StatsWithinLimits) {
+    ExecutionLimits limits;
+    limits.MaxSteps = 1000;
+    limits.Deadline = std::chrono::seconds(10);
+    limits.MaxAllocationBytes = 1 << 20;
+    ExecutionStats stats;
+    ASSERT_TRUE(run("s = \"\"\nfor i in range(100)\ns = s + \"x\"\nend for", limits, stats));
+    ASSERT_FALSE(stats.Aborted);
+    ASSERT_GE(stats.Steps, 100u);
+    ASSERT_EQ(stats.LargestAllocation, 100u);
+}
@@ -0,0 +1,103 @@
+#include <lib/Interpreter/Interpreter.h>
+#include <gtest/gtest.h>
+
+
+TEST(MapTestSuite, LiteralAndIndexTest) {
+    std::string code = R"(
+        m = {"one": 1, "two": 2, 3: "three"}
+        print(m["two"])
+        print(m[3])
+        print(m["none"])
+        print(len(m))
+    )";
+
+    std::string expected = "2threenil3";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+
+TEST(MapTestSuite, AssignAndIterateTest) {
+    std::string code = R"(
+        counts = {}
+        for w in ["a", "b", "a", "c", "a"]
+            if has(counts, w) then
+                counts[w] = counts[w] + 1
+            else
+                counts[w] = 1
+            end if
+        end for
+
+        for k in counts
+            print(k)
+            print(counts[k])
+        end for
+        print(keys(counts))
+        print(values(counts))
+    )";
+
+    std::string expected = "a3b1c1[\"a\", \"b\", \"c\"][3, 1, 1]";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+
+TEST(MapTestSuite, EqualityAndPrintTest) {
+    std::string code = R"(
+        a = {"x": [1, 2], "y": true}
+        b = {"y": true, "x": [1, 2]}
+        print(a == b)
+        b["y"] = false
+        print(a == b)
+        print(a)
+    )";
+
+    std::string expected = "truefalse{\"x\": [1, 2], \"y\": true}";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+
+TEST(MapTestSuite, GrowthTest) {
+    std::string code = R"(
+        m = {}
+        for i in range(1000)
+            m[i] = i * 2
+        end for
+        print(len(m))
+        print(m[999])
+    )";
+
+    std::string expected = "10001998";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+
+TEST(MapTestSuite, UnhashableKeyTest) {
+    std::string code = R"(
+        m = {[1]: 2}
+        print(239)
+    )";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_FALSE(Interpreter(input, output));
+}
@@ -0,0 +1,114 @@
+#include <lib/Interpreter/Interpreter.h>
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+std::string WriteModule(const std::string& name, const std::string& code) {
+    std::string path = testing::TempDir() + "itmoscript_" + name;
+    std::ofstream(path) << code;
+    return path;
+}
+
+bool RunScript(const std::string& code, std::string& out) {
+    std::istringstream input(code);
+    std::ostringstream output;
+    bool ok = Interpreter(input, output);
+    out = output.str();
+    return ok;
+}
+
+}
+
+TEST(ModuleTestSuite, ImportExposesNamespaceTest) {
+    std::string path = WriteModule("math.is", R"(
+        square = function(x) return x * x end function
+        total = 0
+        for i in range(5)
+            total = total + square(i)
+        end for
+    )");
+    std::string out;
+    ASSERT_TRUE(RunScript(
+        "m = import \"" + path + "\"\n"
+        "print(m[\"square\"](7))\n"
+        "print(m[\"total\"])\n"
+        "print(keys(m))", out));
+    ASSERT_EQ(out, "4930[\"square\", \"total\"]");
+}
+
+TEST(ModuleTestSuite, CompiledOncePerProcessTest) {
+    std::string path = WriteModule("cached.is", "answer = 42");
+    std::string code = "print(import \"" + path + "\"[\"answer\"])";
+    std::string out;
+    ASSERT_TRUE(RunScript(code, out));
+    size_t compiled = ModuleCache::Instance().Compilations();
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(RunScript(code, out));
+        ASSERT_EQ(out, "42");
+    }
+    ASSERT_EQ(ModuleCache::Instance().Compilations(), compiled);
+
+    WriteModule("cached.is", "answer = 43");
+    std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(5));
+    ASSERT_TRUE(RunScript(code, out));
+    ASSERT_EQ(out, "43");
+    ASSERT_EQ(ModuleCache::Instance().Compilations(), compiled + 1);
+}
+
+TEST(ModuleTestSuite, NestedAndRepeatedImportsTest) {
+    std::string base = WriteModule("base.is", "counter = 0\nname = \"base\"");
+    std::string mid = WriteModule("mid.is",
+        "b = import \"" + base + "\"\n"
+        "greet = function() return \"from \" + b[\"name\"] end function");
+    std::string out;
+    ASSERT_TRUE(RunScript(
+        "m = import \"" + mid + "\"\n"
+        "b = import \"" + base + "\"\n"
+        "b[\"counter\"] = 5\n"
+        "print(m[\"greet\"]())\n"
+        "print(m[\"b\"][\"counter\"])", out));
+    ASSERT_EQ(out, "\"from base\"5");
+}
+
+TEST(ModuleTestSuite, ImportErrorsTest) {
+    std::string out;
+    ASSERT_FALSE(RunScript("m = import \"" + testing::TempDir() + "itmoscript_none.is\"", out));
+
+    std::string bad = WriteModule("bad.is", "x = undefined_name + 1");
+    ASSERT_FALSE(RunScript("m = import \"" + bad + "\"", out));
+
+    std::string a = testing::TempDir() + "itmoscript_cycle_a.is";
+    std::string b = WriteModule("cycle_b.is", "a = import \"" + a + "\"");
+    WriteModule("cycle_a.is", "b = import \"" + b + "\"");
+    ASSERT_FALSE(RunScript("m = import \"" + a + "\"", out));
+}
+
+
+TEST(ModuleTestSuite, RecompiledModuleKeepsItsSlotsTest) {
+    auto version = [](int n) {
+        return "total = 0\n"
+               "base = [1, 2, 3]\n"
+               "for i in range(3)\n"
+               "    total = total + len(base) * " + std::to_string(n) + "\n"
+               "end for";
+    };
+    std::string path = WriteModule("slots.is", version(1));
+    std::string code = "print(import \"" + path + "\"[\"total\"])";
+    std::string out;
+    ASSERT_TRUE(RunScript(code, out));
+    ASSERT_EQ(out, "9");
+    auto first = ModuleCache::Instance().Load(path);
+    ASSERT_LT(first->FirstSlot, first->SlotEnd);
+
+    for (int n = 2; n < 6; ++n) {
+        WriteModule("slots.is", version(n));
+        std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(5));
+        ASSERT_TRUE(RunScript(code, out));
+        ASSERT_EQ(out, std::to_string(9 * n));
+        auto module = ModuleCache::Instance().Load(path);
+        ASSERT_EQ(module->FirstSlot, first->FirstSlot);
+        ASSERT_EQ(module->SlotEnd, first->SlotEnd);
+    }
+}
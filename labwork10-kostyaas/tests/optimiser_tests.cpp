@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include "syntactic_analyser/SyntacticAnalyser.h"
+#include "optimiser/LoopOptimiser.h"
+#include "Interpreter.h"
+
+std::vector<std::string> optimise(const std::string& src) {
+    std::istringstream in(src);
+    auto ast = SyntacticAnalyser(in).Parse();
+    LoopOptimiser opt;
+    opt.Optimise(ast);
+    return opt.Report();
+}
+
+std::string execute(const std::string& src) {
+    std::istringstream in(src);
+    std::ostringstream out;
+    EXPECT_TRUE(Interpreter(in, out));
+    return out.str();
+}
+
+TEST(LoopOptimiser, CountedWhile) {
+    auto r = optimise("i=0\nwhile i < 10\nprint(i)\ni = i + 1\nend while");
+    ASSERT_EQ(r.size(), 1u);
+    EXPECT_EQ(r[0], "loop #1 (while): counted on i, hoisted 0");
+}
+TEST(LoopOptimiser, HoistsInvariantCondition) {
+    auto r = optimise("a=[1,2,3]\ni=0\nwhile i < len(a) - 1\ni = i + 1\nend while");
+    ASSERT_EQ(r.size(), 1u);
+    EXPECT_EQ(r[0], "loop #1 (while): counted on i, hoisted 1");
+}
+TEST(LoopOptimiser, HoistsForBody) {
+    auto r = optimise("n=5\nfor x in range(3)\nprint(x * (n - 1))\nend for");
+    ASSERT_EQ(r.size(), 1u);
+    EXPECT_EQ(r[0], "loop #1 (for x): hoisted 1");
+}
+TEST(LoopOptimiser, ReportKeptOnCompiledScript) {
+    std::istringstream in("n=5\nfor x in range(3)\nprint(x * (n - 1))\nend for");
+    auto script = Interpreter::Compile(in);
+    ASSERT_EQ(script->OptimiserReport.size(), 1u);
+    EXPECT_EQ(script->OptimiserReport[0], "loop #1 (for x): hoisted 1");
+}
+TEST(LoopOptimiser, GeneratorIterableBlocksHoisting) {
+    std::string src = "m={}\ng=function()\nfor i in range(3)\nm[i]=i\nyield i\nend for\nend function\n"
+                      "for x in g()\nprint(len(m))\nend for";
+    EXPECT_EQ(execute(src), "123");
+    EXPECT_TRUE(optimise(src).empty());
+    EXPECT_TRUE(optimise("m={}\nit=[1,2]\nfor x in it\nprint(len(m))\nend for").empty());
+}
+TEST(LoopOptimiser, NestedGeneratorLoopBlocksHoisting) {
+    std::string src = "n=3\ng=function()\nn=6\nyield 1\nend function\ngens=[g()]\ni=0\n"
+                      "while i < 1\nfor x in gens[i]\nprint(n * 10)\nend for\ni = i + 1\nend while";
+    EXPECT_EQ(execute(src), "60");
+    EXPECT_TRUE(optimise(src).empty());
+}
+TEST(LoopOptimiser, UserCallBlocksTransform) {
+    auto r = optimise("f=function() end function\ni=0\nwhile i < 10\nf()\ni = i + 1\nend while");
+    EXPECT_TRUE(r.empty());
+}
+TEST(LoopOptimiser, SecondCounterWriteBlocksCounted) {
+    auto r = optimise("i=0\nwhile i < 10\ni = i + 2\ni = i + 1\nend while");
+    EXPECT_TRUE(r.empty());
+}
+TEST(LoopOptimiser, RebuiltBuiltinNotHoisted) {
+    auto r = optimise("len=function(x) return 1 end function\nfor x in range(3)\nprint(len(x) + 1)\nend for");
+    EXPECT_TRUE(r.empty());
+}
+TEST(LoopOptimiser, CountedDownAndInclusive) {
+    EXPECT_EQ(execute("i=5\nwhile i >= 1\nprint(i)\ni = i - 2\nend while\nprint(i)"), "531-1");
+}
+TEST(LoopOptimiser, CountedWithDoubleFallsBack) {
+    EXPECT_EQ(execute("i=0.5\nwhile i < 3\nprint(i)\ni = i + 1\nend while"), "0.51.52.5");
+}
+TEST(LoopOptimiser, HoistedReevaluatedPerEntry) {
+    EXPECT_EQ(execute(
+        "f=function(a)\n"
+        "  s=0\n"
+        "  i=0\n"
+        "  while i < len(a)\n"
+        "    s = s + len(a) * 10\n"
+        "    i = i + 1\n"
+        "  end while\n"
+        "  return s\n"
+        "end function\n"
+        "print(f([1]))\nprint(f([1,2,3]))"), "1090");
+}
+TEST(LoopOptimiser, RecursionKeepsOuterCache) {
+    EXPECT_EQ(execute(
+        "g=function(n)\n"
+        "  t=0\n"
+        "  for x in range(2)\n"
+        "    t = t + n * 100\n"
+        "    if n > 0 then t = t + g(n - 1) end if\n"
+        "  end for\n"
+        "  return t\n"
+        "end function\n"
+        "print(g(1))"), "200");
+}
+TEST(LoopOptimiser, YieldBlocksTransform) {
+    auto r = optimise("g=function(n)\ni=0\nwhile i < n * 2\nyield i\ni = i + 1\nend while\nend function");
+    EXPECT_TRUE(r.empty());
+}
+
+const FunctionExpression& literal(std::vector<Statement>& ast) {
+    auto& e = std::get<ExpressionStatement>(ast[0].Value).Expression;
+    return std::get<FunctionExpression>(std::get<AssignExpression>(e.Value).Rhs->Value);
+}
+
+TEST(LoopOptimiser, MarksPureFunctions) {
+    std::istringstream in("f = function(x) s = 0\nfor i in range(x)\ns = s + len(\"ab\")\nend for\nreturn g(s) end function");
+    auto ast = SyntacticAnalyser(in).Parse();
+    LoopOptimiser().Optimise(ast);
+    auto& f = literal(ast);
+    EXPECT_TRUE(f.Pure);
+    EXPECT_EQ(f.Calls, std::vector<std::string>{"g"});
+    EXPECT_EQ(f.Locals, std::vector<std::string>{"s"});
+}
+TEST(LoopOptimiser, OutputIsLeftToRuntimeCheck) {
+    std::istringstream in("f = function(x) print(x) end function");
+    auto ast = SyntacticAnalyser(in).Parse();
+    LoopOptimiser().Optimise(ast);
+    EXPECT_EQ(literal(ast).Calls, std::vector<std::string>{"print"});
+}
+TEST(LoopOptimiser, YieldAndOpaqueCallsAreImpure) {
+    for (const char* src : {"f = function(x) yield x end function",
+                            "f = function(x) return x(1) end function",
+                            "f = function(m) m[\"k\"] = 1 end function"}) {
+        std::istringstream in(src);
+        auto ast = SyntacticAnalyser(in).Parse();
+        LoopOptimiser().Optimise(ast);
+        EXPECT_FALSE(literal(ast).Pure) << src;
+    }
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "Interpreter.h"
+
+TEST(PackedList, NumbersStayPacked) {
+    PackedList l;
+    for (int i = 0; i < 5; ++i) l.Push(static_cast<double>(i));
+    EXPECT_EQ(l.GetShape(), PackedList::Shape::Number);
+    ASSERT_NE(l.GetNumbers(), nullptr);
+    EXPECT_EQ(l.size(), 5u);
+    EXPECT_EQ(std::get<double>(l.At(3).data), 3.0);
+}
+TEST(PackedList, StringsStayPacked) {
+    PackedList l;
+    l.Push(Value(std::string("a")));
+    l.Push(Value(std::string("b")));
+    EXPECT_EQ(l.GetShape(), PackedList::Shape::String);
+    EXPECT_EQ(std::get<std::string>(l.At(1).data), "b");
+}
+TEST(PackedList, MismatchUpgrades) {
+    PackedList l;
+    l.Push(1.0);
+    l.Push(Value(std::string("x")));
+    EXPECT_EQ(l.GetShape(), PackedList::Shape::Generic);
+    EXPECT_EQ(std::get<double>(l.At(0).data), 1.0);
+    EXPECT_EQ(std::get<std::string>(l.At(1).data), "x");
+}
+TEST(PackedList, SetMismatchUpgrades) {
+    PackedList l;
+    l.Push(1.0);
+    l.Push(2.0);
+    l.Set(1, Value(true));
+    EXPECT_EQ(l.GetShape(), PackedList::Shape::Generic);
+    EXPECT_TRUE(std::get<bool>(l.At(1).data));
+}
+TEST(PackedList, SliceKeepsShape) {
+    PackedList l;
+    for (int i = 0; i < 10; ++i) l.Push(static_cast<double>(i));
+    PackedList s = l.Slice(2, 5);
+    EXPECT_EQ(s.GetShape(), PackedList::Shape::Number);
+    EXPECT_EQ(s.size(), 3u);
+    EXPECT_EQ(std::get<double>(s.At(0).data), 2.0);
+}
+TEST(PackedList, AppendMixed) {
+    PackedList a, b;
+    a.Push(1.0);
+    b.Push(Value(std::string("s")));
+    a.Append(b);
+    EXPECT_EQ(a.GetShape(), PackedList::Shape::Generic);
+    EXPECT_EQ(a.size(), 2u);
+}
+TEST(PackedList, ScriptRangeAndConcat) {
+    std::istringstream in("a = range(3) + [\"x\"]\nfor v in a\nprint(v)\nend for\nprint(len(a))");
+    std::ostringstream out;
+    EXPECT_TRUE(Interpreter(in, out));
+    EXPECT_EQ(out.str(), "012x4");
+}
+TEST(PackedList, CopiesShareUntilWritten) {
+    PackedList a;
+    for (int64_t i = 0; i < 4; ++i) a.Push(i);
+    PackedList b = a;
+    EXPECT_TRUE(b.Shares(a));
+    b.Set(0, Value(int64_t{9}));
+    EXPECT_FALSE(b.Shares(a));
+    EXPECT_EQ(std::get<int64_t>(a.At(0).data), 0);
+    EXPECT_EQ(std::get<int64_t>(b.At(0).data), 9);
+    PackedList c = a;
+    c.Push(Value(std::string("x")));
+    EXPECT_EQ(a.GetShape(), PackedList::Shape::Integer);
+    EXPECT_EQ(c.GetShape(), PackedList::Shape::Generic);
+    EXPECT_EQ(a.size(), 4u);
+}
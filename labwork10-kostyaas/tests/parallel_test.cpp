@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include "Interpreter.h"
+
+namespace {
+
+std::string RunScript(const std::string& code, ExecutionStats* stats = nullptr) {
+    std::istringstream in(code);
+    std::ostringstream out;
+    EXPECT_TRUE(Interpreter::Interpret(in, out, {}, stats));
+    return out.str();
+}
+
+}
+
+TEST(ParallelTestSuite, PmapKeepsOrder) {
+    std::string code = R"(
+        xs = []
+        for i in range(2000)
+            xs = xs + [i]
+        end for
+        sq = function(x) return x * x end function
+        ys = pmap(xs, sq)
+        print([len(ys), ys[0] + ys[1999], ys[1234]])
+    )";
+    ASSERT_EQ(RunScript(code), "[2000, 3996001, 1522756]");
+}
+
+TEST(ParallelTestSuite, PfilterKeepsOrder) {
+    std::string code = R"(
+        xs = []
+        for i in range(1000)
+            xs = xs + [i]
+        end for
+        odd = pfilter(xs, function(x) return x % 2 == 1 end function)
+        print([len(odd), odd[0], odd[499]])
+    )";
+    ASSERT_EQ(RunScript(code), "[500, 1, 999]");
+}
+
+TEST(ParallelTestSuite, PreduceMatchesFold) {
+    std::string code = R"(
+        xs = []
+        for i in range(5000)
+            xs = xs + [i]
+        end for
+        add = function(a, b) return a + b end function
+        print([preduce(xs, add, 0), preduce([], add, 7)])
+    )";
+    ASSERT_EQ(RunScript(code), "[12497500, 7]");
+}
+
+
+TEST(ParallelTestSuite, PreduceWithAccumulatorOfAnotherType) {
+    std::string code = R"(
+        words = []
+        for i in range(1000)
+            words = words + ["ab"]
+        end for
+        count = function(acc, s) return acc + len(s) end function
+        add = function(a, b) return a + b end function
+        print([preduce(words[0:100], count, 0), preduce(words, count, 0), preduce(words, count, 0, add)])
+    )";
+    ASSERT_EQ(RunScript(code), "[200, 2000, 2000]");
+}
+
+TEST(ParallelTestSuite, CallsHelperFunctions) {
+    std::string code = R"(
+        fib = function(n)
+            if n < 2 then return n end if
+            return fib(n - 1) + fib(n - 2)
+        end function
+        xs = []
+        for i in range(600)
+            xs = xs + [i % 12]
+        end for
+        ys = pmap(xs, function(n) return fib(n) end function)
+        add = function(a, b) return a + b end function
+        print(preduce(ys, add, 0, add))
+    )";
+    ASSERT_EQ(RunScript(code), "11600");
+}
+
+TEST(ParallelTestSuite, ImpureFunctionRunsSequentially) {
+    std::string code = R"(
+        count = 0
+        xs = []
+        for i in range(600)
+            xs = xs + [i]
+        end for
+        ys = pmap(xs, function(x)
+            count = count + 1
+            return count
+        end function)
+        print([count, ys[599]])
+    )";
+    ASSERT_EQ(RunScript(code), "[600, 600]");
+}
+
+TEST(ParallelTestSuite, WorkerErrorsReachCaller) {
+    std::istringstream in(R"(
+        xs = []
+        for i in range(1000)
+            xs = xs + [i]
+        end for
+        ys = pmap(xs, function(x) return len(x) end function)
+    )");
+    std::ostringstream out;
+    ASSERT_FALSE(Interpreter(in, out));
+}
+
+TEST(ParallelTestSuite, WorkerStepsCountTowardsBudget) {
+    std::string code = R"(
+        xs = []
+        for i in range(1000)
+            xs = xs + [i]
+        end for
+        ys = pmap(xs, function(x) return x end function)
+    )";
+    ExecutionStats stats;
+    RunScript(code, &stats);
+    EXPECT_GE(stats.Steps, 2000u);
+
+    std::istringstream in(code);
+    std::ostringstream out;
+    ExecutionLimits limits;
+    limits.MaxSteps = 1500;
+    ASSERT_FALSE(Interpreter::Interpret(in, out, limits, &stats));
+    EXPECT_TRUE(stats.Aborted);
+}
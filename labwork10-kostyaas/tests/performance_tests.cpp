@@ -136,4 +136,52 @@ PERF_TEST(CombinedStress, {
     std::istringstream in(script);
     std::ostringstream out;
     Interpreter::Interpret(in, out);
-})
\ No newline at end of file
+})
+
+namespace {
+
+long long TimeListReads(int size) {
+    std::string script =
+        "a=range(0," + std::to_string(size) + ")\n"
+        "n=len(a)\n"
+        "s=0\n"
+        "for i in range(0,20000)\n"
+        "  s=s+len(a)+a[i % n]\n"
+        "end for\n"
+        "print(s)";
+    std::istringstream in(script);
+    std::ostringstream out;
+    auto t0 = steady_clock::now();
+    EXPECT_TRUE(Interpreter::Interpret(in, out));
+    return duration_cast<milliseconds>(steady_clock::now() - t0).count();
+}
+
+}
+
+TEST(Performance, ListReadsIndependentOfSize) {
+    long long small = TimeListReads(1000);
+    long long large = TimeListReads(1000000);
+    std::cout << "ListReads 1k: " << small << " ms, 1M: " << large << " ms\n";
+    EXPECT_LT(large, small * 5 + 100);
+}
+
+namespace {
+
+long long TimeMapInserts(long long stride) {
+    std::string script = "m = {}\nfor i in range(0, 20000)\n m[i * " + std::to_string(stride) + "] = i\nend for\nprint(len(m))";
+    std::istringstream in(script);
+    std::ostringstream out;
+    auto t0 = steady_clock::now();
+    EXPECT_TRUE(Interpreter::Interpret(in, out));
+    EXPECT_EQ(out.str(), "20000");
+    return duration_cast<milliseconds>(steady_clock::now() - t0).count();
+}
+
+}
+
+TEST(Performance, MapInsertsIndependentOfKeyStride) {
+    long long dense = TimeMapInserts(1);
+    long long strided = TimeMapInserts(65536);
+    std::cout << "MapInserts stride 1: " << dense << " ms, stride 65536: " << strided << " ms\n";
+    EXPECT_LT(strided, dense * 5 + 100);
+}
@@ -34,4 +34,24 @@ TEST(Semantic, ComplexSem)    { EXPECT_TRUE(analyze(
     "  return nil\n"
     "end function\n"
     "print(f(x))"
-)); }
\ No newline at end of file
+)); }
+TEST(SemanticTypes, StringMinusNil)  { EXPECT_FALSE(analyze("print(\"a\" - nil)")); }
+TEST(SemanticTypes, NegateString)    { EXPECT_FALSE(analyze("x=\"a\"\nprint(-x)")); }
+TEST(SemanticTypes, ListTimesNumber) { EXPECT_FALSE(analyze("x=[1]*2")); }
+TEST(SemanticTypes, ValidArithmetic) { EXPECT_TRUE(analyze("x=1\ny=x*2+len(\"ab\")\ns=\"a\"*y")); }
+TEST(SemanticTypes, BranchJoin)      { EXPECT_TRUE(analyze("x=1\nif true then x=\"a\" end if\nprint(x-1)")); }
+TEST(SemanticTypes, LoopJoin)        { EXPECT_TRUE(analyze("x=1\nwhile true\nprint(x-1)\nx=\"s\"\nend while")); }
+TEST(SemanticTypes, CallForgets)     { EXPECT_TRUE(analyze("x=1\nf=function() x=\"a\" end function\nf()\nprint(x-\"b\")")); }
+TEST(SemanticTypes, ReboundNative)   { EXPECT_TRUE(analyze("len=function(a) return \"s\" end function\nprint(len(1)-\"s\")")); }
+TEST(SemanticTypes, Annotates) {
+    std::istringstream in("x=1.5\nfor i in range(3) y=x*i end for");
+    auto ast = SyntacticAnalyser(in).Parse();
+    std::ostringstream errs;
+    ASSERT_TRUE(SemanticAnalyser(errs).Analyse(ast));
+    auto& loop = std::get<ForStatement>(ast[1].Value);
+    auto& assign = std::get<AssignExpression>(std::get<ExpressionStatement>(loop.Body[0].Value).Expression.Value);
+    EXPECT_EQ(assign.Rhs->Type, StaticType::Number);
+}
+
+TEST(SemanticError, YieldOutsideFunction) { EXPECT_FALSE(analyze("yield 1")); }
+TEST(Semantic, YieldInFunction)          { EXPECT_TRUE(analyze("g=function(n) yield n end function")); }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <lib/Interpreter/Interpreter.h>
+#include <gtest/gtest.h>
+
+
+TEST(StringFunctionsTestSuite, SplitJoinTest) {
+    std::string code = R"(
+        parts = split("a,b,,c", ",")
+        print(len(parts))
+        print(join(parts, "-"))
+        print(join(split("abc", ""), "."))
+    )";
+
+    std::string expected = "4a-b--ca.b.c";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+
+TEST(StringFunctionsTestSuite, FindReplaceTest) {
+    std::string code = R"(
+        s = "the cat sat on the mat"
+        print(find(s, "at"))
+        print(find(s, "dog"))
+        print(replace(s, "the", "a"))
+    )";
+
+    std::string expected = "5-1\"a cat sat on a mat\"";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+
+TEST(StringFunctionsTestSuite, CaseStripStartsWithTest) {
+    std::string code = R"(
+        print(upper("Hello1"))
+        print(lower("WoRLD"))
+        print(strip("  \tpadded\n "))
+        print(startswith("prefix_rest", "prefix"))
+        print(startswith("pre", "prefix"))
+    )";
+
+    std::string expected = "HELLO1worldpaddedtruefalse";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+
+TEST(StringFunctionsTestSuite, JoinNonStringTest) {
+    std::string code = R"(
+        print(join([1, 2], ","))
+    )";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_FALSE(Interpreter(input, output));
+}
+
+
+TEST(StringFunctionsTestSuite, JoinGenericListOfStringsTest) {
+    std::string code = R"(
+        a = [1, "b"]
+        a[0] = "a"
+        print(join(a, ","))
+    )";
+
+    std::string expected = "a,b";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
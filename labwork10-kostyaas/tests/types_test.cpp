@@ -18,3 +18,72 @@ TEST(TypesTestSuite, IntTest) {
     ASSERT_TRUE(Interpreter(input, output));
     ASSERT_EQ(output.str(), expected);
 }
+
+
+TEST(TypesTestSuite, IntegerArithmeticTest) {
+    std::string code = R"(
+        print(7 / 2)
+        print(";")
+        print(6 / 3)
+        print(";")
+        print(-7 % 3)
+        print(";")
+        print(2 ^ 10)
+        print(";")
+        print(1 == 1.0)
+        print(";")
+        print(0.5 + 1)
+    )";
+
+    std::string expected = "3.5;2;-1;1024;true;1.5";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+
+TEST(TypesTestSuite, IntegerOverflowPromotesTest) {
+    std::string code = R"(
+        big = 9007199254740992
+        print(big + 1 == big)
+        print(";")
+        print(big * big > big)
+        m = {1: "int"}
+        print(";")
+        print(m[1.0])
+    )";
+
+    std::string expected = "true;true;int";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
+
+
+TEST(TypesTestSuite, GeneratorInVariableForgetsTypesTest) {
+    std::string code = R"(
+        gen = function()
+            n = "a"
+            yield 1
+        end function
+        g = gen()
+        n = 1
+        for x in g
+            print(n + n)
+        end for
+    )";
+
+    std::string expected = "aa";
+
+    std::istringstream input(code);
+    std::ostringstream output;
+
+    ASSERT_TRUE(Interpreter(input, output));
+    ASSERT_EQ(output.str(), expected);
+}
@@ -12,8 +12,251 @@
 #include <utility>
 #include <unordered_map>
 #include <vector>
+#include <array>
+#include <memory>
+#include <functional>
+#include <tuple>
+#include <sstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
+#include <stdexcept>
+#include <algorithm>
+#include <string_view>
+#include <bit>
+#include <cstdint>
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define PROCESSING_HAS_MMAP 1
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PROCESSING_HAS_SSE2 1
+#endif
 namespace fs = std::filesystem;
 
+// The range a view reads from. An lvalue range is referred to and must
+// outlive the view; an rvalue range, usually the view of the previous
+// stage, is moved in. Composing a pipeline therefore moves each stage into
+// the next one and never copies a container or its elements.
+template <typename Range>
+class Upstream
+{
+public:
+	explicit Upstream(Range &&range) : range(std::move(range)) {}
+
+	Range &get() const { return range; }
+
+private:
+	// Views are single-pass like the streams they read, so iterating a
+	// const view still advances the state it owns.
+	mutable Range range;
+};
+
+template <typename Range>
+class Upstream<Range &>
+{
+public:
+	explicit Upstream(Range &range) : range(&range) {}
+
+	Range &get() const { return *range; }
+
+private:
+	Range *range;
+};
+
+// Calls `func` with a pipeline item, or with an owning copy of it when the
+// item is a token viewing a mapped file (see MapFiles) and `func` only
+// takes a std::string, e.g. to modify it.
+template <typename FUNC, typename Item>
+decltype(auto) invoke_token(FUNC &&func, Item &&item)
+{
+	if constexpr (std::is_invocable_v<FUNC, Item>)
+		return std::invoke(std::forward<FUNC>(func), std::forward<Item>(item));
+	else
+		return std::invoke(std::forward<FUNC>(func), std::string(std::forward<Item>(item)));
+}
+
+template <typename FUNC, typename Item>
+using invoke_token_result_t = decltype(invoke_token(std::declval<FUNC>(), std::declval<Item>()));
+
+// A run of items passed between batched stages. The values belong to the
+// stage that produced them and stay valid until its next batch; a Filter
+// narrows a batch by listing the positions it keeps instead of copying.
+template <typename T>
+struct Batch
+{
+	using value_type = T;
+
+	const T *values = nullptr;
+	const std::uint32_t *selection = nullptr; // null when all of the first `count` values are kept
+	std::size_t count = 0;
+
+	std::size_t size() const { return count; }
+	std::size_t position(std::size_t i) const { return selection ? selection[i] : i; }
+	const T &operator[](std::size_t i) const { return values[position(i)]; }
+
+	// Calls f(position, value) for every item, with the selection test
+	// taken out of the loop.
+	template <typename F>
+	void for_each(F &&f) const
+	{
+		if (selection)
+			for (std::size_t i = 0; i < count; ++i)
+				f(selection[i], values[selection[i]]);
+		else
+			for (std::size_t i = 0; i < count; ++i)
+				f(static_cast<std::uint32_t>(i), values[i]);
+	}
+};
+
+// A view that can hand out its items a Batch at a time: next_batch returns
+// the next non-empty batch, or nothing at the end. Filter and Transform
+// keep the batches going; any other stage reads batched views item by
+// item through BatchIterator.
+template <typename Range>
+concept batched_range = requires(const std::remove_cvref_t<Range> &range) {
+	typename std::remove_cvref_t<Range>::batch_type;
+	range.next_batch();
+};
+
+template <typename View>
+class BatchIterator
+{
+public:
+	using batch_type = typename View::batch_type;
+	using value_type = typename batch_type::value_type;
+	using difference_type = std::ptrdiff_t;
+	using pointer = const value_type *;
+	using reference = const value_type &;
+	using iterator_category = std::input_iterator_tag;
+
+	BatchIterator() = default;
+	explicit BatchIterator(const View *view) : view(view) { batch = view->next_batch(); }
+
+	reference operator*() const { return (*batch)[index]; }
+	pointer operator->() const { return &**this; }
+
+	BatchIterator &operator++()
+	{
+		if (++index == batch->size())
+		{
+			batch = view->next_batch();
+			index = 0;
+		}
+		return *this;
+	}
+
+	bool operator==(const BatchIterator &other) const { return !batch == !other.batch; }
+	bool operator!=(const BatchIterator &other) const { return !(*this == other); }
+
+private:
+	const View *view = nullptr;
+	std::optional<batch_type> batch;
+	std::size_t index = 0;
+};
+
+// Calls `f` with every item of `range`, a batch at a time when the range
+// is batched and through its own loop when it has one.
+template <typename Range, typename F>
+void for_each_item(const Range &range, F &&f)
+{
+	if constexpr (batched_range<Range>)
+	{
+		while (auto batch = range.next_batch())
+			batch->for_each([&](std::uint32_t, const auto &item) { f(item); });
+	}
+	else if constexpr (requires { range.for_each(f); })
+	{
+		range.for_each(f);
+	}
+	else
+	{
+		for (const auto &item : range)
+			f(item);
+	}
+}
+
+// Starts batched execution: the stages after it exchange batches of up to
+// `size` items. The items of a contiguous container are passed in place,
+// those of any other range are copied into a buffer.
+class Batched
+{
+public:
+	static constexpr std::size_t DefaultSize = 1024;
+
+	explicit Batched(std::size_t size = DefaultSize) : size(size == 0 ? 1 : size) {}
+
+	template <typename Container>
+	class View
+	{
+		using Iter = decltype(std::begin(std::declval<Upstream<Container> &>().get()));
+		static constexpr bool contiguous = requires(std::remove_reference_t<Container> &c) {
+			{ std::data(c) } -> std::convertible_to<const std::remove_reference_t<decltype(*std::data(c))> *>;
+			std::size(c);
+		};
+
+	public:
+		using value_type = std::decay_t<decltype(*std::declval<Iter &>())>;
+		using batch_type = Batch<value_type>;
+
+		View(Upstream<Container> container, std::size_t size) : container(std::move(container)), size(size) {}
+
+		std::optional<batch_type> next_batch() const
+		{
+			if constexpr (contiguous)
+			{
+				std::size_t total = std::size(container.get());
+				if (offset >= total)
+					return std::nullopt;
+				std::size_t n = std::min(size, total - offset);
+				batch_type batch{std::data(container.get()) + offset, nullptr, n};
+				offset += n;
+				return batch;
+			}
+			else
+			{
+				if (!current)
+				{
+					current.emplace(std::begin(container.get()));
+					end_iter.emplace(std::end(container.get()));
+				}
+				buffer.clear();
+				for (; buffer.size() < size && *current != *end_iter; ++*current)
+					buffer.push_back(**current);
+				if (buffer.empty())
+					return std::nullopt;
+				return batch_type{buffer.data(), nullptr, buffer.size()};
+			}
+		}
+
+		BatchIterator<View> begin() const { return BatchIterator<View>(this); }
+		BatchIterator<View> end() const { return BatchIterator<View>(); }
+
+	private:
+		Upstream<Container> container;
+		std::size_t size;
+		mutable std::size_t offset = 0;
+		mutable std::optional<Iter> current, end_iter;
+		mutable std::vector<value_type> buffer;
+	};
+
+	template <typename Container>
+	View<Container> apply(Container &&container) const
+	{
+		return View<Container>(Upstream<Container>(std::forward<Container>(container)), size);
+	}
+
+private:
+	std::size_t size;
+};
+
 class Dir
 {
 public:
@@ -96,35 +339,129 @@ private:
 	bool recursive;
 };
 
-template <class FUNC>
-class Filter
+template <typename FUNC>
+struct FilterStep
 {
-public:
-	Filter(FUNC func) : func(func) {}
+	FUNC func;
+};
 
-	template <typename Iter>
+template <typename FUNC>
+struct TransformStep
+{
+	FUNC func;
+};
+
+template <typename Step>
+struct is_filter_step : std::false_type {};
+
+template <typename FUNC>
+struct is_filter_step<FilterStep<FUNC>> : std::true_type {};
+
+// What the step after `Step` is given when `Step` is given `Item`.
+template <typename Item, typename Step>
+struct fused_next
+{
+	using type = Item;
+};
+
+template <typename Item, typename FUNC>
+struct fused_next<Item, TransformStep<FUNC>>
+{
+	using type = const std::decay_t<invoke_token_result_t<const FUNC &, Item>> &;
+};
+
+// What the step at index N of `Steps` is given.
+template <typename Item, typename Steps, std::size_t N>
+struct fused_input
+{
+	using type = Item;
+};
+
+template <typename Item, typename Step, typename... Rest, std::size_t N>
+	requires(N > 0)
+struct fused_input<Item, std::tuple<Step, Rest...>, N>
+	: fused_input<typename fused_next<Item, Step>::type, std::tuple<Rest...>, N - 1> {};
+
+// Consecutive Filter and Transform stages run as one loop body over a
+// single source iterator. Positioning the iterator runs the steps up to
+// the last filter, each on the result of the previous one; the transforms
+// after it run on first dereference, so end iterators and items that are
+// only skipped over are never passed to them.
+template <typename Container, typename... Steps>
+class Fused
+{
+	using Source = decltype(std::begin(std::declval<Upstream<Container> &>().get()));
+	using Item = decltype(*std::declval<Source &>());
+
+	static constexpr std::size_t count = sizeof...(Steps);
+	static constexpr std::array<bool, count> filters{is_filter_step<Steps>::value...};
+	static constexpr std::size_t none = count;
+
+	// One past the last filter.
+	static constexpr std::size_t eager = [] {
+		std::size_t last = 0;
+		for (std::size_t i = 0; i < count; ++i)
+			if (filters[i])
+				last = i + 1;
+		return last;
+	}();
+
+	// The last transform before index `n`, whose result is the item at `n`.
+	static constexpr std::size_t result_before(std::size_t n)
+	{
+		for (std::size_t i = n; i-- > 0;)
+			if (!filters[i])
+				return i;
+		return none;
+	}
+
+	template <std::size_t I>
+	using step_t = std::tuple_element_t<I, std::tuple<Steps...>>;
+
+	template <std::size_t I>
+	using input_t = typename fused_input<Item, std::tuple<Steps...>, I>::type;
+
+	template <std::size_t I>
+	using slot_t = std::conditional_t<filters[I], std::monostate, std::optional<std::remove_cvref_t<input_t<I + 1>>>>;
+
+	template <std::size_t... I>
+	static std::tuple<slot_t<I>...> make_slots(std::index_sequence<I...>);
+
+	// The result of each transform, kept apart so that no step overwrites
+	// the item it was given.
+	using Slots = decltype(make_slots(std::make_index_sequence<count>{}));
+
+public:
 	class Iterator
 	{
 	public:
-		using value_type = typename std::iterator_traits<Iter>::value_type;
+		using reference = input_t<count>;
+		using value_type = std::remove_cvref_t<reference>;
 		using difference_type = std::ptrdiff_t;
 		using pointer = const value_type *;
-		using reference = const value_type &;
 		using iterator_category = std::input_iterator_tag;
 
-		Iterator(Iter current, Iter end, FUNC func)
-			: current(current), end(end), func(func)
+		Iterator(Source current, Source end, const std::tuple<Steps...> *steps)
+			: current(std::move(current)), end(std::move(end)), steps(steps)
 		{
 			skip_invalid();
 		}
 
 		reference operator*() const
 		{
-			return *current;
+			if constexpr (eager < count)
+			{
+				if (!ready)
+				{
+					finish<eager>(item_at<eager>());
+					ready = true;
+				}
+			}
+			return item_at<count>();
 		}
 		pointer operator->() const
 		{
-			return &(*current);
+			return &**this;
 		}
 
 		Iterator &operator++()
@@ -134,46 +471,188 @@ public:
 			return *this;
 		}
 
+		bool operator==(const Iterator &other) const
+		{
+			return !(current != other.current);
+		}
+
 		bool operator!=(const Iterator &other) const
 		{
 			return current != other.current;
 		}
 
 	private:
-		Iter current, end;
-		FUNC func;
+		Source current, end;
+		const std::tuple<Steps...> *steps;
+		mutable Slots slots;
+		mutable bool ready = false;
 
 		void skip_invalid()
 		{
-			while (current != end && !func(*current))
-			{
+			ready = false;
+			while (current != end && !pass<0>(*current))
 				++current;
+		}
+
+		// Runs the steps from I up to the last filter on `item`.
+		template <std::size_t I, typename T>
+		bool pass(T &&item) const
+		{
+			if constexpr (I == eager)
+				return true;
+			else if constexpr (filters[I])
+				return invoke_token(std::get<I>(*steps).func, item) && pass<I + 1>(std::forward<T>(item));
+			else
+			{
+				std::get<I>(slots).emplace(invoke_token(std::get<I>(*steps).func, std::forward<T>(item)));
+				return pass<I + 1>(*std::get<I>(slots));
 			}
 		}
+
+		// Runs the transforms after the last filter.
+		template <std::size_t I, typename T>
+		void finish(T &&item) const
+		{
+			std::get<I>(slots).emplace(invoke_token(std::get<I>(*steps).func, std::forward<T>(item)));
+			if constexpr (I + 1 < count)
+				finish<I + 1>(*std::get<I>(slots));
+		}
+
+		// The item the step at index N is given.
+		template <std::size_t N>
+		decltype(auto) item_at() const
+		{
+			constexpr std::size_t slot = result_before(N);
+			if constexpr (slot == none)
+				return *current;
+			else
+				return static_cast<input_t<N>>(*std::get<slot>(slots));
+		}
 	};
 
-	template <typename Container>
-	struct View
+	Fused(Upstream<Container> container, std::tuple<Steps...> steps)
+		: container(std::move(container)), steps(std::move(steps)) {}
+
+	Iterator begin() const
 	{
-		std::shared_ptr<Container> container;
-		FUNC func;
+		return Iterator(std::begin(container.get()), std::end(container.get()), &steps);
+	}
+	Iterator end() const
+	{
+		return Iterator(std::end(container.get()), std::end(container.get()), &steps);
+	}
 
-		auto begin() const
+	// Calls `f` with every item that passes, running all the steps inline
+	// in a single loop over the source.
+	template <typename F>
+	void for_each(F &&f) const
+	{
+		for (auto current = std::begin(container.get()), end = std::end(container.get()); current != end; ++current)
+			push<0>(*current, f);
+	}
+
+	// The same source with `step` run after the others.
+	template <typename Step>
+	Fused<Container, Steps..., Step> then(Step step) &&
+	{
+		return {std::move(container), std::tuple_cat(std::move(steps), std::tuple<Step>(std::move(step)))};
+	}
+
+private:
+	Upstream<Container> container;
+	std::tuple<Steps...> steps;
+
+	template <std::size_t I, typename T, typename F>
+	void push(T &&item, F &f) const
+	{
+		if constexpr (I == count)
+			f(std::forward<T>(item));
+		else if constexpr (filters[I])
 		{
-			return Iterator<decltype(std::begin(*container))>(
-				std::begin(*container), std::end(*container), func);
+			if (invoke_token(std::get<I>(steps).func, item))
+				push<I + 1>(std::forward<T>(item), f);
 		}
-		auto end() const
+		else
+			push<I + 1>(invoke_token(std::get<I>(steps).func, std::forward<T>(item)), f);
+	}
+};
+
+template <typename T>
+struct is_fused : std::false_type {};
+
+template <typename Container, typename... Steps>
+struct is_fused<Fused<Container, Steps...>> : std::true_type {};
+
+// The view that runs `step` on `container`: the batched view of the stage
+// for a batched range, the fused view otherwise. A fused view passed by
+// value takes the step as one more of its own instead of being wrapped.
+template <typename Step, typename Container>
+auto fuse(Container &&container, Step step)
+{
+	if constexpr (is_fused<Container>::value)
+		return std::move(container).then(std::move(step));
+	else
+		return Fused<Container, Step>(Upstream<Container>(std::forward<Container>(container)), std::tuple<Step>(std::move(step)));
+}
+
+template <class FUNC>
+class Filter
+{
+public:
+	Filter(FUNC func) : func(std::move(func)) {}
+
+	// Passes on the positions of the kept items of each batch.
+	template <typename Container>
+	class BatchView
+	{
+	public:
+		using batch_type = typename std::remove_cvref_t<Container>::batch_type;
+
+		BatchView(Upstream<Container> container, FUNC func) : container(std::move(container)), func(std::move(func)) {}
+
+		std::optional<batch_type> next_batch() const
 		{
-			return Iterator<decltype(std::begin(*container))>(
-				std::end(*container), std::end(*container), func);
+			while (auto batch = container.get().next_batch())
+			{
+				// Every position is written and only the kept ones are
+				// counted, so the loop has no branch on the predicate.
+				selected.resize(batch->size());
+				std::size_t kept = 0;
+				batch->for_each([&](std::uint32_t position, const auto &item) {
+					selected[kept] = position;
+					kept += static_cast<bool>(invoke_token(func, item));
+				});
+				if (kept != 0)
+					return batch_type{batch->values, selected.data(), kept};
+			}
+			return std::nullopt;
 		}
+
+		BatchIterator<BatchView> begin() const { return BatchIterator<BatchView>(this); }
+		BatchIterator<BatchView> end() const { return BatchIterator<BatchView>(); }
+
+	private:
+		Upstream<Container> container;
+		FUNC func;
+		mutable std::vector<std::uint32_t> selected;
 	};
 
 	template <typename Container>
-	View<Container> apply(const Container &container) const
+	auto apply(Container &&container) const &
+	{
+		if constexpr (batched_range<Container>)
+			return BatchView<Container>(Upstream<Container>(std::forward<Container>(container)), func);
+		else
+			return fuse(std::forward<Container>(container), FilterStep<FUNC>{func});
+	}
+
+	template <typename Container>
+	auto apply(Container &&container) &&
 	{
-		return View<Container>{std::make_shared<Container>(container), func};
+		if constexpr (batched_range<Container>)
+			return BatchView<Container>(Upstream<Container>(std::forward<Container>(container)), std::move(func));
+		else
+			return fuse(std::forward<Container>(container), FilterStep<FUNC>{std::move(func)});
 	}
 
 private:
@@ -218,6 +697,11 @@ public:
 			return *this;
 		}
 
+		bool operator==(const Iterator &other) const
+		{
+			return !(current != other.current);
+		}
+
 		bool operator!=(const Iterator &other) const
 		{
 			return current != other.current;
@@ -251,103 +735,338 @@ public:
 	template <typename Container>
 	struct View
 	{
-		std::shared_ptr<Container> container;
+		Upstream<Container> container;
 		auto begin() const
 		{
-			return Iterator<decltype(std::begin(*container))>(
-				std::begin(*container), std::end(*container));
+			return Iterator<decltype(std::begin(container.get()))>(
+				std::begin(container.get()), std::end(container.get()));
 		}
 
 		auto end() const
 		{
-			return Iterator<decltype(std::begin(*container))>(
-				std::end(*container), std::end(*container));
+			return Iterator<decltype(std::begin(container.get()))>(
+				std::end(container.get()), std::end(container.get()));
 		}
 	};
 
 	template <typename Container>
-	View<Container> apply(const Container &container) const
+	View<Container> apply(Container &&container) const
 	{
-		return View<Container>{std::make_shared<Container>(container)};
+		return View<Container>{Upstream<Container>(std::forward<Container>(container))};
 	}
 };
 
-class Split
+// The contents of a file, mapped read-only where the platform allows and
+// read into memory otherwise. A file that cannot be opened is empty.
+class MappedFile
+{
+public:
+	explicit MappedFile(const fs::path &path)
+	{
+#ifdef PROCESSING_HAS_MMAP
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+		struct stat info;
+		if (::fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			void *data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				::madvise(data, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+				mapping = data;
+				size = static_cast<std::size_t>(info.st_size);
+			}
+		}
+		::close(fd);
+		if (mapping)
+			return;
+#endif
+		// Files that report no size, like those in /proc, are read instead.
+		std::ifstream file(path, std::ios::binary);
+		copy.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	~MappedFile()
+	{
+#ifdef PROCESSING_HAS_MMAP
+		if (mapping)
+			::munmap(mapping, size);
+#endif
+	}
+
+	std::string_view text() const
+	{
+		return mapping ? std::string_view(static_cast<const char *>(mapping), size) : std::string_view(copy);
+	}
+
+private:
+	void *mapping = nullptr;
+	std::size_t size = 0;
+	std::string copy;
+};
+
+// Like OpenFiles, but yields the text of each regular file as a
+// std::string_view into a MappedFile. The files stay mapped as long as the
+// view, so Split can hand out tokens that point into them.
+class MapFiles
 {
 public:
+	using Mappings = std::vector<std::unique_ptr<MappedFile>>;
+
 	template <typename Iter>
 	class Iterator
 	{
 	public:
-		using value_type = std::string;
+		using value_type = std::string_view;
 		using difference_type = std::ptrdiff_t;
 		using pointer = const value_type *;
 		using reference = const value_type &;
 		using iterator_category = std::input_iterator_tag;
-		Iterator() = default;
-		Iterator(Iter current, Iter end, const bool *delimiters, bool is_end = false)
-			: current_iter(std::move(current)), end_iter(std::move(end)), delimiters(delimiters), end_flag(is_end)
+
+		Iterator(Iter current, Iter end, Mappings *mapped)
+			: current(std::move(current)), end(std::move(end)), mapped(mapped)
 		{
-			if (!end_flag && current_iter != end_iter)
-				readNext();
-			else
-				end_flag = true;
+			map_file();
 		}
 
-		reference operator*() const { return current; }
-		pointer operator->() const { return &current; }
+		reference operator*() const { return text; }
+		pointer operator->() const { return &text; }
 
 		Iterator &operator++()
 		{
-			readNext();
+			++current;
+			map_file();
 			return *this;
 		}
 
 		bool operator==(const Iterator &other) const
 		{
-			return !(end_flag != other.end_flag) && !(current_iter != other.current_iter);
+			return !(current != other.current);
 		}
 
 		bool operator!=(const Iterator &other) const
 		{
-			return !(*this == other);
+			return current != other.current;
 		}
 
 	private:
-		Iter current_iter;
-		Iter end_iter;
-		std::istream *stream = nullptr;
-		const bool *delimiters;
-		std::string current;
-		bool end_flag;
+		Iter current, end;
+		Mappings *mapped;
+		std::string_view text;
 
-		void readNext()
+		void map_file()
 		{
-			current.clear();
-
-			while (true)
+			while (current != end && !current->is_regular_file())
 			{
-				if (!stream && current_iter != end_iter)
-				{
-					stream = &(*current_iter);
-					++current_iter;
-				}
+				++current;
+			}
+			if (current != end)
+			{
+				mapped->push_back(std::make_unique<MappedFile>(current->path()));
+				text = mapped->back()->text();
+			}
+		}
+	};
 
-				if (!stream || !(*stream))
-				{
-					stream = nullptr;
-					if (current.empty())
-					{
-						if (!(current_iter != end_iter))
-						{
-							end_flag = true;
-						}
-					}
-					return;
-				}
+	template <typename Container>
+	struct View
+	{
+		Upstream<Container> container;
+		mutable Mappings mapped;
+
+		auto begin() const
+		{
+			return Iterator<decltype(std::begin(container.get()))>(
+				std::begin(container.get()), std::end(container.get()), &mapped);
+		}
+
+		auto end() const
+		{
+			return Iterator<decltype(std::begin(container.get()))>(
+				std::end(container.get()), std::end(container.get()), &mapped);
+		}
+	};
+
+	template <typename Container>
+	View<Container> apply(Container &&container) const
+	{
+		return View<Container>{Upstream<Container>(std::forward<Container>(container)), {}};
+	}
+};
+
+// Whether a view holds a MapFiles view, and with it the mappings the
+// string_views it yields point into, rather than referring to one.
+template <typename T>
+struct owns_mappings : std::false_type {};
+
+template <typename Container>
+struct owns_mappings<MapFiles::View<Container>> : std::true_type {};
+
+template <template <typename...> class View, typename Container, typename... Rest>
+struct owns_mappings<View<Container, Rest...>> : owns_mappings<Container> {};
+
+// Whether `Text` taken from `Container` outlives the files it points into:
+// a temporary view that owns its mappings unmaps them when the expression
+// that materialises it ends.
+template <typename Container, typename Text>
+inline constexpr bool dangles_after_v = !std::is_lvalue_reference_v<Container> &&
+										owns_mappings<std::remove_cvref_t<Container>>::value &&
+										std::is_same_v<std::remove_cvref_t<Text>, std::string_view>;
+
+// Finds which of 64 bytes are delimiters. With at most MaxVectorDelimiters
+// distinct delimiters, as in Split("\n ,.;"), a block is compared against
+// each of them 32 bytes at a time with AVX2 or 16 at a time with SSE2,
+// picked when the scanner is built; larger sets, short tails and other
+// targets use the table.
+class DelimiterScanner
+{
+public:
+	static constexpr std::size_t MaxVectorDelimiters = 8;
+
+	explicit DelimiterScanner(const std::array<bool, 256> &flags) : flags(flags)
+	{
+		for (std::size_t ch = 0; ch < flags.size(); ++ch)
+		{
+			if (!flags[ch])
+				continue;
+			if (count == MaxVectorDelimiters)
+			{
+				count = 0;
+				return;
+			}
+			chars[count++] = static_cast<char>(ch);
+		}
+#ifdef PROCESSING_HAS_SSE2
+		if (count != 0)
+			vector = __builtin_cpu_supports("avx2") ? &mask_avx2 : &mask_sse2;
+#endif
+	}
+
+	const bool *table() const { return flags.data(); }
+
+	// Bit i is set when p[i] is a delimiter or i >= n.
+	std::uint64_t mask(const char *p, std::size_t n) const
+	{
+		if (vector && n >= 64)
+			return vector(p, chars.data(), count);
+		std::uint64_t bits = n >= 64 ? 0 : ~std::uint64_t{0} << n;
+		for (std::size_t i = 0, stop = n < 64 ? n : 64; i < stop; ++i)
+			bits |= std::uint64_t{flags[static_cast<unsigned char>(p[i])]} << i;
+		return bits;
+	}
+
+private:
+	using VectorMask = std::uint64_t (*)(const char *p, const char *chars, std::size_t count);
+
+	std::array<bool, 256> flags;
+	std::array<char, MaxVectorDelimiters> chars{};
+	std::size_t count = 0;
+	VectorMask vector = nullptr;
+
+#ifdef PROCESSING_HAS_SSE2
+	static std::uint64_t mask_sse2(const char *p, const char *chars, std::size_t count)
+	{
+		std::uint64_t bits = 0;
+		for (int block = 0; block < 64; block += 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + block));
+			__m128i hits = _mm_setzero_si128();
+			for (std::size_t i = 0; i < count; ++i)
+				hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(chars[i])));
+			bits |= std::uint64_t{static_cast<std::uint16_t>(_mm_movemask_epi8(hits))} << block;
+		}
+		return bits;
+	}
+
+	__attribute__((target("avx2"))) static std::uint64_t mask_avx2(const char *p, const char *chars, std::size_t count)
+	{
+		std::uint64_t bits = 0;
+		for (int block = 0; block < 64; block += 32)
+		{
+			__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + block));
+			__m256i hits = _mm256_setzero_si256();
+			for (std::size_t i = 0; i < count; ++i)
+				hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(chars[i])));
+			bits |= std::uint64_t{static_cast<std::uint32_t>(_mm256_movemask_epi8(hits))} << block;
+		}
+		return bits;
+	}
+#endif
+};
+
+class Split
+{
+public:
+	template <typename Iter>
+	class Iterator
+	{
+	public:
+		using value_type = std::string;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type *;
+		using reference = const value_type &;
+		using iterator_category = std::input_iterator_tag;
+		Iterator() = default;
+		Iterator(Iter current, Iter end, const bool *delimiters, bool is_end = false)
+			: current_iter(std::move(current)), end_iter(std::move(end)), delimiters(delimiters), end_flag(is_end)
+		{
+			if (!end_flag && current_iter != end_iter)
+				readNext();
+			else
+				end_flag = true;
+		}
+
+		reference operator*() const { return current; }
+		pointer operator->() const { return &current; }
+
+		Iterator &operator++()
+		{
+			readNext();
+			return *this;
+		}
+
+		bool operator==(const Iterator &other) const
+		{
+			return !(end_flag != other.end_flag) && !(current_iter != other.current_iter);
+		}
+
+		bool operator!=(const Iterator &other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		Iter current_iter;
+		Iter end_iter;
+		std::istream *stream = nullptr;
+		const bool *delimiters;
+		std::string current;
+		bool end_flag;
+
+		// The upstream iterator is advanced only once its stream is read
+		// through, since OpenFiles closes a file when it moves past it.
+		void readNext()
+		{
+			current.clear();
+
+			while (true)
+			{
+				if (!stream)
+				{
+					if (!(current_iter != end_iter))
+					{
+						end_flag = true;
+						return;
+					}
+					stream = &(*current_iter);
+				}
 
 				char ch;
-				while (stream && stream->get(ch))
+				while (stream->get(ch))
 				{
 					if (delimiters[static_cast<unsigned char>(ch)])
 					{
@@ -361,176 +1080,1186 @@ public:
 				}
 
 				stream = nullptr;
+				++current_iter;
 				if (!current.empty())
 					return;
 			}
 		}
-	};
-	Split(const std::string &delim)
+	};
+
+	// Splits text already in memory, such as the files of MapFiles, without
+	// copying: the tokens view the upstream text. The delimiters of 64
+	// bytes are found at once, and token boundaries are then read off the
+	// bits of that mask.
+	template <typename Iter>
+	class TextIterator
+	{
+	public:
+		using value_type = std::string_view;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type *;
+		using reference = const value_type &;
+		using iterator_category = std::input_iterator_tag;
+		TextIterator() = default;
+		TextIterator(Iter current, Iter end, const DelimiterScanner *scanner, bool is_end = false)
+			: current_iter(std::move(current)), end_iter(std::move(end)), scanner(scanner), end_flag(is_end)
+		{
+			if (!end_flag)
+				readNext();
+		}
+
+		reference operator*() const { return current; }
+		pointer operator->() const { return &current; }
+
+		TextIterator &operator++()
+		{
+			readNext();
+			return *this;
+		}
+
+		bool operator==(const TextIterator &other) const
+		{
+			return !(end_flag != other.end_flag) && !(current_iter != other.current_iter);
+		}
+
+		bool operator!=(const TextIterator &other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		Iter current_iter;
+		Iter end_iter;
+		const DelimiterScanner *scanner;
+		std::string_view current;
+		bool end_flag;
+		// The text left of the current upstream item is [pos, text_end).
+		// Bit i of delims tells whether window[i] is a delimiter; bits past
+		// text_end are set.
+		const char *pos = nullptr;
+		const char *text_end = nullptr;
+		const char *window = nullptr;
+		std::uint64_t delims = 0;
+
+		// The bits from pos to the end of the window that mark delimiters,
+		// or with `letters` those that do not.
+		std::uint64_t ahead(bool letters = false)
+		{
+			if (!window || pos - window >= 64)
+			{
+				window = pos;
+				delims = scanner->mask(pos, static_cast<std::size_t>(text_end - pos));
+			}
+			return (letters ? ~delims : delims) >> (pos - window);
+		}
+
+		// Moves pos to the end of the window, or of the text if that is
+		// closer.
+		void skip_window()
+		{
+			pos = text_end - window <= 64 ? text_end : window + 64;
+		}
+
+		void readNext()
+		{
+			while (true)
+			{
+				while (pos != text_end)
+				{
+					if (std::uint64_t letters = ahead(true))
+					{
+						pos += std::countr_zero(letters);
+						break;
+					}
+					skip_window();
+				}
+
+				if (pos != text_end)
+				{
+					const char *token = pos;
+					while (pos != text_end)
+					{
+						if (std::uint64_t found = ahead())
+						{
+							pos += std::countr_zero(found);
+							break;
+						}
+						skip_window();
+					}
+					current = std::string_view(token, static_cast<std::size_t>(pos - token));
+					return;
+				}
+
+				if (!(current_iter != end_iter))
+				{
+					current = {};
+					end_flag = true;
+					return;
+				}
+				std::string_view text = *current_iter;
+				pos = text.data();
+				text_end = text.data() + text.size();
+				window = nullptr;
+				++current_iter;
+			}
+		}
+	};
+
+	template <typename Iter>
+	static constexpr bool reads_text = std::is_same_v<std::remove_cvref_t<decltype(*std::declval<Iter &>())>, std::string_view>;
+
+	using Delimiters = std::array<bool, 256>;
+
+	Split(const std::string &delim)
+	{
+		delim_flags.fill(false);
+		for (unsigned char ch : delim)
+		{
+			delim_flags[ch] = true;
+		}
+	}
+
+	// Keeps its own delimiter table, since the Split it came from is
+	// usually a temporary of the pipeline expression. Text in memory is
+	// split by TextIterator, streams by Iterator.
+	template <typename Container>
+	class View
+	{
+	public:
+		View(Upstream<Container> c, const Delimiters &flags) : container(std::move(c)), scanner(flags) {}
+		auto begin() const
+		{
+			using Iter = decltype(std::begin(container.get()));
+			if constexpr (reads_text<Iter>)
+				return TextIterator<Iter>(std::begin(container.get()), std::end(container.get()), &scanner);
+			else
+				return Iterator<Iter>(std::begin(container.get()), std::end(container.get()), scanner.table());
+		}
+		auto end() const
+		{
+			using Iter = decltype(std::begin(container.get()));
+			if constexpr (reads_text<Iter>)
+				return TextIterator<Iter>(std::end(container.get()), std::end(container.get()), &scanner, true);
+			else
+				return Iterator<Iter>(std::end(container.get()), std::end(container.get()), scanner.table(), true);
+		}
+
+	private:
+		Upstream<Container> container;
+		DelimiterScanner scanner;
+	};
+
+	template <typename Container>
+	View<Container> apply(Container &&container) const
+	{
+		return View<Container>{Upstream<Container>(std::forward<Container>(container)), delim_flags};
+	}
+
+	bool is_delimiter(char ch) const { return delim_flags[static_cast<unsigned char>(ch)]; }
+
+private:
+	Delimiters delim_flags;
+};
+
+template <class FUNC>
+class Transform
+{
+public:
+	Transform(const FUNC &func) : func(func) {}
+
+	// Maps a whole batch into a buffer of results.
+	template <typename Container>
+	class BatchView
+	{
+		using input_batch = typename std::remove_cvref_t<Container>::batch_type;
+
+	public:
+		using value_type = std::decay_t<invoke_token_result_t<const FUNC &, const typename input_batch::value_type &>>;
+		using batch_type = Batch<value_type>;
+		static_assert(!std::is_same_v<value_type, bool>, "batched Transform cannot produce bool; use Filter");
+
+		BatchView(Upstream<Container> container, FUNC func) : container(std::move(container)), func(std::move(func)) {}
+
+		std::optional<batch_type> next_batch() const
+		{
+			auto batch = container.get().next_batch();
+			if (!batch)
+				return std::nullopt;
+			if constexpr (std::is_default_constructible_v<value_type>)
+			{
+				results.resize(batch->size());
+				value_type *out = results.data();
+				batch->for_each([&](std::uint32_t, const auto &item) { *out++ = invoke_token(func, item); });
+			}
+			else
+			{
+				results.clear();
+				batch->for_each([&](std::uint32_t, const auto &item) { results.push_back(invoke_token(func, item)); });
+			}
+			return batch_type{results.data(), nullptr, batch->size()};
+		}
+
+		BatchIterator<BatchView> begin() const { return BatchIterator<BatchView>(this); }
+		BatchIterator<BatchView> end() const { return BatchIterator<BatchView>(); }
+
+	private:
+		Upstream<Container> container;
+		FUNC func;
+		mutable std::vector<value_type> results;
+	};
+
+	template <typename Container>
+	auto apply(Container &&container) const &
+	{
+		if constexpr (batched_range<Container>)
+			return BatchView<Container>(Upstream<Container>(std::forward<Container>(container)), func);
+		else
+			return fuse(std::forward<Container>(container), TransformStep<FUNC>{func});
+	}
+
+	template <typename Container>
+	auto apply(Container &&container) &&
+	{
+		if constexpr (batched_range<Container>)
+			return BatchView<Container>(Upstream<Container>(std::forward<Container>(container)), std::move(func));
+		else
+			return fuse(std::forward<Container>(container), TransformStep<FUNC>{std::move(func)});
+	}
+
+private:
+	FUNC func;
+};
+
+// A fixed set of threads taking tasks from one bounded queue, oldest first.
+// At most `capacity` tasks wait at a time: submit blocks until a worker
+// takes one, so a producer that is faster than the workers does not queue
+// the whole input. Tasks are a file or a partition each, so one lock per
+// task costs nothing next to running it.
+class TaskPool
+{
+public:
+	using Task = std::function<void(std::size_t worker)>;
+
+	TaskPool(std::size_t threads, std::size_t capacity)
+		: capacity(capacity == 0 ? 1 : capacity)
+	{
+		for (std::size_t i = 0; i < (threads == 0 ? 1 : threads); ++i)
+			workers.emplace_back([this, i] { work(i); });
+	}
+
+	TaskPool(const TaskPool &) = delete;
+	TaskPool &operator=(const TaskPool &) = delete;
+
+	// Runs the tasks still queued, then stops the workers.
+	~TaskPool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		work_ready.notify_all();
+		for (auto &worker : workers)
+			worker.join();
+	}
+
+	std::size_t size() const { return workers.size(); }
+
+	void submit(Task task)
+	{
+		{
+			std::unique_lock lock(mutex);
+			slot_free.wait(lock, [this] { return tasks.size() < capacity; });
+			tasks.push_back(std::move(task));
+			++pending;
+		}
+		work_ready.notify_one();
+	}
+
+	// Waits for every submitted task and rethrows the first exception one
+	// of them threw.
+	void wait()
+	{
+		std::unique_lock lock(mutex);
+		all_done.wait(lock, [this] { return pending == 0; });
+		if (error)
+			std::rethrow_exception(std::exchange(error, nullptr));
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable work_ready, slot_free, all_done;
+	std::deque<Task> tasks;
+	std::size_t capacity;
+	std::size_t pending = 0; // submitted and not yet finished
+	bool stopping = false;
+	std::exception_ptr error;
+
+	void work(std::size_t self)
+	{
+		while (true)
+		{
+			Task task;
+			{
+				std::unique_lock lock(mutex);
+				work_ready.wait(lock, [this] { return !tasks.empty() || stopping; });
+				if (tasks.empty())
+					return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			slot_free.notify_one();
+
+			try
+			{
+				task(self);
+			}
+			catch (...)
+			{
+				std::lock_guard lock(mutex);
+				if (!error)
+					error = std::current_exception();
+			}
+
+			std::lock_guard lock(mutex);
+			if (--pending == 0)
+				all_done.notify_all();
+		}
+	}
+};
+
+// An open-addressing hash table of (key, value) entries, kept in the order
+// the keys were inserted. A slot holds the index of its entry and the high
+// half of the key's hash, so probing compares keys only when those agree,
+// and growing rehashes from the stored hashes instead of hashing the keys
+// again. It holds at most 2^32 - 1 keys.
+template <typename Key, typename Value>
+class AggregationTable
+{
+public:
+	// std::hash is the identity for integers on common implementations, so
+	// its result is mixed before the low bits pick a slot.
+	static std::uint64_t hash(const Key &key)
+	{
+		std::uint64_t h = std::hash<Key>{}(key);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// The value of `key`, inserted as a copy of `initial` if it is new.
+	Value &find_or_insert(Key &&key, std::uint64_t hash, const Value &initial)
+	{
+		if ((entries.size() + 1) * 2 > slots.size())
+			grow();
+		std::size_t mask = slots.size() - 1;
+		std::uint32_t tag = static_cast<std::uint32_t>(hash >> 32);
+		for (std::size_t i = hash & mask;; i = (i + 1) & mask)
+		{
+			Slot &slot = slots[i];
+			if (slot.entry == 0)
+			{
+				entries.emplace_back(std::move(key), initial);
+				hashes.push_back(hash);
+				slot = Slot{tag, static_cast<std::uint32_t>(entries.size())};
+				return entries.back().second;
+			}
+			if (slot.tag == tag && entries[slot.entry - 1].first == key)
+				return entries[slot.entry - 1].second;
+		}
+	}
+
+	const Value *find(const Key &key, std::uint64_t hash) const
+	{
+		if (slots.empty())
+			return nullptr;
+		std::size_t mask = slots.size() - 1;
+		std::uint32_t tag = static_cast<std::uint32_t>(hash >> 32);
+		for (std::size_t i = hash & mask;; i = (i + 1) & mask)
+		{
+			const Slot &slot = slots[i];
+			if (slot.entry == 0)
+				return nullptr;
+			if (slot.tag == tag && entries[slot.entry - 1].first == key)
+				return &entries[slot.entry - 1].second;
+		}
+	}
+
+	std::size_t size() const { return entries.size(); }
+
+	std::vector<std::pair<Key, Value>> take() &&
+	{
+		slots.clear();
+		hashes.clear();
+		return std::move(entries);
+	}
+
+private:
+	struct Slot
+	{
+		std::uint32_t tag = 0;
+		std::uint32_t entry = 0; // index + 1, 0 when the slot is free
+	};
+
+	std::vector<Slot> slots;
+	std::vector<std::pair<Key, Value>> entries;
+	std::vector<std::uint64_t> hashes;
+
+	void grow()
+	{
+		std::vector<Slot> grown(slots.empty() ? 16 : slots.size() * 2);
+		std::size_t mask = grown.size() - 1;
+		for (std::size_t entry = 0; entry < hashes.size(); ++entry)
+		{
+			std::size_t i = hashes[entry] & mask;
+			while (grown[i].entry != 0)
+				i = (i + 1) & mask;
+			grown[i] = Slot{static_cast<std::uint32_t>(hashes[entry] >> 32), static_cast<std::uint32_t>(entry + 1)};
+		}
+		slots = std::move(grown);
+	}
+};
+
+// AggregateByKey(aggregator, key) counts keys: a key starts at 1 when it is
+// first seen and aggregator(count) runs for every repeat. The result is a
+// std::map. AggregateByKey(initial, aggregator, key) is the general form.
+template <typename... Parts>
+class AggregateByKey;
+
+template <typename Aggregator, typename KeyExtractor>
+AggregateByKey(Aggregator, KeyExtractor) -> AggregateByKey<Aggregator, KeyExtractor>;
+
+template <typename Value, typename Aggregator, typename KeyExtractor>
+AggregateByKey(Value, Aggregator, KeyExtractor) -> AggregateByKey<Value, Aggregator, KeyExtractor>;
+
+template <typename Aggregator, typename KeyExtractor>
+class AggregateByKey<Aggregator, KeyExtractor>
+{
+public:
+	AggregateByKey(Aggregator aggregator, KeyExtractor keyExtractor)
+		: aggregator(std::move(aggregator)), keyExtractor(std::move(keyExtractor)) {}
+
+	template <typename Container>
+	auto apply(Container &&container) const
+	{
+		using Item = decltype(*container.begin());
+		using Key = std::decay_t<invoke_token_result_t<const KeyExtractor &, Item>>;
+		using Value = std::size_t;
+		static_assert(!dangles_after_v<Container, Key>,
+					  "the files are unmapped when this expression ends, so keys must own their text or the view must be named");
+
+		std::map<Key, Value> result;
+
+		for_each_item(container, [&](const auto &item)
+		{
+			Key key = invoke_token(keyExtractor, item);
+			auto it = result.find(key);
+
+			if (it != result.end())
+			{
+				aggregator(it->second);
+			}
+			else
+			{
+				result[key] = 1; // начинаем с 1
+			}
+		});
+
+		return result;
+	}
+
+	template <typename Container>
+	using KeyOf = std::decay_t<invoke_token_result_t<const KeyExtractor &, decltype(*std::declval<const Container &>().begin())>>;
+
+	// Adds the number of occurrences of every key of `container` to
+	// `counts`. Counts taken over disjoint parts of the input may be summed
+	// and handed to finish, which then gives what apply gives for the whole.
+	template <typename Container, typename Key>
+	void count(const Container &container, std::map<Key, std::size_t> &counts) const
+	{
+		for_each_item(container, [&](const auto &item) { ++counts[invoke_token(keyExtractor, item)]; });
+	}
+
+	template <typename Key>
+	std::map<Key, std::size_t> finish(std::map<Key, std::size_t> counts) const
+	{
+		for (auto &[key, value] : counts)
+		{
+			std::size_t occurrences = value;
+			value = 1;
+			for (std::size_t i = 1; i < occurrences; ++i)
+				aggregator(value);
+		}
+		return counts;
+	}
+
+private:
+	Aggregator aggregator;
+	KeyExtractor keyExtractor;
+};
+
+// Writes and reads keys and values in the run files of a spilling
+// AggregateByKey. Strings and trivially copyable types are supported.
+template <typename T>
+void spill_write(std::ostream &out, const T &value)
+{
+	if constexpr (std::is_same_v<T, std::string>)
+	{
+		std::uint64_t size = value.size();
+		out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+		out.write(value.data(), static_cast<std::streamsize>(value.size()));
+	}
+	else
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "only strings and trivially copyable types can be spilled");
+		out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+}
+
+template <typename T>
+bool spill_read(std::istream &in, T &value)
+{
+	if constexpr (std::is_same_v<T, std::string>)
+	{
+		std::uint64_t size;
+		if (!in.read(reinterpret_cast<char *>(&size), sizeof(size)))
+			return false;
+		value.resize(static_cast<std::size_t>(size));
+		return static_cast<bool>(in.read(value.data(), static_cast<std::streamsize>(size)));
+	}
+	else
+	{
+		return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+	}
+}
+
+template <typename T>
+constexpr bool spillable = std::is_same_v<T, std::string> || std::is_trivially_copyable_v<T>;
+
+// What an entry of `value` holds outside the object itself.
+template <typename T>
+std::size_t spill_heap_size(const T &value)
+{
+	if constexpr (std::is_same_v<T, std::string>)
+		return value.capacity();
+	else
+		return 0;
+}
+
+// The result of a spilling AggregateByKey: the sorted runs it wrote, merged
+// lazily in key order. combine(value, other) joins the values a key has in
+// several runs, taken in the order the runs were written. At most
+// MaxFanIn runs are open at once: beyond that, consecutive runs are first
+// merged in groups into new runs, which relies on combine giving the same
+// value however the values of a key are grouped. The run files are
+// removed with the range. A run that cannot be read back throws.
+template <typename Key, typename Value, typename Combine>
+class SpilledAggregate
+{
+public:
+	class Iterator
+	{
+	public:
+		using value_type = std::pair<Key, Value>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type *;
+		using reference = const value_type &;
+		using iterator_category = std::input_iterator_tag;
+
+		Iterator() = default;
+		explicit Iterator(const SpilledAggregate *owner) : owner(owner) {}
+
+		reference operator*() const { return owner->state->current; }
+		pointer operator->() const { return &owner->state->current; }
+
+		Iterator &operator++()
+		{
+			owner->advance();
+			return *this;
+		}
+
+		bool operator==(const Iterator &other) const
+		{
+			return finished() == other.finished();
+		}
+
+		bool operator!=(const Iterator &other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		const SpilledAggregate *owner = nullptr;
+
+		bool finished() const { return !owner || owner->state->finished; }
+	};
+
+	static constexpr std::size_t MaxFanIn = 64;
+
+	SpilledAggregate(fs::path directory, Combine combine)
+		: state(std::make_unique<State>(std::move(directory), std::move(combine))) {}
+
+	// Sorts `entries` and writes them out as the next run.
+	void spill(std::vector<std::pair<Key, Value>> entries)
+	{
+		std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+		write(entries);
+	}
+
+	std::size_t runs() const { return state->paths.size(); }
+
+	Iterator begin() const
+	{
+		if (!state->started)
+			start();
+		return Iterator(this);
+	}
+
+	Iterator end() const { return Iterator(); }
+
+private:
+	struct Run
+	{
+		std::ifstream in;
+		std::pair<Key, Value> head;
+
+		// False at the end of the run.
+		bool next()
+		{
+			if (in.peek() == std::ifstream::traits_type::eof() && !in.bad())
+				return false;
+			if (!spill_read(in, head.first) || !spill_read(in, head.second))
+				throw std::runtime_error("AggregateByKey: a spilled run is truncated or unreadable");
+			return true;
+		}
+	};
+
+	struct State
+	{
+		State(fs::path directory, Combine combine) : directory(std::move(directory)), combine(std::move(combine)) {}
+
+		~State()
+		{
+			runs.clear();
+			std::error_code ignored;
+			for (const auto &path : paths)
+				fs::remove(path, ignored);
+		}
+
+		fs::path directory;
+		Combine combine;
+		std::vector<fs::path> paths;
+		std::vector<std::unique_ptr<Run>> runs;
+		// Indices of the runs that have a head, smallest head key on top
+		// and the earlier run first among equal keys.
+		std::vector<std::size_t> heap;
+		std::pair<Key, Value> current;
+		bool started = false;
+		bool finished = false;
+	};
+
+	std::unique_ptr<State> state;
+
+	auto later() const
+	{
+		return [this](std::size_t a, std::size_t b) {
+			const Key &ka = state->runs[a]->head.first;
+			const Key &kb = state->runs[b]->head.first;
+			return kb < ka || (!(ka < kb) && b < a);
+		};
+	}
+
+	fs::path next_path() const
+	{
+		static std::atomic<std::uint64_t> runs{0};
+		return state->directory / ("aggregate-" + std::to_string(reinterpret_cast<std::uintptr_t>(state.get())) + "-" +
+								   std::to_string(runs++) + ".run");
+	}
+
+	// Writes `entries`, ordered by key, as the next run.
+	template <typename Entries>
+	void write(const Entries &entries) const
+	{
+		fs::path path = next_path();
+		state->paths.push_back(path);
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		for (const auto &[key, value] : entries)
+		{
+			spill_write(out, key);
+			spill_write(out, value);
+		}
+		if (!out.flush())
+			throw std::runtime_error("AggregateByKey: cannot write " + path.string());
+	}
+
+	// Replaces every MaxFanIn consecutive runs by the run of their merge.
+	void merge_groups() const
+	{
+		std::vector<fs::path> pending = std::exchange(state->paths, {});
+		std::size_t taken = 0;
+		try
+		{
+			while (taken < pending.size())
+			{
+				SpilledAggregate group(state->directory, state->combine);
+				std::size_t last = std::min(pending.size(), taken + MaxFanIn);
+				group.state->paths.assign(pending.begin() + taken, pending.begin() + last);
+				taken = last;
+				write(group);
+			}
+		}
+		catch (...)
+		{
+			state->paths.insert(state->paths.end(), pending.begin() + taken, pending.end());
+			throw;
+		}
+	}
+
+	void start() const
 	{
-		std::fill(std::begin(delim_flags), std::end(delim_flags), false);
-		for (unsigned char ch : delim)
+		state->started = true;
+		while (state->paths.size() > MaxFanIn)
+			merge_groups();
+		for (std::size_t i = 0; i < state->paths.size(); ++i)
 		{
-			delim_flags[ch] = true;
+			auto run = std::make_unique<Run>();
+			run->in.open(state->paths[i], std::ios::binary);
+			if (!run->in)
+				throw std::runtime_error("AggregateByKey: cannot read " + state->paths[i].string());
+			bool filled = run->next();
+			state->runs.push_back(std::move(run));
+			if (filled)
+				state->heap.push_back(i);
 		}
+		std::make_heap(state->heap.begin(), state->heap.end(), later());
+		advance();
 	}
 
-	template <typename Container>
-	class View
+	// Takes the smallest key and combines its values from every run.
+	void advance() const
 	{
-	public:
-		View(std::shared_ptr<Container> c, const bool *flags) : container(c), delimiters(flags) {}
-		auto begin() const
+		auto &heap = state->heap;
+		if (heap.empty())
 		{
-			return Iterator<decltype(std::begin(*container))>(
-				std::begin(*container), std::end(*container), delimiters);
+			state->finished = true;
+			return;
 		}
-		auto end() const
+		bool first = true;
+		while (!heap.empty() && (first || !(state->current.first < state->runs[heap.front()]->head.first)))
 		{
-			return Iterator<decltype(std::begin(*container))>(
-				std::end(*container), std::end(*container), delimiters, true);
+			std::pop_heap(heap.begin(), heap.end(), later());
+			Run &run = *state->runs[heap.back()];
+			if (first)
+				state->current = std::move(run.head);
+			else
+				state->combine(state->current.second, std::as_const(run.head.second));
+			first = false;
+			if (run.next())
+				std::push_heap(heap.begin(), heap.end(), later());
+			else
+				heap.pop_back();
 		}
+	}
+};
 
-	private:
-		std::shared_ptr<Container> container;
-		const bool *delimiters;
-	};
+// Every key starts at a copy of `initial`, and aggregator(value, item)
+// folds each item into the value of its key; aggregator(item, value) is
+// accepted as well. The result is a std::vector of (key, value) pairs in
+// the order the keys were first seen, or ordered by key after sorted().
+template <typename Value, typename Aggregator, typename KeyExtractor>
+class AggregateByKey<Value, Aggregator, KeyExtractor>
+{
+public:
+	AggregateByKey(Value initial, Aggregator aggregator, KeyExtractor keyExtractor)
+		: initial(std::move(initial)), aggregator(std::move(aggregator)), keyExtractor(std::move(keyExtractor)) {}
 
-	template <typename Container>
-	View<Container> apply(const Container &container) const
+	AggregateByKey sorted() const
 	{
-		return View<Container>{std::make_shared<Container>(container), delim_flags};
+		AggregateByKey copy = *this;
+		copy.sort_keys = true;
+		return copy;
 	}
 
-private:
-	bool delim_flags[256];
-};
+	// Aggregates on `threads` threads. The items are first scattered by the
+	// high bits of their key's hash into one partition per thread, so each
+	// key is folded by a single thread and in input order, and the result
+	// is the one apply gives on one thread. Items are copied into the
+	// partitions.
+	AggregateByKey partitioned(std::size_t threads) const
+	{
+		AggregateByKey copy = *this;
+		copy.partitions = threads == 0 ? 1 : threads;
+		return copy;
+	}
 
-template <class FUNC>
-class Transform
-{
-public:
-	Transform(const FUNC &func) : func(func) {}
+	// Keeps about `budget` bytes of keys and values in memory, see Spilling.
+	template <typename Combine>
+	auto spill(std::size_t budget, Combine combine, fs::path directory = fs::temp_directory_path()) const
+	{
+		return Spilling<Combine>(*this, budget, std::move(combine), std::move(directory));
+	}
 
-	template <class Iter>
-	class Iterator
+	// Aggregates on one thread into a table of at most `budget` bytes,
+	// counting each entry, its table slots and the text of string keys and
+	// values, including what a value grows by as items are folded into it.
+	// A full table is sorted and written to a run file, and the
+	// result is a SpilledAggregate that merges the runs while they are
+	// read. The result is the one sorted() gives, provided combining the
+	// values of a key's runs in order gives what aggregating its items in
+	// one go does.
+	template <typename Combine>
+	class Spilling
 	{
 	public:
-		using input_type = Iter::reference;
-		using value_type = std::invoke_result_t<FUNC, input_type>;
-		using pointer = const value_type *;
-		using reference = const value_type &;
+		Spilling(AggregateByKey aggregate, std::size_t budget, Combine combine, fs::path directory)
+			: aggregate(std::move(aggregate)), budget(budget), combine(std::move(combine)), directory(std::move(directory)) {}
 
-		Iterator(Iter it, FUNC func) : current(std::move(it)), func(func) { Get_Result(); }
-
-		reference operator*() const
+		template <typename Container>
+		auto apply(Container &&container) const
 		{
+			using Item = decltype(*container.begin());
+			using Key = std::decay_t<invoke_token_result_t<const KeyExtractor &, Item>>;
+			using Table = AggregationTable<Key, Value>;
+			static_assert(!dangles_after_v<Container, Key>,
+						  "the files are unmapped when this expression ends, so keys must own their text or the view must be named");
+			// An entry, its stored hash and the two slots kept per entry.
+			constexpr std::size_t entry_size = sizeof(std::pair<Key, Value>) + sizeof(std::uint64_t) + 2 * 2 * sizeof(std::uint32_t);
+
+			SpilledAggregate<Key, Value, Combine> result(directory, combine);
+			Table table;
+			std::size_t used = 0;
+			for_each_item(container, [&](const auto &item)
+			{
+				Key key = invoke_token(aggregate.keyExtractor, item);
+				std::uint64_t hash = Table::hash(key);
+				std::size_t key_size = spill_heap_size(key);
+				std::size_t before = table.size();
+				Value &value = table.find_or_insert(std::move(key), hash, aggregate.initial);
+				bool inserted = table.size() != before;
+				std::size_t value_size = inserted ? 0 : spill_heap_size(value);
+				aggregate.fold(value, item);
+				if (inserted)
+					used += entry_size + key_size;
+				used = used - value_size + spill_heap_size(value);
+				if (used >= budget)
+				{
+					result.spill(std::move(table).take());
+					table = Table();
+					used = 0;
+				}
+			});
+			if (table.size() != 0)
+				result.spill(std::move(table).take());
 			return result;
 		}
-		pointer operator->() const
-		{
-			return *result;
-		}
-		Iterator &operator++()
-		{
-			++current;
-			Get_Result();
-			return *this;
-		}
-
-		bool operator!=(const Iterator &other) const
-		{
-			return current != other.current;
-		}
 
 	private:
-		void Get_Result()
-		{
-			result = func(*current);
-		}
-		value_type result;
-		Iter current;
-		FUNC func;
+		AggregateByKey aggregate;
+		std::size_t budget;
+		Combine combine;
+		fs::path directory;
 	};
+
 	template <typename Container>
-	struct View
+	auto apply(Container &&container) const
 	{
-		std::shared_ptr<Container> container;
-		const FUNC &func;
-		auto begin() const
+		using Item = decltype(*container.begin());
+		using Key = std::decay_t<invoke_token_result_t<const KeyExtractor &, Item>>;
+		static_assert(!dangles_after_v<Container, Key>,
+					  "the files are unmapped when this expression ends, so keys must own their text or the view must be named");
+
+		std::vector<std::pair<Key, Value>> result =
+			partitions > 1 ? aggregate_partitioned<Key>(container) : aggregate<Key>(container);
+		if (sort_keys)
+			std::sort(result.begin(), result.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+		return result;
+	}
+
+private:
+	Value initial;
+	Aggregator aggregator;
+	KeyExtractor keyExtractor;
+	bool sort_keys = false;
+	std::size_t partitions = 1;
+
+	template <typename Item>
+	void fold(Value &value, Item &&item) const
+	{
+		if constexpr (std::is_invocable_v<const Aggregator &, Value &, Item>)
+			aggregator(value, std::forward<Item>(item));
+		else
+			aggregator(std::forward<Item>(item), value);
+	}
+
+	template <typename Key, typename Container>
+	std::vector<std::pair<Key, Value>> aggregate(const Container &container) const
+	{
+		AggregationTable<Key, Value> table;
+		for_each_item(container, [&](const auto &item)
 		{
-			return Iterator<decltype(std::begin(*container))>(
-				std::begin(*container), func);
-		}
+			Key key = invoke_token(keyExtractor, item);
+			std::uint64_t hash = AggregationTable<Key, Value>::hash(key);
+			fold(table.find_or_insert(std::move(key), hash, initial), item);
+		});
+		return std::move(table).take();
+	}
 
-		auto end() const
+	template <typename Key, typename Container>
+	std::vector<std::pair<Key, Value>> aggregate_partitioned(const Container &container) const
+	{
+		using Stored = std::decay_t<decltype(*container.begin())>;
+		using Table = AggregationTable<Key, Value>;
+		struct Pending
 		{
-			return Iterator<decltype(std::begin(*container))>(
-				std::end(*container), func);
+			std::uint64_t hash;
+			Key key;
+			Stored item;
+		};
+		// A key's value, with the position of its first item.
+		struct Seen
+		{
+			std::size_t first;
+			Value value;
+		};
+
+		std::vector<std::vector<Pending>> scattered(partitions);
+		std::vector<std::vector<std::size_t>> positions(partitions);
+		std::size_t position = 0;
+		for_each_item(container, [&](const auto &item)
+		{
+			Key key = invoke_token(keyExtractor, item);
+			std::uint64_t hash = Table::hash(key);
+			std::size_t part = static_cast<std::size_t>(((hash >> 32) * partitions) >> 32);
+			scattered[part].push_back(Pending{hash, std::move(key), item});
+			positions[part].push_back(position++);
+		});
+
+		std::vector<std::vector<std::pair<Key, Seen>>> folded(partitions);
+		{
+			TaskPool pool(partitions, partitions);
+			for (std::size_t part = 0; part < partitions; ++part)
+			{
+				pool.submit([&, part](std::size_t) {
+					AggregationTable<Key, Seen> table;
+					Seen fresh{0, initial};
+					for (std::size_t i = 0; i < scattered[part].size(); ++i)
+					{
+						Pending &pending = scattered[part][i];
+						fresh.first = positions[part][i];
+						fold(table.find_or_insert(std::move(pending.key), pending.hash, fresh).value, pending.item);
+					}
+					folded[part] = std::move(table).take();
+				});
+			}
+			pool.wait();
 		}
-	};
 
-	template <typename Container>
-	View<Container> apply(const Container &container) const
-	{
-		return View<Container>{std::make_shared<Container>(container), func};
+		std::vector<std::pair<Key, Seen>> merged;
+		for (auto &part : folded)
+			std::move(part.begin(), part.end(), std::back_inserter(merged));
+		std::sort(merged.begin(), merged.end(), [](const auto &a, const auto &b) { return a.second.first < b.second.first; });
+		std::vector<std::pair<Key, Value>> result;
+		result.reserve(merged.size());
+		for (auto &[key, seen] : merged)
+			result.emplace_back(std::move(key), std::move(seen.value));
+		return result;
 	}
+};
 
+class Out
+{	
+public:
+	Out(std::ostream &output) : output(output) {}
+	template<class container>
+	void apply(const container& obj){
+		for_each_item(obj, [&](const auto &elemets){
+			output << elemets << std::endl;
+		});
+	}
 private:
-	FUNC func;
+	std::ostream &output;
 };
 
-template <typename Aggregator, typename KeyExtractor>
-class AggregateByKey
+template <typename T>
+struct is_aggregate_by_key : std::false_type {};
+
+template <typename... Parts>
+struct is_aggregate_by_key<AggregateByKey<Parts...>> : std::true_type
+{
+	// Whether it is the counting form, whose per-file counts can be summed.
+	static constexpr bool counts = sizeof...(Parts) == 2;
+};
+
+// The stages between Parallel and the closing AggregateByKey. Nothing runs
+// until the AggregateByKey is chained; then every file becomes a task that
+// runs OpenFiles and the following stages over that file alone and counts
+// its keys into the partial map of the worker it ran on. When Split comes
+// right after OpenFiles, a file larger than chunk_bytes is cut into chunks
+// at delimiters, one task each. The partial maps are merged at the end, so
+// the result is the one the sequential pipeline gives.
+template <typename Files, typename... Stages>
+class ParallelFiles
 {
 public:
-	AggregateByKey(Aggregator aggregator, KeyExtractor keyExtractor)
-		: aggregator(std::move(aggregator)), keyExtractor(std::move(keyExtractor)) {}
+	ParallelFiles(Upstream<Files> files, std::size_t threads, std::uintmax_t chunk_bytes, std::tuple<Stages...> stages)
+		: files(std::move(files)), threads(threads), chunk_bytes(chunk_bytes), stages(std::move(stages)) {}
 
-	template <typename Container>
-	auto apply(const Container &container) const
+	template <typename Stage>
+	auto chain(Stage &&stage) &&
 	{
-		using Item = decltype(*container.begin());
-		using Key = std::decay_t<decltype(keyExtractor(std::declval<Item>()))>;
-		using Value = std::size_t;
+		using Next = std::decay_t<Stage>;
+		if constexpr (is_aggregate_by_key<Next>::value)
+		{
+			// The general form folds every key's items in input order and has
+			// no way to combine folds taken over separate files.
+			static_assert(is_aggregate_by_key<Next>::counts,
+						  "Parallel() must end in the counting AggregateByKey(aggregator, key); "
+						  "fold the general form with AggregateByKey(initial, aggregator, key).partitioned(threads)");
+			if constexpr (is_aggregate_by_key<Next>::counts)
+				return run(stage);
+		}
+		else
+			return ParallelFiles<Files, Stages..., Next>(
+				std::move(files), threads, chunk_bytes,
+				std::tuple_cat(std::move(stages), std::tuple<Next>(std::forward<Stage>(stage))));
+	}
 
-		std::map<Key, Value> result;
+private:
+	using Entry = std::array<fs::directory_entry, 1>;
+	using Chunk = std::vector<std::istringstream>;
+
+	static constexpr bool splits_first = [] {
+		if constexpr (sizeof...(Stages) >= 2)
+			return std::is_same_v<std::tuple_element_t<1, std::tuple<Stages...>>, Split>;
+		else
+			return false;
+	}();
+
+	Upstream<Files> files;
+	std::size_t threads;
+	std::uintmax_t chunk_bytes;
+	std::tuple<Stages...> stages;
+
+	auto through(Entry &&file) const
+	{
+		return std::apply([&](const auto &...stage) { return (std::move(file) | ... | stage); }, stages);
+	}
+
+	// The stages after OpenFiles, over a chunk read by read_chunk.
+	auto through(Chunk &&chunk) const
+	{
+		return [&]<std::size_t... I>(std::index_sequence<I...>) {
+			return (std::move(chunk) | ... | std::get<I + 1>(stages));
+		}(std::make_index_sequence<sizeof...(Stages) - 1>{});
+	}
 
-		for (const auto &item : container)
+	// The text of the tokens that start in [begin, end) of the file. A
+	// token running into the chunk belongs to the previous one, and the
+	// last token is read to its end even past `end`.
+	static std::string read_chunk(const fs::path &path, std::uintmax_t begin, std::uintmax_t end, const Split &split)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+			return {};
+		std::uintmax_t from = begin == 0 ? 0 : begin - 1;
+		file.seekg(static_cast<std::streamoff>(from));
+		std::string text(end - from, '\0');
+		file.read(text.data(), static_cast<std::streamsize>(text.size()));
+		text.resize(static_cast<std::size_t>(file.gcount()));
+
+		std::size_t start = 0;
+		if (begin != 0)
 		{
-			Key key = keyExtractor(item);
-			auto it = result.find(key);
+			if (text.empty())
+				return {};
+			start = 1;
+			if (!split.is_delimiter(text[0]))
+				while (start < text.size() && !split.is_delimiter(text[start]))
+					++start;
+			if (start == text.size())
+				return {};
+		}
 
-			if (it != result.end())
-			{
-				aggregator(it->second);
-			}
-			else
+		char ch;
+		if (!split.is_delimiter(text.back()))
+			while (file.get(ch) && !split.is_delimiter(ch))
+				text += ch;
+		return text.substr(start);
+	}
+
+	template <typename Aggregate>
+	auto run(const Aggregate &aggregate) const
+	{
+		static_assert(sizeof...(Stages) > 0 && (std::is_same_v<std::tuple_element_t<0, std::tuple<Stages...>>, OpenFiles> ||
+												std::is_same_v<std::tuple_element_t<0, std::tuple<Stages...>>, MapFiles>),
+					  "Parallel must be followed by OpenFiles or MapFiles");
+		using Key = typename Aggregate::template KeyOf<decltype(through(std::declval<Entry>()))>;
+		static_assert(!std::is_same_v<Key, std::string_view>,
+					  "a task unmaps its file when done, so keys must own their text");
+
+		std::size_t workers = threads == 0 ? 1 : threads;
+		std::vector<std::map<Key, std::size_t>> partial(workers);
+		{
+			TaskPool pool(workers, 4 * workers);
+			for (const auto &entry : files.get())
 			{
-				result[key] = 1; // начинаем с 1
+				fs::directory_entry file(entry);
+				if (!file.is_regular_file())
+					continue;
+
+				if constexpr (splits_first)
+				{
+					std::uintmax_t size = file.file_size();
+					if (chunk_bytes != 0 && size > chunk_bytes)
+					{
+						for (std::uintmax_t begin = 0; begin < size; begin += chunk_bytes)
+						{
+							std::uintmax_t end = std::min(size, begin + chunk_bytes);
+							pool.submit([this, &aggregate, &partial, path = file.path(), begin, end](std::size_t worker) {
+								Chunk chunk;
+								chunk.emplace_back(read_chunk(path, begin, end, std::get<1>(stages)));
+								aggregate.count(through(std::move(chunk)), partial[worker]);
+							});
+						}
+						continue;
+					}
+				}
+
+				pool.submit([this, &aggregate, &partial, file](std::size_t worker) {
+					aggregate.count(through(Entry{file}), partial[worker]);
+				});
 			}
+			pool.wait();
 		}
 
-		return result;
+		std::map<Key, std::size_t> counts;
+		for (auto &part : partial)
+			for (auto &[key, occurrences] : part)
+				counts[key] += occurrences;
+		return aggregate.finish(std::move(counts));
 	}
-
-private:
-	Aggregator aggregator;
-	KeyExtractor keyExtractor;
 };
 
-class Out
-{	
+// Runs the file-level stages that follow it on a thread pool, see
+// ParallelFiles. The pipeline has to read
+// ... | Parallel() | OpenFiles() | ... | AggregateByKey(aggregator, key),
+// or the same with MapFiles.
+class Parallel
+{
 public:
-	Out(std::ostream &output) : output(output) {}
-	template<class container>
-	void apply(const container& obj){
-		for(auto&& elemets : obj){
-			output << elemets << std::endl;
-		}
+	Parallel(std::size_t threads = std::thread::hardware_concurrency(), std::uintmax_t chunk_bytes = 8 << 20)
+		: threads(threads), chunk_bytes(chunk_bytes) {}
+
+	template <typename Container>
+	ParallelFiles<Container> apply(Container &&container) const
+	{
+		return ParallelFiles<Container>(Upstream<Container>(std::forward<Container>(container)), threads, chunk_bytes, {});
 	}
+
 private:
-	std::ostream &output;
+	std::size_t threads;
+	std::uintmax_t chunk_bytes;
 };
 
 
@@ -551,6 +2280,8 @@ struct JoinResult {
     
     JoinResult(std::optional<L> l, std::optional<R> r) 
         : left(std::move(l)), right(std::move(r)) {}
+
+    bool operator==(const JoinResult& other) const = default;
 };
 
 template <typename T, typename Source>
@@ -577,8 +2308,471 @@ private:
     Source source_;
 };
 
+enum class JoinKind { Inner, Left, Right, Full };
+
+enum class JoinStrategy {
+    Hash,       // builds a table of the right side in memory
+    SortMerge,  // both sides sorted by key; holds one group of equal right keys
+    GraceHash   // as Hash, partitioning both sides to disk past memory_budget
+};
+
+struct JoinOptions {
+    JoinKind kind = JoinKind::Left;
+    JoinStrategy strategy = JoinStrategy::Hash;
+    std::size_t memory_budget = std::size_t{64} << 20;  // bytes of right records, GraceHash only
+    std::size_t partitions = 16;
+    fs::path directory = fs::temp_directory_path();
+};
+
+// Join(right) joins KV items on their keys and yields their values.
+struct KVSide {
+    template <typename T>
+    const auto& key(const T& item) const { return item.key; }
+    template <typename T>
+    const auto& payload(const T& item) const { return item.value; }
+};
+
+// Join(right, left_key, right_key) joins any items on the given keys and
+// yields the items themselves.
+template <typename KeyFn>
+struct KeySide {
+    KeyFn fn;
+    template <typename T>
+    auto key(const T& item) const { return fn(item); }
+    template <typename T>
+    const T& payload(const T& item) const { return item; }
+};
+
+// The result of Join, produced while it is read. Every left item is paired
+// with every right item of an equal key, in the order of the left side and
+// then of the right; Left and Full add unmatched left items with no right.
+// Right and Full add unmatched right items with no left: Hash and GraceHash
+// after the left side is done, SortMerge, which never holds more than one
+// key's right items, where their key falls among the left keys. GraceHash
+// once over its budget yields one partition after another, so only the
+// pairs of a key keep that order.
+template <typename Left, typename Right, typename LeftSide, typename RightSide>
+class JoinView {
+    using LeftIter = decltype(std::begin(std::declval<Upstream<Left>&>().get()));
+    using RightIter = decltype(std::begin(std::declval<Upstream<Right>&>().get()));
+    using Key = std::decay_t<decltype(std::declval<const LeftSide&>().key(*std::declval<LeftIter&>()))>;
+    using LeftValue = std::decay_t<decltype(std::declval<const LeftSide&>().payload(*std::declval<LeftIter&>()))>;
+    using RightValue = std::decay_t<decltype(std::declval<const RightSide&>().payload(*std::declval<RightIter&>()))>;
+
+public:
+    using Result = JoinResult<LeftValue, RightValue>;
+
+    class Iterator {
+    public:
+        using value_type = Result;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+        using iterator_category = std::input_iterator_tag;
+
+        Iterator() = default;
+        explicit Iterator(const JoinView* view) : view_(view) {}
+
+        reference operator*() const { return *view_->current_; }
+        pointer operator->() const { return &*view_->current_; }
+
+        Iterator& operator++() {
+            view_->advance();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const { return finished() == other.finished(); }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+    private:
+        const JoinView* view_ = nullptr;
+
+        bool finished() const { return !view_ || !view_->current_; }
+    };
+
+    JoinView(Upstream<Left> left, Upstream<Right> right, LeftSide left_side, RightSide right_side, JoinOptions options)
+        : left_(std::move(left)), right_(std::move(right)), left_side_(std::move(left_side)),
+          right_side_(std::move(right_side)), options_(std::move(options)) {}
+
+    Iterator begin() const {
+        if (!cursor_) {
+            if (options_.strategy == JoinStrategy::SortMerge) {
+                cursor_ = std::make_unique<Cursor>(std::in_place_type<MergeCursor>, *this);
+            } else {
+                cursor_ = std::make_unique<Cursor>(std::in_place_type<HashCursor>, *this);
+            }
+            advance();
+        }
+        return Iterator(this);
+    }
+
+    Iterator end() const { return Iterator(); }
+
+private:
+    bool emits_left() const { return options_.kind == JoinKind::Left || options_.kind == JoinKind::Full; }
+    bool emits_right() const { return options_.kind == JoinKind::Right || options_.kind == JoinKind::Full; }
+
+    // Hash and GraceHash. The right side is read into a table, or, once it
+    // takes more than the budget, into partition files along with the
+    // whole left side; the partitions are then joined one at a time.
+    class HashCursor {
+    public:
+        explicit HashCursor(const JoinView& view)
+            : view_(view), left_it_(std::begin(view.left_.get())), left_end_(std::end(view.left_.get())) {
+            build();
+        }
+
+        HashCursor(const HashCursor&) = delete;
+        HashCursor& operator=(const HashCursor&) = delete;
+
+        ~HashCursor() {
+            left_in_.close();
+            std::error_code ignored;
+            for (const auto& path : files_) {
+                fs::remove(path, ignored);
+            }
+        }
+
+        std::optional<Result> next() {
+            while (true) {
+                if (matches_ && match_ < matches_->size()) {
+                    std::size_t i = (*matches_)[match_++];
+                    matched_[i] = true;
+                    return Result(left_, rights_[i].second);
+                }
+                matches_ = nullptr;
+
+                if (!lefts_done_) {
+                    if (auto pulled = pull_left()) {
+                        left_ = std::move(pulled->second);
+                        matches_ = index_.find(pulled->first, Table::hash(pulled->first));
+                        match_ = 0;
+                        if (!matches_ && view_.emits_left()) {
+                            return Result(std::move(left_), std::nullopt);
+                        }
+                        continue;
+                    }
+                    lefts_done_ = true;
+                    unmatched_ = 0;
+                }
+
+                if (view_.emits_right()) {
+                    while (unmatched_ < rights_.size()) {
+                        std::size_t i = unmatched_++;
+                        if (!matched_[i]) {
+                            return Result(std::nullopt, rights_[i].second);
+                        }
+                    }
+                }
+
+                if (spilled_ && ++partition_ < partitions()) {
+                    load(partition_);
+                    continue;
+                }
+                return std::nullopt;
+            }
+        }
+
+    private:
+        using Table = AggregationTable<Key, std::vector<std::size_t>>;
+
+        const JoinView& view_;
+        LeftIter left_it_, left_end_;
+        std::vector<std::pair<Key, RightValue>> rights_;
+        std::vector<bool> matched_;
+        Table index_;
+        std::optional<LeftValue> left_;
+        const std::vector<std::size_t>* matches_ = nullptr;
+        std::size_t match_ = 0;
+        std::size_t unmatched_ = 0;
+        bool lefts_done_ = false;
+
+        bool spilled_ = false;
+        std::size_t partition_ = 0;
+        std::vector<fs::path> files_;  // the right partitions, then the left ones
+        std::ifstream left_in_;
+
+        std::size_t partitions() const { return view_.options_.partitions == 0 ? 1 : view_.options_.partitions; }
+
+        std::size_t partition_of(const Key& key) const {
+            return static_cast<std::size_t>(((Table::hash(key) >> 32) * partitions()) >> 32);
+        }
+
+        void build() {
+            std::size_t budget = view_.options_.strategy == JoinStrategy::GraceHash ? view_.options_.memory_budget
+                                                                                   : SIZE_MAX;
+            std::size_t used = 0;
+            std::vector<std::ofstream> outs;
+            for (const auto& item : view_.right_.get()) {
+                Key key = view_.right_side_.key(item);
+                RightValue value = view_.right_side_.payload(item);
+                if (spilled_) {
+                    write(outs[partition_of(key)], key, value);
+                    continue;
+                }
+                used += sizeof(std::pair<Key, RightValue>) + spill_heap_size(key) + spill_heap_size(value) +
+                        4 * sizeof(std::uint64_t);
+                rights_.emplace_back(std::move(key), std::move(value));
+                if (used > budget) {
+                    outs = open(0);
+                    for (const auto& [spilled_key, spilled_value] : rights_) {
+                        write(outs[partition_of(spilled_key)], spilled_key, spilled_value);
+                    }
+                    rights_.clear();
+                    spilled_ = true;
+                }
+            }
+
+            if (!spilled_) {
+                index();
+                return;
+            }
+            close(outs);
+            outs = open(partitions());
+            for (; left_it_ != left_end_; ++left_it_) {
+                Key key = view_.left_side_.key(*left_it_);
+                write(outs[partition_of(key)], key, view_.left_side_.payload(*left_it_));
+            }
+            close(outs);
+            load(0);
+        }
+
+        std::vector<std::ofstream> open(std::size_t first) {
+            static std::atomic<std::uint64_t> joins{0};
+            std::string name = "join-" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + "-" +
+                               std::to_string(joins++) + "-";
+            std::vector<std::ofstream> outs;
+            for (std::size_t i = 0; i < partitions(); ++i) {
+                files_.push_back(view_.options_.directory / (name + std::to_string(first + i) + ".part"));
+                outs.emplace_back(files_.back(), std::ios::binary | std::ios::trunc);
+            }
+            return outs;
+        }
+
+        void close(std::vector<std::ofstream>& outs) {
+            for (auto& out : outs) {
+                if (!out.flush()) {
+                    throw std::runtime_error("Join: cannot write a partition file");
+                }
+            }
+            outs.clear();
+        }
+
+        // Whether records of a side can be written to a partition and read
+        // back into default-constructed ones.
+        template <typename Value>
+        static constexpr bool round_trips = spillable<Key> && spillable<Value> &&
+                                            std::is_default_constructible_v<Key> &&
+                                            std::is_default_constructible_v<Value>;
+
+        template <typename Value>
+        static void write(std::ostream& out, const Key& key, const Value& value) {
+            if constexpr (round_trips<Value>) {
+                spill_write(out, key);
+                spill_write(out, value);
+            } else {
+                throw std::runtime_error("Join: the right side exceeds the memory budget, and the keys or values "
+                                         "of a side cannot be written to disk and read back");
+            }
+        }
+
+        template <typename Value>
+        static bool read(std::istream& in, Key& key, Value& value) {
+            if constexpr (round_trips<Value>) {
+                return spill_read(in, key) && spill_read(in, value);
+            } else {
+                return false;
+            }
+        }
+
+        // Reads the right records of partition `p` and opens its left ones.
+        void load(std::size_t p) {
+            rights_.clear();
+            if constexpr (round_trips<RightValue>) {
+                std::ifstream in(files_[p], std::ios::binary);
+                std::pair<Key, RightValue> record;
+                while (read(in, record.first, record.second)) {
+                    rights_.push_back(std::move(record));
+                }
+            }
+            index();
+            left_in_.close();
+            left_in_.clear();
+            left_in_.open(files_[partitions() + p], std::ios::binary);
+            lefts_done_ = false;
+        }
+
+        void index() {
+            index_ = Table();
+            matched_.assign(rights_.size(), false);
+            for (std::size_t i = 0; i < rights_.size(); ++i) {
+                Key key = rights_[i].first;
+                std::uint64_t hash = Table::hash(key);
+                index_.find_or_insert(std::move(key), hash, {}).push_back(i);
+            }
+        }
+
+        std::optional<std::pair<Key, LeftValue>> pull_left() {
+            if (!spilled_) {
+                if (!(left_it_ != left_end_)) {
+                    return std::nullopt;
+                }
+                std::pair<Key, LeftValue> pulled(view_.left_side_.key(*left_it_), view_.left_side_.payload(*left_it_));
+                ++left_it_;
+                return pulled;
+            }
+            if constexpr (round_trips<LeftValue>) {
+                std::pair<Key, LeftValue> pulled;
+                if (read(left_in_, pulled.first, pulled.second)) {
+                    return pulled;
+                }
+            }
+            return std::nullopt;
+        }
+    };
+
+    // SortMerge. Walks both sides, sorted by key, in step; the right items
+    // of the current key are kept so that they can be paired with every
+    // left item of that key.
+    class MergeCursor {
+    public:
+        explicit MergeCursor(const JoinView& view)
+            : view_(view), left_it_(std::begin(view.left_.get())), left_end_(std::end(view.left_.get())),
+              right_it_(std::begin(view.right_.get())), right_end_(std::end(view.right_.get())) {}
+
+        std::optional<Result> next() {
+            while (true) {
+                if (left_ && match_ < group_.size()) {
+                    return Result(left_, group_[match_++]);
+                }
+                if (left_) {
+                    left_.reset();
+                    ++left_it_;
+                }
+
+                std::optional<Key> key;
+                if (left_it_ != left_end_) {
+                    key = view_.left_side_.key(*left_it_);
+                }
+                if (!group_.empty() && !(key && *key == group_key_)) {
+                    group_.clear();
+                }
+                if (!key) {
+                    if (right_it_ != right_end_ && view_.emits_right()) {
+                        RightValue value = view_.right_side_.payload(*right_it_);
+                        ++right_it_;
+                        return Result(std::nullopt, std::move(value));
+                    }
+                    return std::nullopt;
+                }
+
+                if (!group_.empty()) {
+                    left_ = view_.left_side_.payload(*left_it_);
+                    match_ = 0;
+                    continue;
+                }
+                if (right_it_ != right_end_ && view_.right_side_.key(*right_it_) < *key) {
+                    RightValue value = view_.right_side_.payload(*right_it_);
+                    ++right_it_;
+                    if (view_.emits_right()) {
+                        return Result(std::nullopt, std::move(value));
+                    }
+                    continue;
+                }
+                if (right_it_ != right_end_ && view_.right_side_.key(*right_it_) == *key) {
+                    group_key_ = *key;
+                    while (right_it_ != right_end_ && view_.right_side_.key(*right_it_) == *key) {
+                        group_.push_back(view_.right_side_.payload(*right_it_));
+                        ++right_it_;
+                    }
+                    continue;
+                }
+
+                if (view_.emits_left()) {
+                    LeftValue value = view_.left_side_.payload(*left_it_);
+                    ++left_it_;
+                    return Result(std::move(value), std::nullopt);
+                }
+                ++left_it_;
+            }
+        }
+
+    private:
+        const JoinView& view_;
+        LeftIter left_it_, left_end_;
+        RightIter right_it_, right_end_;
+        std::vector<RightValue> group_;
+        std::optional<Key> group_key_;
+        std::optional<LeftValue> left_;
+        std::size_t match_ = 0;
+    };
+
+    using Cursor = std::variant<HashCursor, MergeCursor>;
+
+    Upstream<Left> left_;
+    Upstream<Right> right_;
+    LeftSide left_side_;
+    RightSide right_side_;
+    JoinOptions options_;
+    mutable std::unique_ptr<Cursor> cursor_;
+    mutable std::optional<Result> current_;
+
+    void advance() const {
+        current_ = std::visit([](auto& cursor) { return cursor.next(); }, *cursor_);
+    }
+};
+
+// Join(right[, options]) joins KV items; Join(right, left_key, right_key
+// [, options]) joins any items on the keys the functions return. The
+// options pick the kind of join and the strategy, see JoinOptions.
+// Join<K, L, R, LeftSource, RightSource>, made by make_join, is the older
+// left join that keeps one right value per key.
+template <typename... Parts>
+class Join;
+
+template <typename Right>
+Join(Right&&) -> Join<Right, KVSide, KVSide>;
+
+template <typename Right>
+Join(Right&&, JoinOptions) -> Join<Right, KVSide, KVSide>;
+
+template <typename Right, typename LeftKey, typename RightKey>
+Join(Right&&, LeftKey, RightKey) -> Join<Right, KeySide<LeftKey>, KeySide<RightKey>>;
+
+template <typename Right, typename LeftKey, typename RightKey>
+Join(Right&&, LeftKey, RightKey, JoinOptions) -> Join<Right, KeySide<LeftKey>, KeySide<RightKey>>;
+
+template <typename Right, typename LeftSide, typename RightSide>
+class Join<Right, LeftSide, RightSide> {
+public:
+    explicit Join(Right&& right, JoinOptions options = {})
+        : right_(std::forward<Right>(right)), options_(std::move(options)) {}
+
+    template <typename LeftKey, typename RightKey>
+    Join(Right&& right, LeftKey left_key, RightKey right_key, JoinOptions options = {})
+        : right_(std::forward<Right>(right)), left_side_{std::move(left_key)}, right_side_{std::move(right_key)},
+          options_(std::move(options)) {}
+
+    template <typename Left>
+    JoinView<Left, Right, LeftSide, RightSide> apply(Left&& left) const& {
+        return {Upstream<Left>(std::forward<Left>(left)), right_, left_side_, right_side_, options_};
+    }
+
+    template <typename Left>
+    JoinView<Left, Right, LeftSide, RightSide> apply(Left&& left) && {
+        return {Upstream<Left>(std::forward<Left>(left)), std::move(right_), std::move(left_side_),
+                std::move(right_side_), std::move(options_)};
+    }
+
+private:
+    Upstream<Right> right_;
+    LeftSide left_side_;
+    RightSide right_side_;
+    JoinOptions options_;
+};
+
 template <typename K, typename L, typename R, typename LeftSource, typename RightSource>
-class Join {
+class Join<K, L, R, LeftSource, RightSource> {
 public:
     Join(LeftSource left, RightSource right) 
         : left_(std::move(left)), right_(std::move(right)) {}
@@ -623,18 +2817,33 @@ auto make_join(LeftSource&& left, RightSource&& right) {
     );
 }
 template<class OBJ_>
-std::vector<typename OBJ_::value_type >As_Vector(OBJ_&& obj) {
+auto As_Vector(OBJ_&& obj) {
     using value_type = typename std::iterator_traits<
         decltype(std::begin(obj))>::value_type;
-    
-    return std::vector<value_type>(
-        std::make_move_iterator(std::begin(obj)),
-        std::make_move_iterator(std::end(obj))
-    );
+    static_assert(!dangles_after_v<OBJ_, value_type>,
+                  "the files are unmapped when this expression ends, so name the view or transform items to std::string");
+
+    if constexpr (batched_range<OBJ_>) {
+        std::vector<value_type> result;
+        for_each_item(obj, [&](const value_type& item) { result.push_back(item); });
+        return result;
+    } else {
+        return std::vector<value_type>(
+            std::make_move_iterator(std::begin(obj)),
+            std::make_move_iterator(std::end(obj))
+        );
+    }
 }
+// A range that collects the stages after it, like ParallelFiles, takes them
+// through chain instead of being wrapped by them.
 template <typename USED, typename USE>
+	requires requires(USED &&range, USE &&filter) { std::forward<USED>(range).chain(std::forward<USE>(filter)); } ||
+			 requires(USED &&range, USE &&filter) { std::forward<USE>(filter).apply(std::forward<USED>(range)); }
 auto operator|(USED &&range, USE &&filter)
 {
-	return filter.apply(range);
+	if constexpr (requires { std::forward<USED>(range).chain(std::forward<USE>(filter)); })
+		return std::forward<USED>(range).chain(std::forward<USE>(filter));
+	else
+		return std::forward<USE>(filter).apply(std::forward<USED>(range));
 }
 
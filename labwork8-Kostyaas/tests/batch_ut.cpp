@@ -0,0 +1,91 @@
+#include <processing.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <list>
+#include <numeric>
+#include <sstream>
+
+namespace {
+
+auto Odd() {
+    return Filter([](int x) { return x % 2 != 0; });
+}
+
+auto Square() {
+    return Transform([](int x) { return x * x; });
+}
+
+} // namespace
+
+TEST(BatchTest, SameResultAsElementwise) {
+    std::vector<int> input(10000);
+    std::iota(input.begin(), input.end(), -5000);
+    auto elementwise = As_Vector(input | Odd() | Square() | Filter([](int x) { return x % 3 == 0; }));
+    for (std::size_t size : {1, 2, 7, 1024, 20000}) {
+        auto batched = As_Vector(input | Batched(size) | Odd() | Square() | Filter([](int x) { return x % 3 == 0; }));
+        ASSERT_EQ(batched, elementwise) << size;
+    }
+}
+
+TEST(BatchTest, ContiguousInputIsNotCopied) {
+    std::vector<int> input = {1, 2, 3, 4, 5};
+    auto view = input | Batched(2);
+    auto batch = view.next_batch();
+    ASSERT_TRUE(batch);
+    ASSERT_EQ(batch->values, input.data());
+    ASSERT_EQ(batch->size(), 2u);
+    batch = view.next_batch();
+    ASSERT_EQ(batch->values, input.data() + 2);
+    batch = view.next_batch();
+    ASSERT_EQ(batch->size(), 1u);
+    ASSERT_FALSE(view.next_batch());
+}
+
+TEST(BatchTest, FilterProducesSelection) {
+    std::vector<int> input = {1, 2, 3, 4, 5, 6};
+    auto view = input | Batched(4) | Odd();
+    auto batch = view.next_batch();
+    ASSERT_TRUE(batch);
+    ASSERT_EQ(batch->values, input.data());
+    ASSERT_THAT(std::vector<std::uint32_t>(batch->selection, batch->selection + batch->size()),
+                testing::ElementsAre(0, 2));
+    batch = view.next_batch();
+    ASSERT_THAT(std::vector<std::uint32_t>(batch->selection, batch->selection + batch->size()),
+                testing::ElementsAre(0));
+    ASSERT_EQ((*batch)[0], 5);
+    ASSERT_FALSE(view.next_batch());
+}
+
+TEST(BatchTest, SkipsBatchesFilteredEmpty) {
+    std::vector<int> input = {2, 4, 6, 8, 1, 10};
+    auto view = input | Batched(2) | Odd();
+    auto batch = view.next_batch();
+    ASSERT_TRUE(batch);
+    ASSERT_EQ(batch->size(), 1u);
+    ASSERT_EQ((*batch)[0], 1);
+    ASSERT_FALSE(view.next_batch());
+}
+
+TEST(BatchTest, NonContiguousInput) {
+    std::list<int> input = {1, 2, 3, 4, 5};
+    ASSERT_THAT(As_Vector(input | Batched(2) | Square()), testing::ElementsAre(1, 4, 9, 16, 25));
+}
+
+TEST(BatchTest, ElementwiseStagesReadBatchedViews) {
+    std::vector<std::string> input = {"a", "bb", "a", "ccc", "bb", "a"};
+    auto counted = input | Batched(4) | Transform([](const std::string& s) { return s + "!"; }) |
+                   AggregateByKey([](size_t& count) { ++count; }, [](const std::string& s) { return s; });
+    ASSERT_THAT(counted, testing::ElementsAre(std::make_pair("a!", 3), std::make_pair("bb!", 2), std::make_pair("ccc!", 1)));
+
+    std::stringstream out;
+    input | Batched(3) | Filter([](const std::string& s) { return s.size() > 1; }) | Out(out);
+    ASSERT_EQ(out.str(), "bb\nccc\nbb\n");
+
+    std::vector<std::string> seen;
+    for (const std::string& s : input | Batched(5) | Filter([](const std::string& s) { return s != "a"; })) {
+        seen.push_back(s);
+    }
+    ASSERT_THAT(seen, testing::ElementsAre("bb", "ccc", "bb"));
+}
@@ -0,0 +1,102 @@
+#include <processing.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <list>
+#include <numeric>
+#include <string>
+
+namespace {
+
+auto Odd() {
+    return Filter([](int x) { return x % 2 != 0; });
+}
+
+auto Square() {
+    return Transform([](int x) { return x * x; });
+}
+
+template <typename T>
+struct is_fused_view : std::false_type {};
+
+template <typename Container, typename... Steps>
+struct is_fused_view<Fused<Container, Steps...>> : std::true_type {
+    static constexpr std::size_t steps = sizeof...(Steps);
+};
+
+} // namespace
+
+TEST(FusionTest, AdjacentStagesBecomeOneView) {
+    std::vector<int> input = {1, 2, 3};
+    auto view = input | Odd() | Square() | Filter([](int x) { return x > 1; }) | Transform([](int x) { return x + 1; });
+    using View = decltype(view);
+    static_assert(is_fused_view<View>::value);
+    static_assert(is_fused_view<View>::steps == 4);
+    static_assert(std::is_same_v<std::iterator_traits<decltype(view.begin())>::value_type, int>);
+    ASSERT_THAT(As_Vector(view), testing::ElementsAre(10));
+}
+
+TEST(FusionTest, SameResultAsHandWrittenLoop) {
+    std::list<int> input(1000);
+    std::iota(input.begin(), input.end(), -500);
+    std::vector<std::string> expected;
+    for (int x : input) {
+        if (x % 2 == 0)
+            continue;
+        int squared = x * x;
+        if (squared % 3 != 0)
+            continue;
+        expected.push_back(std::to_string(squared + 1));
+    }
+    auto view = input | Odd() | Square() | Filter([](int x) { return x % 3 == 0; }) |
+                Transform([](int x) { return x + 1; }) | Transform([](int x) { return std::to_string(x); });
+    ASSERT_EQ(As_Vector(view), expected);
+    std::vector<std::string> iterated;
+    for (const auto& item : view)
+        iterated.push_back(item);
+    ASSERT_EQ(iterated, expected);
+}
+
+TEST(FusionTest, TrailingTransformsRunOnDereference) {
+    std::vector<int> input = {1, 2, 3, 4, 5};
+    int calls = 0;
+    auto view = input | Odd() | Transform([&](int x) { ++calls; return x * 10; });
+    auto it = view.begin();
+    ++it;
+    ASSERT_EQ(calls, 0);
+    ASSERT_EQ(*it, 30);
+    ASSERT_EQ(*it, 30);
+    ASSERT_EQ(calls, 1);
+    for (auto end = view.end(); it != end; ++it) {
+    }
+    ASSERT_EQ(calls, 1);
+}
+
+TEST(FusionTest, SkippedItemsStopAtTheFirstFailingFilter) {
+    std::vector<int> input = {1, 2, 3, 4, 5, 6};
+    int squared = 0, checked = 0;
+    auto view = input | Odd() | Transform([&](int x) { ++squared; return x * x; }) |
+                Filter([&](int x) { ++checked; return x > 1; });
+    ASSERT_THAT(As_Vector(view), testing::ElementsAre(9, 25));
+    ASSERT_EQ(squared, 3);
+    ASSERT_EQ(checked, 3);
+}
+
+TEST(FusionTest, FilterOnlyChainRefersToTheSource) {
+    std::vector<std::string> input = {"a", "bb", "ccc"};
+    auto view = input | Filter([](const std::string& s) { return s.size() > 1; }) |
+                Filter([](const std::string& s) { return s.size() < 3; });
+    auto it = view.begin();
+    ASSERT_EQ(&*it, &input[1]);
+    ASSERT_EQ(it->size(), 2u);
+}
+
+TEST(FusionTest, NamedViewIsWrappedNotCopied) {
+    std::vector<int> input = {1, 2, 3, 4, 5};
+    auto odd = input | Odd();
+    auto view = odd | Square();
+    static_assert(is_fused_view<decltype(view)>::steps == 1);
+    ASSERT_THAT(As_Vector(view), testing::ElementsAre(1, 9, 25));
+    ASSERT_THAT(As_Vector(odd), testing::ElementsAre(1, 3, 5));
+}
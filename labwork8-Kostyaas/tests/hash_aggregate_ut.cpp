@@ -0,0 +1,96 @@
+#include <processing.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace {
+
+struct Employee {
+    uint64_t department_id;
+    std::string name;
+
+    bool operator==(const Employee& other) const = default;
+};
+
+} // namespace
+
+TEST(HashAggregateTest, KeysInFirstSeenOrder) {
+    std::vector<std::string> input = {"name4", "name0", "name1", "name0", "name2", "name0", "name1"};
+    auto result = input | AggregateByKey(
+                              std::size_t{0},
+                              [](std::size_t& accumulated, const std::string&) { ++accumulated; },
+                              [](const std::string& token) { return token; });
+    ASSERT_THAT(result, testing::ElementsAre(std::make_pair("name4", 1), std::make_pair("name0", 3),
+                                             std::make_pair("name1", 2), std::make_pair("name2", 1)));
+}
+
+TEST(HashAggregateTest, SortedIsOptIn) {
+    std::vector<std::string> input = {"b", "c", "a", "b"};
+    auto result = input | AggregateByKey(
+                              std::size_t{0},
+                              [](std::size_t& accumulated, const std::string&) { ++accumulated; },
+                              [](const std::string& token) { return token; })
+                              .sorted();
+    ASSERT_THAT(result, testing::ElementsAre(std::make_pair("a", 1), std::make_pair("b", 2), std::make_pair("c", 1)));
+}
+
+TEST(HashAggregateTest, ValueOfAnyType) {
+    std::vector<Employee> employees = {{3, "name1"}, {1, "name1"}, {1, "name2"}, {2, "name1"}, {2, "name2"}, {2, "name3"}};
+    auto result = employees | AggregateByKey(
+                                  std::vector<Employee>{},
+                                  [](std::vector<Employee>& accumulated, const Employee& employee) {
+                                      if (accumulated.size() < 2) {
+                                          accumulated.push_back(employee);
+                                      }
+                                  },
+                                  [](const Employee& employee) { return employee.department_id; });
+    ASSERT_THAT(result, testing::ElementsAre(
+                            std::make_pair(3, std::vector<Employee>{{3, "name1"}}),
+                            std::make_pair(1, std::vector<Employee>{{1, "name1"}, {1, "name2"}}),
+                            std::make_pair(2, std::vector<Employee>{{2, "name1"}, {2, "name2"}})));
+}
+
+TEST(HashAggregateTest, AggregatorMayTakeItemFirst) {
+    std::vector<std::string> input = {"x", "y", "x"};
+    auto result = input | AggregateByKey(
+                              0uz,
+                              [](const std::string&, size_t& count) { ++count; },
+                              [](const std::string& token) { return token; });
+    ASSERT_THAT(result, testing::ElementsAre(std::make_pair("x", 2), std::make_pair("y", 1)));
+}
+
+TEST(HashAggregateTest, ManyKeysMatchMap) {
+    std::mt19937 random(7);
+    std::vector<int> input(200000);
+    for (int& value : input) {
+        value = static_cast<int>(random() % 50000) * 64;
+    }
+    std::map<int, long long> expected;
+    for (int value : input) {
+        expected[value] += value % 7;
+    }
+    auto result = input | AggregateByKey(
+                              0LL, [](long long& sum, int value) { sum += value % 7; }, [](int value) { return value; })
+                              .sorted();
+    std::vector<std::pair<int, long long>> sorted(expected.begin(), expected.end());
+    ASSERT_EQ(result, sorted);
+}
+
+TEST(HashAggregateTest, PartitionedMatchesSequential) {
+    std::mt19937 random(11);
+    std::vector<std::string> input(50000);
+    for (auto& token : input) {
+        token = "k" + std::to_string(random() % 3000);
+    }
+    // Keeps the order of the items of each key, so the values show whether
+    // every key was folded in input order.
+    auto history = AggregateByKey(
+        std::string{}, [](std::string& seen, const std::string& token) { seen += token.back(); },
+        [](const std::string& token) { return token.substr(0, token.size() - 1); });
+    auto expected = input | history;
+    for (std::size_t threads : {1, 2, 3, 8}) {
+        ASSERT_EQ(input | history.partitioned(threads), expected) << threads << " threads";
+    }
+}
@@ -0,0 +1,179 @@
+#include <processing.h>
+
+#include "temp_directory.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+struct Student {
+    uint64_t group_id;
+    std::string name;
+
+    bool operator==(const Student& other) const = default;
+};
+
+struct Group {
+    uint64_t id;
+    std::string name;
+
+    bool operator==(const Group& other) const = default;
+};
+
+using Result = JoinResult<std::string, std::string>;
+
+std::vector<KV<int, std::string>> Left() {
+    return {{0, "a"}, {1, "b"}, {1, "c"}, {2, "d"}, {4, "e"}};
+}
+
+std::vector<KV<int, std::string>> Right() {
+    return {{1, "f"}, {1, "g"}, {3, "h"}, {4, "i"}};
+}
+
+JoinOptions Options(JoinKind kind, JoinStrategy strategy) {
+    JoinOptions options;
+    options.kind = kind;
+    options.strategy = strategy;
+    return options;
+}
+
+template <typename Range>
+auto Collect(Range&& range) {
+    std::vector<std::decay_t<decltype(*range.begin())>> results;
+    for (const auto& result : range) {
+        results.push_back(result);
+    }
+    return results;
+}
+
+class JoinStrategiesTest : public testing::TestWithParam<JoinStrategy> {};
+
+} // namespace
+
+TEST_P(JoinStrategiesTest, Inner) {
+    auto left = Left();
+    auto right = Right();
+    auto result = Collect(left | Join(right, Options(JoinKind::Inner, GetParam())));
+    ASSERT_THAT(result, testing::ElementsAre(Result{"b", "f"}, Result{"b", "g"}, Result{"c", "f"}, Result{"c", "g"},
+                                             Result{"e", "i"}));
+}
+
+TEST_P(JoinStrategiesTest, Left) {
+    auto left = Left();
+    auto right = Right();
+    auto result = Collect(left | Join(right, Options(JoinKind::Left, GetParam())));
+    ASSERT_THAT(result, testing::ElementsAre(Result{"a", std::nullopt}, Result{"b", "f"}, Result{"b", "g"},
+                                             Result{"c", "f"}, Result{"c", "g"}, Result{"d", std::nullopt},
+                                             Result{"e", "i"}));
+}
+
+TEST_P(JoinStrategiesTest, RightAndFull) {
+    auto left = Left();
+    auto right = Right();
+    auto right_join = Collect(left | Join(right, Options(JoinKind::Right, GetParam())));
+    auto full_join = Collect(left | Join(right, Options(JoinKind::Full, GetParam())));
+    // Unmatched right items come where their key falls with SortMerge and
+    // after the left side otherwise.
+    if (GetParam() == JoinStrategy::SortMerge) {
+        ASSERT_THAT(right_join, testing::ElementsAre(Result{"b", "f"}, Result{"b", "g"}, Result{"c", "f"},
+                                                     Result{"c", "g"}, Result{std::nullopt, "h"}, Result{"e", "i"}));
+        ASSERT_THAT(full_join,
+                    testing::ElementsAre(Result{"a", std::nullopt}, Result{"b", "f"}, Result{"b", "g"},
+                                         Result{"c", "f"}, Result{"c", "g"}, Result{"d", std::nullopt},
+                                         Result{std::nullopt, "h"}, Result{"e", "i"}));
+    } else {
+        ASSERT_THAT(right_join, testing::ElementsAre(Result{"b", "f"}, Result{"b", "g"}, Result{"c", "f"},
+                                                     Result{"c", "g"}, Result{"e", "i"}, Result{std::nullopt, "h"}));
+        ASSERT_THAT(full_join,
+                    testing::ElementsAre(Result{"a", std::nullopt}, Result{"b", "f"}, Result{"b", "g"},
+                                         Result{"c", "f"}, Result{"c", "g"}, Result{"d", std::nullopt},
+                                         Result{"e", "i"}, Result{std::nullopt, "h"}));
+    }
+}
+
+TEST_P(JoinStrategiesTest, KeyFunctions) {
+    std::vector<Student> students = {{0, "a"}, {1, "b"}, {1, "e"}, {2, "c"}, {3, "d"}};
+    std::vector<Group> groups = {{0, "f"}, {1, "g"}, {3, "i"}};
+    auto result = students | Join(
+                                 groups, [](const Student& student) { return student.group_id; },
+                                 [](const Group& group) { return group.id; }, Options(JoinKind::Left, GetParam()));
+    ASSERT_THAT(Collect(result), testing::ElementsAre(JoinResult<Student, Group>{Student{0, "a"}, Group{0, "f"}},
+                                                      JoinResult<Student, Group>{Student{1, "b"}, Group{1, "g"}},
+                                                      JoinResult<Student, Group>{Student{1, "e"}, Group{1, "g"}},
+                                                      JoinResult<Student, Group>{Student{2, "c"}, std::nullopt},
+                                                      JoinResult<Student, Group>{Student{3, "d"}, Group{3, "i"}}));
+}
+
+INSTANTIATE_TEST_SUITE_P(Strategies, JoinStrategiesTest,
+                         testing::Values(JoinStrategy::Hash, JoinStrategy::SortMerge, JoinStrategy::GraceHash));
+
+TEST(JoinTest, GraceHashSpillsAndMatchesHash) {
+    TempDirectory temp("join_strategies_ut");
+    std::mt19937 random(3);
+    std::vector<KV<int, std::string>> left, right;
+    for (int i = 0; i < 20000; ++i) {
+        left.emplace_back(static_cast<int>(random() % 5000), "l" + std::to_string(i));
+        right.emplace_back(static_cast<int>(random() % 7000), "r" + std::to_string(i));
+    }
+    auto sorted = [](auto&& range) {
+        std::vector<Result> results = Collect(range);
+        std::sort(results.begin(), results.end(), [](const Result& a, const Result& b) {
+            return std::tie(a.left, a.right) < std::tie(b.left, b.right);
+        });
+        return results;
+    };
+    for (JoinKind kind : {JoinKind::Inner, JoinKind::Left, JoinKind::Right, JoinKind::Full}) {
+        JoinOptions grace = Options(kind, JoinStrategy::GraceHash);
+        grace.memory_budget = 4096;
+        grace.partitions = 7;
+        grace.directory = temp.path();
+        auto expected = sorted(left | Join(right, Options(kind, JoinStrategy::Hash)));
+        {
+            auto view = left | Join(right, grace);
+            auto it = view.begin();
+            ASSERT_EQ(temp.Entries(), 14u);
+            ASSERT_TRUE(it != view.end());
+        }
+        ASSERT_EQ(sorted(left | Join(right, grace)), expected);
+    }
+    ASSERT_EQ(temp.Entries(), 0u);
+}
+
+TEST(JoinTest, GraceHashRejectsRecordsItCannotReadBack) {
+    struct Point {
+        explicit Point(int x) : x(x) {}
+        int x;
+    };
+    TempDirectory temp("join_strategies_ut");
+    std::vector<Point> left, right;
+    for (int i = 0; i < 1000; ++i) {
+        left.emplace_back(i);
+        right.emplace_back(i);
+    }
+    JoinOptions grace = Options(JoinKind::Inner, JoinStrategy::GraceHash);
+    grace.memory_budget = 1024;
+    grace.directory = temp.path();
+    auto key = [](const Point& point) { return point.x; };
+    ASSERT_EQ(Collect(left | Join(right, key, key, Options(JoinKind::Inner, JoinStrategy::Hash))).size(), 1000u);
+    ASSERT_THROW(Collect(left | Join(right, key, key, grace)), std::runtime_error);
+}
+
+TEST(JoinTest, SortMergeMatchesHashOnSortedInput) {
+    std::mt19937 random(9);
+    std::vector<KV<int, std::string>> left, right;
+    for (int i = 0; i < 3000; ++i) {
+        left.emplace_back(static_cast<int>(random() % 400), "l" + std::to_string(i));
+        right.emplace_back(static_cast<int>(random() % 500), "r" + std::to_string(i));
+    }
+    auto by_key = [](const auto& a, const auto& b) { return a.key < b.key; };
+    std::stable_sort(left.begin(), left.end(), by_key);
+    std::stable_sort(right.begin(), right.end(), by_key);
+    for (JoinKind kind : {JoinKind::Inner, JoinKind::Left}) {
+        ASSERT_EQ(Collect(left | Join(right, Options(kind, JoinStrategy::SortMerge))),
+                  Collect(left | Join(right, Options(kind, JoinStrategy::Hash))));
+    }
+}
@@ -0,0 +1,131 @@
+#include <processing.h>
+
+#include "temp_directory.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+class MappedFilesTest : public testing::Test {
+protected:
+    void SetUp() override {
+        fs::create_directories(root / "nested");
+        Write("a.txt", "the quick brown fox\njumps over the lazy dog\n");
+        Write("b.txt", ",,The end, the END; the end");
+        Write("empty.txt", "");
+        Write("nested/c.txt", "fox fox fox");
+    }
+
+    void Write(const std::string& name, const std::string& text) const {
+        temp.Write(name, text);
+    }
+
+    TempDirectory temp{"mapped_files_ut"};
+    fs::path root = temp.path();
+};
+
+auto Lower() {
+    return Transform([](std::string token) {
+        std::transform(token.begin(), token.end(), token.begin(), [](unsigned char c) { return std::tolower(c); });
+        return token;
+    });
+}
+
+auto Count() {
+    return AggregateByKey([](size_t& count) { ++count; }, [](const std::string& token) { return token; });
+}
+
+} // namespace
+
+TEST_F(MappedFilesTest, TokensMatchOpenFiles) {
+    std::vector<std::string> streamed;
+    for (const std::string& token : Dir(root.string(), true) | OpenFiles() | Split("\n ,.;")) {
+        streamed.push_back(token);
+    }
+    auto view = Dir(root.string(), true) | MapFiles() | Split("\n ,.;");
+    std::vector<std::string> mapped;
+    for (std::string_view token : view) {
+        mapped.emplace_back(token);
+    }
+    ASSERT_EQ(mapped, streamed);
+}
+
+TEST_F(MappedFilesTest, TokensViewTheMappingWhileTheViewLives) {
+    auto view = std::vector<fs::directory_entry>{fs::directory_entry(root / "a.txt"), fs::directory_entry(root / "b.txt")} |
+                MapFiles() | Split("\n ,;");
+    std::vector<std::string_view> tokens(view.begin(), view.end());
+    ASSERT_THAT(tokens, testing::ElementsAre("the", "quick", "brown", "fox", "jumps", "over", "the", "lazy", "dog",
+                                             "The", "end", "the", "END", "the", "end"));
+}
+
+TEST_F(MappedFilesTest, TransformTakingStringGetsOwningCopy) {
+    auto streamed = Dir(root.string(), true) | OpenFiles() | Split("\n ,.;") | Lower() | Count();
+    auto mapped = Dir(root.string(), true) | MapFiles() | Split("\n ,.;") | Lower() | Count();
+    ASSERT_EQ(mapped, streamed);
+    ASSERT_EQ(mapped.at("the"), 5u);
+}
+
+TEST_F(MappedFilesTest, FilterAndAggregateTakeStringViews) {
+    auto counts = Dir(root.string(), true) | MapFiles() | Split("\n ,.;") |
+                  Filter([](std::string_view token) { return token.size() == 3; }) |
+                  AggregateByKey([](size_t& count) { ++count; }, [](std::string_view token) { return std::string(token); });
+    ASSERT_EQ(counts.at("fox"), 4u);
+    ASSERT_EQ(counts.count("quick"), 0u);
+}
+
+TEST_F(MappedFilesTest, SplitsStringViewsInMemory) {
+    std::vector<std::string_view> text{"a b", "", "  c  ", "d"};
+    auto tokens = As_Vector(text | Split(" "));
+    ASSERT_THAT(tokens, testing::ElementsAre("a", "b", "c", "d"));
+}
+
+TEST_F(MappedFilesTest, NamedViewKeepsStringViewResultsValid) {
+    // A temporary view would unmap the files before the results are read,
+    // so materialising one into string_views does not compile.
+    static_assert(owns_mappings<decltype(Dir(root.string(), true) | MapFiles() | Split(" ") | Lower())>::value);
+    static_assert(dangles_after_v<decltype(Dir(root.string(), true) | MapFiles() | Split(" ")), std::string_view>);
+    auto mapped = Dir(root.string(), true) | MapFiles();
+    static_assert(!dangles_after_v<decltype(mapped | Split(" ")), std::string_view>);
+
+    auto words = Dir(root.string(), true) | MapFiles() | Split("\n ,.;");
+    auto counts = words | AggregateByKey(0uz, [](size_t& count, std::string_view) { ++count; },
+                                         [](std::string_view token) { return token; });
+    auto fox = std::find_if(counts.begin(), counts.end(), [](const auto& entry) { return entry.first == "fox"; });
+    ASSERT_NE(fox, counts.end());
+    ASSERT_EQ(fox->second, 4u);
+
+    auto tokens = Dir(root.string(), true) | MapFiles() | Split("\n ,.;");
+    ASSERT_EQ(As_Vector(tokens).size(), 18u);
+}
+
+TEST_F(MappedFilesTest, ParallelMatchesSequential) {
+    auto expected = Dir(root.string(), true) | MapFiles() | Split("\n ,.;") | Lower() | Count();
+    auto actual = Dir(root.string(), true) | Parallel(3) | MapFiles() | Split("\n ,.;") | Lower() | Count();
+    ASSERT_EQ(actual, expected);
+}
+
+TEST_F(MappedFilesTest, VectorScanMatchesStreamSplit) {
+    // Long tokens and delimiter runs that cross the 64-byte windows, with
+    // few delimiters for the vector scan and many for the table.
+    std::string text;
+    for (int i = 0; i < 3000; ++i) {
+        text += std::string(i % 71, 'a' + i % 26);
+        text += std::string(i % 3 + (i % 67 == 0 ? 80 : 0), " ,;\n"[i % 4]);
+    }
+    Write("long.txt", text);
+    for (std::string delimiters : {" ,;\n", " ,;\nabcdefghij"}) {
+        std::vector<std::string> streamed;
+        for (const std::string& token : std::vector{fs::directory_entry(root / "long.txt")} | OpenFiles() | Split(delimiters)) {
+            streamed.push_back(token);
+        }
+        std::vector<std::string> mapped;
+        for (std::string_view token : std::vector{fs::directory_entry(root / "long.txt")} | MapFiles() | Split(delimiters)) {
+            mapped.emplace_back(token);
+        }
+        ASSERT_EQ(mapped, streamed) << delimiters;
+    }
+}
@@ -0,0 +1,169 @@
+#include <processing.h>
+
+#include "temp_directory.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+class ParallelTest : public testing::Test {
+protected:
+    void SetUp() override {
+        fs::create_directories(root / "nested");
+        Write("a.txt", "the quick brown fox\njumps over the lazy dog\n");
+        Write("b.txt", "The end, the END; the end.");
+        Write("empty.txt", "");
+        Write("nested/c.txt", "fox fox fox");
+        std::string large;
+        for (int i = 0; i < 2000; ++i) {
+            large += "word" + std::to_string(i % 37) + (i % 5 == 0 ? ",\n" : " ");
+            if (i % 11 == 0) {
+                large += "   ";
+            }
+        }
+        large += "tail";
+        Write("large.txt", large);
+        fs::create_directories(root / "skipped.txt");
+    }
+
+    void Write(const std::string& name, const std::string& text) const {
+        temp.Write(name, text);
+    }
+
+    static auto Lower() {
+        return Transform([](std::string token) {
+            std::transform(token.begin(), token.end(), token.begin(), [](unsigned char c) { return std::tolower(c); });
+            return token;
+        });
+    }
+
+    auto Count() const {
+        return AggregateByKey([](size_t& count) { ++count; }, [](const std::string& token) { return token; });
+    }
+
+    auto Sequential() const {
+        return Dir(root.string(), true) | OpenFiles() | Split("\n ,.;") | Lower() | Count();
+    }
+
+    auto Parallelised(std::size_t threads, std::uintmax_t chunk_bytes) const {
+        return Dir(root.string(), true) | Parallel(threads, chunk_bytes) | OpenFiles() | Split("\n ,.;") |
+               Lower() | Count();
+    }
+
+    TempDirectory temp{"parallel_ut"};
+    fs::path root = temp.path();
+};
+
+} // namespace
+
+TEST_F(ParallelTest, MatchesSequentialForAnyThreadCount) {
+    auto expected = Sequential();
+    ASSERT_FALSE(expected.empty());
+    for (std::size_t threads : {1, 2, 4, 8}) {
+        ASSERT_EQ(Parallelised(threads, 1 << 20), expected) << threads << " threads";
+    }
+}
+
+TEST_F(ParallelTest, ChunkedFilesMatchSequential) {
+    auto expected = Sequential();
+    for (std::uintmax_t chunk_bytes : {1, 2, 3, 7, 64, 1000}) {
+        ASSERT_EQ(Parallelised(4, chunk_bytes), expected) << chunk_bytes << " byte chunks";
+    }
+}
+
+TEST_F(ParallelTest, StagesBeforeParallelAreKept) {
+    auto counts = Dir(root.string(), false) |
+                  Filter([](const std::filesystem::path& p) { return p.filename() == "b.txt"; }) | Parallel(2, 4) |
+                  OpenFiles() | Split("\n ,.;") | Lower() | Count();
+    ASSERT_THAT(counts, testing::ElementsAre(std::pair<const std::string, size_t>{"end", 3},
+                                             std::pair<const std::string, size_t>{"the", 3}));
+}
+
+TEST_F(ParallelTest, AggregatorAppliedAsInSequentialPath) {
+    auto doubling = AggregateByKey([](size_t& value) { value *= 2; }, [](const std::string& token) { return token; });
+    auto expected = Dir(root.string(), true) | OpenFiles() | Split(" \n") | doubling;
+    auto actual = Dir(root.string(), true) | Parallel(3, 5) | OpenFiles() | Split(" \n") | doubling;
+    ASSERT_EQ(actual, expected);
+    ASSERT_EQ(actual.at("fox"), 8u);
+}
+
+TEST(TaskPoolTest, RunsEveryTask) {
+    std::atomic<int> sum{0};
+    {
+        TaskPool pool(4, 2);
+        for (int i = 1; i <= 1000; ++i) {
+            pool.submit([&sum, i](std::size_t worker) {
+                ASSERT_LT(worker, 4u);
+                sum += i;
+            });
+        }
+        pool.wait();
+        ASSERT_EQ(sum, 500500);
+    }
+}
+
+TEST(TaskPoolTest, RunsTasksInSubmissionOrder) {
+    std::vector<int> order;
+    {
+        TaskPool pool(1, 8);
+        for (int i = 0; i < 8; ++i) {
+            pool.submit([&order, i](std::size_t) { order.push_back(i); });
+        }
+        pool.wait();
+    }
+    ASSERT_THAT(order, testing::ElementsAre(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+TEST(TaskPoolTest, RethrowsTaskException) {
+    TaskPool pool(2, 4);
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 10; ++i) {
+        pool.submit([&ran, i](std::size_t) {
+            ++ran;
+            if (i == 3) {
+                throw std::runtime_error("task failed");
+            }
+        });
+    }
+    ASSERT_THROW(pool.wait(), std::runtime_error);
+    ASSERT_EQ(ran, 10);
+    pool.submit([&ran](std::size_t) { ++ran; });
+    ASSERT_NO_THROW(pool.wait());
+}
+
+TEST(TaskPoolTest, SubmitBlocksWhileQueueIsFull) {
+    TaskPool pool(1, 2);
+    std::atomic<bool> started{false};
+    std::atomic<bool> release{false};
+    std::atomic<int> submitted{0};
+    pool.submit([&started, &release](std::size_t) {
+        started = true;
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    // The blocking task has to be running before the others are queued,
+    // or it would take up one of the two places.
+    while (!started) {
+        std::this_thread::yield();
+    }
+    std::thread producer([&] {
+        for (int i = 0; i < 4; ++i) {
+            pool.submit([](std::size_t) {});
+            ++submitted;
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(submitted, 2);
+    release = true;
+    producer.join();
+    pool.wait();
+    ASSERT_EQ(submitted, 4);
+}
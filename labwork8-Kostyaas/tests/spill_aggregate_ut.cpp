@@ -0,0 +1,133 @@
+#include <processing.h>
+
+#include "temp_directory.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace {
+
+class SpillAggregateTest : public testing::Test {
+protected:
+    std::size_t Files() const {
+        return temp.Entries();
+    }
+
+    TempDirectory temp{"spill_aggregate_ut"};
+    fs::path directory = temp.path();
+};
+
+auto Counting() {
+    return AggregateByKey(0uz, [](size_t& count, const std::string&) { ++count; }, [](const std::string& token) { return token; });
+}
+
+auto Sum() {
+    return [](size_t& count, const size_t& other) { count += other; };
+}
+
+std::vector<std::string> Tokens(std::size_t n, std::size_t keys) {
+    std::mt19937 random(5);
+    std::vector<std::string> tokens(n);
+    for (auto& token : tokens) {
+        token = "key" + std::to_string(random() % keys);
+    }
+    return tokens;
+}
+
+} // namespace
+
+TEST_F(SpillAggregateTest, MatchesInMemoryResult) {
+    auto tokens = Tokens(100000, 20000);
+    auto expected = tokens | Counting().sorted();
+    auto spilled = tokens | Counting().spill(64 * 1024, Sum(), directory);
+    ASSERT_GT(spilled.runs(), 5u);
+    ASSERT_EQ(As_Vector(spilled), expected);
+}
+
+TEST_F(SpillAggregateTest, CombinesRunsInOrder) {
+    auto tokens = Tokens(30000, 500);
+    auto history = AggregateByKey(
+        std::string{}, [](std::string& seen, const std::string& token) { seen += token.back(); },
+        [](const std::string& token) { return token.substr(0, token.size() - 1); });
+    auto expected = tokens | history.sorted();
+    auto spilled = tokens | history.spill(4096, [](std::string& seen, const std::string& later) { seen += later; }, directory);
+    ASSERT_GT(spilled.runs(), 1u);
+    ASSERT_EQ(As_Vector(spilled), expected);
+}
+
+TEST_F(SpillAggregateTest, GrowingValuesCountTowardsBudget) {
+    std::vector<std::string> tokens(20000, "kx");
+    auto history = AggregateByKey(
+        std::string{}, [](std::string& seen, const std::string& token) { seen += token.back(); },
+        [](const std::string& token) { return token.substr(0, 1); });
+    auto expected = tokens | history.sorted();
+    auto spilled = tokens | history.spill(4096, [](std::string& seen, const std::string& later) { seen += later; }, directory);
+    ASSERT_GT(spilled.runs(), 3u);
+    ASSERT_EQ(As_Vector(spilled), expected);
+}
+
+TEST_F(SpillAggregateTest, NoRunsBelowBudget) {
+    std::vector<std::string> tokens = {"b", "a", "b"};
+    auto spilled = tokens | Counting().spill(1 << 20, Sum(), directory);
+    ASSERT_EQ(spilled.runs(), 1u);
+    ASSERT_THAT(As_Vector(spilled), testing::ElementsAre(std::make_pair("a", 1), std::make_pair("b", 2)));
+}
+
+TEST_F(SpillAggregateTest, EmptyInput) {
+    std::vector<std::string> tokens;
+    auto spilled = tokens | Counting().spill(1024, Sum(), directory);
+    ASSERT_EQ(spilled.runs(), 0u);
+    ASSERT_TRUE(As_Vector(spilled).empty());
+}
+
+TEST_F(SpillAggregateTest, RunFilesRemovedWithResult) {
+    auto tokens = Tokens(10000, 5000);
+    {
+        auto spilled = tokens | Counting().spill(8192, Sum(), directory);
+        ASSERT_EQ(Files(), spilled.runs());
+        ASSERT_GT(Files(), 0u);
+    }
+    ASSERT_EQ(Files(), 0u);
+}
+
+TEST_F(SpillAggregateTest, FeedsLaterStages) {
+    std::vector<std::string> tokens = {"x", "y", "x", "z", "x"};
+    std::stringstream out;
+    tokens | Counting().spill(16, Sum(), directory) |
+        Transform([](const std::pair<std::string, size_t>& stat) { return stat.first + "=" + std::to_string(stat.second); }) |
+        Out(out);
+    ASSERT_EQ(out.str(), "x=3\ny=1\nz=1\n");
+}
+
+TEST_F(SpillAggregateTest, MergesManyRunsInGroups) {
+    auto tokens = Tokens(30000, 500);
+    auto history = AggregateByKey(
+        std::string{}, [](std::string& seen, const std::string& token) { seen += token.back(); },
+        [](const std::string& token) { return token.substr(0, token.size() - 1); });
+    auto expected = tokens | history.sorted();
+    {
+        auto spilled = tokens | history.spill(256, [](std::string& seen, const std::string& later) { seen += later; }, directory);
+        ASSERT_GT(spilled.runs(), 64u);
+        ASSERT_EQ(As_Vector(spilled), expected);
+        ASSERT_LE(spilled.runs(), 64u);
+        ASSERT_EQ(Files(), spilled.runs());
+    }
+    ASSERT_EQ(Files(), 0u);
+}
+
+TEST_F(SpillAggregateTest, TruncatedRunThrows) {
+    auto tokens = Tokens(10000, 5000);
+    auto spilled = tokens | Counting().spill(8192, Sum(), directory);
+    fs::path run = *fs::directory_iterator(directory);
+    fs::resize_file(run, fs::file_size(run) - 3);
+    ASSERT_THROW(As_Vector(spilled), std::runtime_error);
+}
+
+TEST_F(SpillAggregateTest, MissingRunThrows) {
+    auto tokens = Tokens(10000, 5000);
+    auto spilled = tokens | Counting().spill(8192, Sum(), directory);
+    fs::remove(*fs::directory_iterator(directory));
+    ASSERT_THROW(As_Vector(spilled), std::runtime_error);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <processing.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+// A fresh directory under the system temp directory, removed with
+// everything in it when the object goes.
+class TempDirectory {
+public:
+    explicit TempDirectory(const std::string& prefix)
+        : path_(fs::temp_directory_path() /
+                (prefix + "_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()))) {
+        fs::create_directories(path_);
+    }
+
+    TempDirectory(const TempDirectory&) = delete;
+    TempDirectory& operator=(const TempDirectory&) = delete;
+
+    ~TempDirectory() {
+        std::error_code ignored;
+        fs::remove_all(path_, ignored);
+    }
+
+    const fs::path& path() const {
+        return path_;
+    }
+
+    // Writes `text` to `name`, a path relative to the directory.
+    void Write(const std::string& name, const std::string& text) const {
+        std::ofstream(path_ / name, std::ios::binary) << text;
+    }
+
+    // The number of files and directories directly inside.
+    std::size_t Entries() const {
+        return std::distance(fs::directory_iterator(path_), fs::directory_iterator());
+    }
+
+private:
+    fs::path path_;
+};
@@ -0,0 +1,102 @@
+#include <processing.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+
+template <typename Range>
+long long Sum(const Range& range) {
+    long long total = 0;
+    for (auto it = range.begin(); it != range.end(); ++it) {
+        total += *it;
+    }
+    return total;
+}
+
+} // namespace
+
+// GCC inlines these into the test bodies and then reports free() on memory
+// from operator new, which is exactly what the replacement pair does.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#pragma GCC diagnostic pop
+
+TEST(ViewCompositionTest, PipelineLengthDoesNotAllocate) {
+    std::vector<int> input(1000);
+    for (int i = 0; i < 1000; ++i) {
+        input[i] = i;
+    }
+    auto even = [](int x) { return x % 2 == 0; };
+    auto inc = [](int x) { return x + 1; };
+
+    std::size_t before = allocations;
+    long long short_sum = Sum(input | Filter(even) | Transform(inc));
+    std::size_t short_allocations = allocations - before;
+
+    before = allocations;
+    long long long_sum = Sum(
+        input | Filter(even) | Transform(inc) | Transform(inc) | Filter(even)
+            | Transform(inc) | Transform(inc) | Filter(even) | Transform(inc));
+    std::size_t long_allocations = allocations - before;
+
+    ASSERT_EQ(short_sum, 250000);
+    ASSERT_EQ(long_sum, 252000);
+    ASSERT_EQ(short_allocations, 0u);
+    ASSERT_EQ(long_allocations, 0u);
+}
+
+TEST(ViewCompositionTest, RvalueSourceIsMovedIntoView) {
+    std::vector<int> input = {1, 2, 3, 4, 5};
+    const int* data = input.data();
+    auto view = std::move(input) | Filter([](int x) { return x > 2; });
+    ASSERT_EQ(&*view.begin(), data + 2);
+    ASSERT_THAT(As_Vector(view), testing::ElementsAre(3, 4, 5));
+}
+
+TEST(ViewCompositionTest, LvalueSourceIsReferenced) {
+    std::vector<int> input = {1, 2, 3};
+    auto view = input | Filter([](int) { return true; });
+    input[0] = 10;
+    ASSERT_THAT(As_Vector(view), testing::ElementsAre(10, 2, 3));
+}
+
+TEST(ViewCompositionTest, SplitViewOutlivesAdapter) {
+    std::vector<std::stringstream> files(2);
+    files[0] << "a b";
+    files[1] << "c";
+    auto view = std::move(files) | Split(" ") | Transform([](const std::string& s) { return s + s; });
+    ASSERT_THAT(As_Vector(view), testing::ElementsAre("aa", "bb", "cc"));
+}
+
+TEST(ViewCompositionTest, TransformCallsFunctionOncePerElement) {
+    std::vector<int> input = {1, 2, 3, 4};
+    int calls = 0;
+    auto view = input | Transform([&calls](int x) { ++calls; return x * 10; });
+    ASSERT_EQ(Sum(view), 100);
+    ASSERT_EQ(calls, 4);
+}